@@ -0,0 +1,108 @@
+/*
+   ESP32 RFID Jukebox - interrupt-driven buttons
+
+   Every button pin has a CHANGE interrupt. The handler only stamps the
+   first edge of a burst and wakes the input task; the task does the rest
+   in update(), so nothing in the sketch reads the buttons while none is
+   touched and no step ever waits on one.
+
+   Debouncing uses a lockout timer. The first edge counts immediately (the
+   level is read back to reject glitches), then the contacts get
+   DEBOUNCE_MS to settle. When the lockout ends the pin is read again, so
+   a release that bounced inside the lockout still counts.
+
+   Presses become INPUT_BUTTON events with a gesture:
+
+     GESTURE_PRESS   on the press; for buttons with DOUBLE, once the
+                     DOUBLE_PRESS_MS window after the release has passed
+     GESTURE_LONG    LONG buttons held for LONG_PRESS_MS; with REPEAT,
+                     again every REPEAT_MS while still held
+     GESTURE_DOUBLE  DOUBLE buttons pressed again within DOUBLE_PRESS_MS
+
+   Only buttons with DOUBLE wait for the window; the others act on the
+   press edge. Events carry the time of the edge, so handleInputEvents()
+   can measure edge -> action latency (recordLatency()).
+
+   nextTimeoutMs() tells the input task when a timer (lockout, long press,
+   double-press window) is next due; otherwise it sleeps until an edge.
+*/
+
+#ifndef BUTTON_INPUT_H
+#define BUTTON_INPUT_H
+
+#include <Arduino.h>
+#include "input_events.h"
+
+class ButtonInput {
+ public:
+  static const uint8_t MAX_BUTTONS = 5;
+  static const uint16_t DEBOUNCE_MS = 30;
+  static const uint16_t LONG_PRESS_MS = 700;
+  static const uint16_t REPEAT_MS = 250;
+  static const uint16_t DOUBLE_PRESS_MS = 300;
+
+  // Gestures a button reports besides GESTURE_PRESS
+  static const uint8_t LONG = 0x01;
+  static const uint8_t DOUBLE = 0x02;
+  static const uint8_t REPEAT = 0x04;              // LONG again every REPEAT_MS
+
+  // Events go to this queue
+  void begin(InputEventQueue& events);
+
+  // Active-low button with internal pull-up; false if all slots are taken
+  bool add(uint8_t pin, InputButton button, uint8_t gestures = 0);
+
+  // Debounce pending edges and run the gesture timers (input task)
+  void update();
+
+  // ms until update() must run again without a new edge; 0 = only on an edge
+  uint32_t nextTimeoutMs() const;
+
+  // Edge -> action time of a button event, from the consumer
+  void recordLatency(uint32_t us);
+
+  // Statistics
+  uint32_t edges() const;                          // interrupts, bounces included
+  uint32_t accepted() const { return accepted_; }  // debounced level changes
+  uint32_t gestures(ButtonGesture gesture) const { return gestures_[gesture]; }
+  uint32_t latencyCount() const { return latencyCount_; }
+  uint32_t averageLatencyUs() const;
+  uint32_t maxLatencyUs() const { return maxLatencyUs_; }
+
+ private:
+  struct Button {
+    uint8_t pin;
+    InputButton id;
+    uint8_t gestures;
+    volatile bool edge;            // set by the interrupt, cleared by update()
+    volatile uint32_t edgeUs;      // first edge since the flag was cleared
+    volatile uint32_t interrupts;
+    bool pressed;                  // debounced level
+    bool locked;                   // lockout running
+    uint32_t lockMs;
+    uint32_t pressUs;              // edge of the press, for a delayed PRESS
+    uint32_t nextLongMs;           // next LONG while held
+    bool held;                     // LONG has fired for this press
+    bool doubled;                  // this press was the second of a DOUBLE
+    bool singlePending;            // released, waiting out the DOUBLE window
+    uint32_t releaseMs;
+  };
+
+  static void IRAM_ATTR onEdge(void* arg);
+  static bool longPending(const Button& button);
+  void changed(Button& button, bool pressed, uint32_t edgeUs, uint32_t nowMs);
+  void runTimers(Button& button, uint32_t nowMs);
+  void emit(Button& button, ButtonGesture gesture, uint32_t sinceUs);
+
+  InputEventQueue* events_ = nullptr;
+  Button buttons_[MAX_BUTTONS];
+  uint8_t count_ = 0;
+
+  uint32_t accepted_ = 0;
+  uint32_t gestures_[3] = {};
+  uint32_t latencyCount_ = 0;
+  uint64_t latencySumUs_ = 0;
+  uint32_t maxLatencyUs_ = 0;
+};
+
+#endif // BUTTON_INPUT_H
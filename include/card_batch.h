@@ -0,0 +1,145 @@
+/*
+   ESP32 RFID Jukebox - batch card programming
+
+   Numbers a stack of cards in one job, for the card set of a new box.
+   The job is a list of numbers and ranges - "1-41", "1,5,9-12", "-7,1-20"
+   - given on the console in programming mode ("batch 1-41") or as the
+   body of POST /api/program. Every card placed on the reader then gets
+   the next number (batchModus() in main.cpp):
+
+     select -> authenticate -> write -> read back -> compare -> halt
+
+   The read-back runs inside the write's authentication, so verifying
+   costs one block read, not a second authentication. A card whose write
+   or read-back fails stays un-halted and is tried again on the next pass;
+   after MAX_ATTEMPTS it is flagged as bad and halted, and its number goes
+   to the next card. A card already written (or flagged) that is put back
+   is left alone, as long as it is one of the last LOG_SIZE cards.
+
+   Every finished card gets a log entry - number, UID, attempts, result,
+   time - in a ring of the last LOG_SIZE cards. Throughput is counted from
+   the first card written to the last, so the time before the first card
+   is placed does not count. writeJson() serves progress and the log for
+   GET /api/program; entries are guarded like the event log's records, so
+   a reader on async_tcp skips one that is overwritten while copying.
+
+   POST /api/program runs on async_tcp: it parses the job there and hands
+   it over through a one-job slot that the player task takes from in
+   handleWebCommands().
+*/
+
+#ifndef CARD_BATCH_H
+#define CARD_BATCH_H
+
+#include <Arduino.h>
+#include <MFRC522.h>
+#include <atomic>
+
+struct CardBatchSpec {
+  static const uint8_t MAX_RANGES = 8;
+
+  struct Range {
+    int16_t first;
+    int16_t last;
+  };
+
+  Range ranges[MAX_RANGES];
+  uint8_t count = 0;
+
+  uint16_t total() const;
+};
+
+// What happened to a card
+enum CardBatchResult : uint8_t {
+  CARD_BATCH_WRITTEN,        // written and read back
+  CARD_BATCH_RETRY,          // failed, tried again while it stays on the reader
+  CARD_BATCH_FAILED          // failed MAX_ATTEMPTS times, flagged
+};
+
+class CardBatch {
+ public:
+  static const uint8_t LOG_SIZE = 64;              // most recent cards, a power of two
+  static const uint8_t MAX_ATTEMPTS = 3;
+
+  // "1-41", "1,5,9-12" -> spec. Numbers are card numbers: 1..32767, or
+  // -1..-7 for folder and shuffle cards. False on a syntax error, an
+  // invalid number, a range from a negative to a positive number or more
+  // than MAX_RANGES ranges.
+  static bool parse(const char* text, size_t length, CardBatchSpec& spec);
+
+  // async_tcp: hand a job to the player task; false if one is still waiting
+  bool submit(const CardBatchSpec& spec);
+
+  // Player task: take the job handed over by submit()
+  bool takeSubmitted(CardBatchSpec& spec);
+
+  // Player task: run a new job, dropping the old one's progress and log
+  void start(const CardBatchSpec& spec);
+  void stop() { running_ = false; }
+  bool running() const { return running_; }
+
+  // Number for the next card
+  int nextNumber() const;
+
+  // A card written or flagged in this job, looked up in the card log;
+  // put back, it is skipped
+  bool finished(const MFRC522::Uid& uid) const;
+
+  // Player task: outcome of writing nextNumber() to this card
+  CardBatchResult cardDone(const MFRC522::Uid& uid, bool ok, uint32_t ms);
+
+  // Progress and statistics
+  uint16_t total() const { return total_; }
+  uint16_t written() const { return written_; }
+  uint16_t failed() const { return failed_; }       // cards flagged as bad
+  uint32_t retries() const { return retries_; }
+  float cardsPerMinute() const;
+
+  // "BATCH: 12/41 written, ..." on one line
+  void printProgress(Print& out) const;
+
+  // Any task: progress and the card log as JSON
+  void writeJson(Print& out) const;
+
+ private:
+  struct Entry {
+    std::atomic<uint32_t> seq{0};                  // 0 while being written
+    uint32_t ms;
+    int16_t number;
+    uint8_t attempts;
+    uint8_t result;
+    uint8_t uidSize;
+    uint8_t uid[10];
+  };
+
+  static bool sameUid(const MFRC522::Uid& uid, const uint8_t* other, uint8_t size);
+  void log(const MFRC522::Uid& uid, uint8_t attempts, CardBatchResult result, uint32_t ms);
+  void advance();
+
+  CardBatchSpec spec_;
+  uint8_t range_ = 0;                              // position in the job
+  int16_t offset_ = 0;
+  bool running_ = false;
+
+  // Card being retried
+  uint8_t pendingUid_[10];
+  uint8_t pendingSize_ = 0;
+  uint8_t attempts_ = 0;
+
+  uint16_t total_ = 0;
+  uint16_t written_ = 0;
+  uint16_t failed_ = 0;
+  uint32_t retries_ = 0;
+  uint32_t firstMs_ = 0;                           // first and last card written
+  uint32_t lastMs_ = 0;
+
+  Entry log_[LOG_SIZE];
+  std::atomic<uint32_t> logged_{0};                // entries ever written
+
+  CardBatchSpec submitted_;
+  std::atomic<bool> submittedWaiting_{false};
+};
+
+extern CardBatch cardBatch;
+
+#endif // CARD_BATCH_H
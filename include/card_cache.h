@@ -0,0 +1,73 @@
+/*
+   ESP32 RFID Jukebox - UID to card number cache
+
+   The card set is fixed, so a card's UID identifies the number written on
+   it. The first time a card is read the decoded number is stored under its
+   UID; later taps dispatch straight from the UID and skip the MIFARE
+   authentication and block read, the slowest steps of handleRFID().
+
+   Entries live in a small open-addressing hash table in RAM and are
+   persisted to a binary file on SPIFFS so the cache survives a restart:
+
+     "JBC" 0x01                       header
+     size uid[size] number(int16 LE)  one record per insert, appended
+
+   A later record for the same UID replaces an earlier one (a reprogrammed
+   card). The file is rewritten from RAM when it holds superseded or
+   damaged records.
+*/
+
+#ifndef CARD_CACHE_H
+#define CARD_CACHE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <MFRC522.h>
+
+class CardCache {
+ public:
+  static const uint16_t CAPACITY = 128;            // hash slots, power of two
+  static const uint16_t MAX_ENTRIES = 96;          // keep probes short
+
+  // Load the persisted entries; the cache works from RAM only if this fails
+  bool begin(fs::FS& fs, const char* path = "/cards.bin");
+
+  // Number stored on the card with this UID, if the card has been read before
+  bool lookup(const MFRC522::Uid& uid, int& number);
+
+  // Remember (or update) a card; appended to the file when it changed
+  bool insert(const MFRC522::Uid& uid, int number);
+
+  // Forget every card and delete the file
+  void clear();
+
+  // Statistics
+  uint16_t size() const { return count_; }
+  uint32_t hits() const { return hits_; }
+  uint32_t misses() const { return misses_; }
+  float hitRate() const;                           // percent of lookups
+
+ private:
+  struct Entry {
+    uint8_t uidSize;                               // 0 = empty slot
+    uint8_t uid[10];
+    int16_t number;
+  };
+
+  static uint32_t hash(const uint8_t* uid, uint8_t size);
+  Entry* find(const uint8_t* uid, uint8_t size, bool forInsert);
+  bool store(const uint8_t* uid, uint8_t size, int16_t number);
+  void append(const Entry& entry);
+  void rewrite();
+  static void writeRecord(File& file, const Entry& entry);
+
+  Entry table_[CAPACITY];
+  uint16_t count_ = 0;
+  fs::FS* fs_ = nullptr;
+  const char* path_ = nullptr;
+
+  uint32_t hits_ = 0;
+  uint32_t misses_ = 0;
+};
+
+#endif // CARD_CACHE_H
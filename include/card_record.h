@@ -0,0 +1,73 @@
+/*
+   ESP32 RFID Jukebox - binary card record for NTAG/Ultralight cards
+
+   MIFARE Classic cards hold their number as ASCII digits in block 1, which
+   takes a Crypto1 authentication (three-pass, ~4.5 ms) before the block
+   can be read. NTAG21x and MIFARE Ultralight cards have no sector keys:
+   their user pages can be read straight after SELECT, and one READ
+   command returns four pages (16 bytes). The record therefore lives in
+   pages 4-5, the start of user memory, and a tap needs one transaction:
+
+     byte 0    'J'                 magic
+     byte 1    version (1)
+     byte 2    action              CardAction
+     byte 3    reserved (0)
+     byte 4-5  number              uint16 LE: track or folder number
+     byte 6-7  CRC-16/CCITT        over bytes 0-5, LE
+
+   The action makes the card's meaning explicit instead of encoding it in
+   the sign of the number; cardNumber() maps a record back to the numbers
+   playCardNumber() and the card cache already use (track > 0, folder
+   -1..-6, shuffle -7). A card with a bad magic, version or CRC - blank,
+   torn write, NDEF data from another app - is rejected rather than played.
+
+   Writing the record overwrites the NDEF capability data in page 4 and
+   up; use dedicated cards.
+*/
+
+#ifndef CARD_RECORD_H
+#define CARD_RECORD_H
+
+#include <Arduino.h>
+#include <MFRC522.h>
+
+enum CardAction : uint8_t {
+  CARD_ACTION_TRACK,                               // play track `number`
+  CARD_ACTION_FOLDER,                              // play folder `number`
+  CARD_ACTION_SHUFFLE,                             // custom shuffle (number unused)
+  CARD_ACTION_COUNT
+};
+
+struct CardRecord {
+  CardAction action;
+  uint16_t number;
+};
+
+static const uint8_t CARD_RECORD_PAGE = 4;         // first user page
+static const uint8_t CARD_RECORD_SIZE = 8;         // two pages
+
+// Record for a card number as typed in programmer mode; false if the
+// number has no record form (0, or below -7)
+bool cardRecordFromNumber(int number, CardRecord& record);
+
+// The number playCardNumber() expects for a record
+int cardNumber(const CardRecord& record);
+
+void encodeCardRecord(const CardRecord& record, byte* out);
+
+// False if magic, version, action or CRC do not match
+bool decodeCardRecord(const byte* data, CardRecord& record);
+
+uint16_t cardRecordCrc(const byte* data, uint8_t length);
+
+// True for the card types that carry a record instead of ASCII digits
+bool usesCardRecord(MFRC522::PICC_Type type);
+
+// Read the record of the selected card with a single READ command.
+// STATUS_CRC_WRONG if the card answered but holds no valid record.
+MFRC522::StatusCode readCardRecord(MFRC522& reader, CardRecord& record);
+
+// Write the record to the selected card (two 4-byte page writes)
+MFRC522::StatusCode writeCardRecord(MFRC522& reader, const CardRecord& record);
+
+#endif // CARD_RECORD_H
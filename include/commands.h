@@ -0,0 +1,134 @@
+/*
+   ESP32 RFID Jukebox - console and web commands
+
+   One table of commands for every front-end. The serial console, /cmd,
+   /api/command and /api/batch all turn their input into a CommandCall with
+   parseCommand() and run it with runCommand(), so a command behaves (and
+   answers) the same wherever it comes from. Each entry has a long name, an
+   optional one-key alias and whether it takes a number:
+
+     s, status        h, shuffle         q, queue           play N
+     v, volume        z, shuffleinfo     queue N            volume N
+     +, up            t, toggle          u, cardqueue       jukebox
+     -, down          n, next            c, clear           ?, help
+     l, list          b, previous        i, detect
+     x, stop          k, forget          p, program         r, reset
+
+   "volume" alone shows the volume, "volume 20" sets it; "queue" shows the
+   play queue, "queue 12" adds track 12.
+
+   Serial input goes through a CommandLine: bytes are fed in as they
+   arrive and a line is only handed over once its CR or LF is in, so the
+   console never waits for the rest of a line. Lines are at most
+   CommandLine::MAX_LENGTH characters; longer ones are dropped with an
+   error on the console and counted in /api/metrics.
+
+   Commands run on the player task. The web handlers only parse and queue
+   the CommandCall (webCommands); handleWebCommands() runs it into a
+   CommandReply, whose text becomes the command's result.
+*/
+
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <Arduino.h>
+#include "web_response_ring.h"
+
+enum CommandId : uint8_t {
+  CMD_STATUS,
+  CMD_VOLUME,
+  CMD_SET_VOLUME,
+  CMD_VOLUME_UP,
+  CMD_VOLUME_DOWN,
+  CMD_LIST,
+  CMD_STOP,
+  CMD_SHUFFLE,
+  CMD_SHUFFLE_INFO,
+  CMD_PLAY_PAUSE,
+  CMD_NEXT,
+  CMD_PREVIOUS,
+  CMD_PLAY,
+  CMD_QUEUE,
+  CMD_ADD_TO_QUEUE,
+  CMD_CARD_QUEUE_MODE,
+  CMD_CLEAR_QUEUE,
+  CMD_DETECT_MODE,
+  CMD_FORGET_CARDS,
+  CMD_PROGRAM,
+  CMD_JUKEBOX,
+  CMD_RESET,
+  CMD_HELP,
+  COMMAND_COUNT
+};
+
+// Where a command came from; a few answer differently on the web
+enum CommandSource : uint8_t {
+  COMMAND_SERIAL,
+  COMMAND_WEB
+};
+
+struct CommandCall {
+  CommandId id;
+  int32_t argument;    // track number or volume, 0 if the command takes none
+};
+
+// Incremental line reader, fed one byte at a time
+class CommandLine {
+ public:
+  static const uint16_t MAX_LENGTH = 512;         // a batch job list, like a POST /api/program body
+
+  // True when c completed a non-empty line; text() holds it until the next feed()
+  bool feed(char c);
+
+  // True when the last feed() ended a line over MAX_LENGTH, which was dropped
+  bool tooLong() const { return tooLong_; }
+
+  const char* text() const { return line_; }
+  uint16_t length() const { return length_; }
+  uint32_t dropped() const { return dropped_; }    // lines over MAX_LENGTH
+
+ private:
+  char line_[MAX_LENGTH + 1] = {};
+  uint16_t length_ = 0;
+  bool complete_ = false;
+  bool overflow_ = false;
+  bool tooLong_ = false;
+  uint32_t dropped_ = 0;
+};
+
+// Fixed buffer for a command's answer on the web. Holds one byte more than
+// a response slot, so webResponses still counts answers it has to cut off.
+// println()'s CR is dropped: web results use bare LF line ends.
+class CommandReply : public Print {
+ public:
+  static const uint16_t SIZE = WebResponseRing::SLOT_SIZE + 1;
+
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+  void clear() { length_ = 0; text_[0] = '\0'; }
+  const char* text() const { return text_; }
+  size_t length() const { return length_; }
+
+ private:
+  char text_[SIZE + 1] = {};
+  size_t length_ = 0;
+};
+
+// "s", "volume 20", "play 12" -> call. False if no command matches.
+bool parseCommand(const char* text, size_t length, CommandCall& call);
+
+// Player task: run a parsed command and write its answer to out
+void runCommand(const CommandCall& call, Print& out, CommandSource source);
+
+// Parse and run a line; an unknown one gets the list of commands. False if
+// it was unknown.
+bool dispatchCommand(const char* line, Print& out, CommandSource source);
+
+// Canonical text of a call ("status", "play 12")
+String commandText(const CommandCall& call);
+
+// "Commands: s=status, v=volume, ..."
+void printCommandHelp(Print& out);
+
+#endif // COMMANDS_H
@@ -0,0 +1,139 @@
+/*
+   ESP32 RFID Jukebox - non-blocking DFPlayer command scheduler
+
+   Playback commands are queued with a minimum gap to the previous frame and
+   written to the DFPlayer UART from update(), which the player task calls
+   on every pass. A track change (stop, settle, play) therefore no longer freezes the
+   loop for delay(100): buttons, cards and serial input keep being serviced
+   while the scheduler waits for the deadline of the next frame.
+
+   Frames are sent without the ACK request so nothing ever waits on a reply.
+
+   update() also drains the UART receive buffer through a byte-at-a-time
+   frame parser, so the unsolicited frames the module sends on its own are
+   picked up without a query: 0x3D "track finished" ends the current track
+   (the module sends it twice; the repeat is dropped) and the playback state
+   is tracked from the commands sent and the events received. Nothing polls
+   the module with readState() any more.
+
+   The track to follow the current one can be armed with armNext(). When
+   the finish frame arrives, the parser sends the armed play command on the
+   spot, without the stop and settle of playTrack() (the module has stopped
+   already) and without waiting for the loop to react. The time from finish
+   frame to the next play command is kept as the advance gap.
+*/
+
+#ifndef DFPLAYER_SCHEDULER_H
+#define DFPLAYER_SCHEDULER_H
+
+#include <Arduino.h>
+
+class DFPlayerScheduler {
+ public:
+  static const uint8_t QUEUE_SIZE = 8;              // pending frames
+  static const unsigned long FRAME_GAP_MS = 20;     // minimum spacing between frames
+  static const unsigned long STOP_SETTLE_MS = 100;  // stop -> play settle time
+  static const unsigned long FINISH_REPEAT_MS = 500; // window for the duplicate 0x3D
+  static const unsigned long ADVANCE_WINDOW_MS = 2000; // finish -> play counted as an advance
+
+  // Same values as the module reports for a 0x42 state query
+  enum State : uint8_t { STOPPED = 0, PLAYING = 1, PAUSED = 2 };
+
+  void begin(Stream& serial);
+
+  // Parse received frames and send due ones; call once per loop() iteration
+  void update();
+
+  // Queue a raw DFPlayer command, sent at least gapMs after the previous frame
+  bool send(uint8_t command, uint16_t parameter = 0, unsigned long gapMs = 0);
+
+  // Track change: stop, wait STOP_SETTLE_MS, play. Supersedes anything queued.
+  void playTrack(uint16_t track);
+  void playLargeFolder(uint8_t folder, uint16_t file);
+
+  void stop()     { send(0x16); }
+  void pause()    { send(0x0E); }
+  void start()    { send(0x0D); }
+  void next()     { send(0x01); }
+  void previous() { send(0x02); }
+  void volume(uint8_t volume) { send(0x06, volume); }
+
+  bool busy() const { return count_ > 0; }
+  uint8_t pending() const { return count_; }
+
+  // Consume a "track finished" event; track is the file the module reported
+  bool takeTrackFinished(uint16_t& track);
+
+  // Track to play as soon as the current one finishes, 0 for none
+  void armNext(uint16_t track) { armedTrack_ = track; }
+  uint16_t armed() const { return armedTrack_; }
+
+  // Consume the start of the armed track; track is the one that was sent
+  bool takeArmedStart(uint16_t& track);
+  State state() const { return state_; }
+  uint16_t lastError() const { return lastError_; }
+
+  // Statistics
+  uint32_t framesSent() const { return framesSent_; }
+  uint32_t dropped() const { return dropped_; }
+  uint32_t trackChanges() const { return trackChanges_; }
+  float transitionLoopRate() const;   // loop iterations per second while busy
+  uint32_t framesReceived() const { return framesReceived_; }
+  uint32_t finishEvents() const { return finishEvents_; }
+  uint32_t receiveErrors() const { return receiveErrors_; }
+  uint32_t advances() const { return advances_; }            // finish -> next track sent
+  uint32_t armedAdvances() const { return armedAdvances_; }  // of which armed
+  unsigned long lastAdvanceMs() const { return lastAdvanceMs_; }
+  unsigned long maxAdvanceMs() const { return maxAdvanceMs_; }
+
+ private:
+  struct Command {
+    uint8_t command;
+    uint16_t parameter;
+    unsigned long gapMs;
+  };
+
+  void writeFrame(uint8_t command, uint16_t parameter);
+  void receive();
+  void handleFrame(uint8_t command, uint16_t parameter);
+
+  Stream* serial_ = nullptr;
+  Command queue_[QUEUE_SIZE];
+  uint8_t head_ = 0;
+  uint8_t count_ = 0;
+  unsigned long lastFrameTime_ = 0;
+  bool sentAny_ = false;
+
+  uint32_t framesSent_ = 0;
+  uint32_t dropped_ = 0;
+  uint32_t trackChanges_ = 0;
+  uint32_t busyIterations_ = 0;
+  unsigned long busyMillis_ = 0;
+  unsigned long lastUpdateTime_ = 0;
+
+  // Receive side
+  uint8_t rxFrame_[10];
+  uint8_t rxLength_ = 0;
+  State state_ = STOPPED;
+  uint16_t playingTrack_ = 0;         // 0 when the module picked the file itself
+  bool finishPending_ = false;
+  uint16_t finishedTrack_ = 0;
+  unsigned long lastFinishTime_ = 0;
+  uint16_t lastError_ = 0;
+
+  uint32_t framesReceived_ = 0;
+  uint32_t finishEvents_ = 0;
+  uint32_t receiveErrors_ = 0;
+
+  // Next track
+  uint16_t armedTrack_ = 0;
+  uint16_t armedStarted_ = 0;         // sent on a finish, not yet taken
+  bool advancing_ = false;            // finished, next track not sent yet
+  unsigned long finishTime_ = 0;
+  uint32_t advances_ = 0;
+  uint32_t armedAdvances_ = 0;
+  unsigned long lastAdvanceMs_ = 0;
+  unsigned long maxAdvanceMs_ = 0;
+};
+
+#endif // DFPLAYER_SCHEDULER_H
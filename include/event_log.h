@@ -0,0 +1,155 @@
+/*
+   ESP32 RFID Jukebox - deferred event log
+
+   What the jukebox reports while it plays - a card tap, a track change, a
+   shuffle step, a button action - used to go straight to Serial. At
+   115200 baud a line takes ~3 ms on the wire, and once the 128-byte UART
+   FIFO is full Serial.print() waits for it, so a tap or a track change
+   spent more time printing than doing.
+
+   LOG_INFO(LOG_PLAY_TRACK, track, volume) instead stores a 20-byte binary
+   record in a RAM ring: a message id, the level, the time and up to three
+   integer arguments. No formatting, no String, no lock - a fetch_add for
+   the slot, millis() and six stores. The text lives once in flash, in the message
+   table in event_log.cpp.
+
+   Levels are fixed at compile time with JUKEBOX_LOG_LEVEL (platformio.ini).
+   Calls above it compile to nothing, arguments included, so LOG_DEBUG in a
+   hot path costs nothing in a release build.
+
+   The records are turned into text later, away from the hot paths:
+     - the log task (core 0, lowest priority) drains them to Serial, only
+       as much as the UART TX FIFO takes without waiting
+     - GET /api/log?since=<seq> returns what the ring still holds
+   If more than CAPACITY records arrive before the drain catches up the
+   oldest are lost; the drain reports how many.
+
+   Slots are guarded like the web response slots: the writer clears the
+   slot's sequence number, fills the record and then publishes it, and a
+   reader that sees it change while copying skips the record.
+*/
+
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "song_catalog.h"
+
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN  1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_DEBUG 3
+
+#ifndef JUKEBOX_LOG_LEVEL
+#define JUKEBOX_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Message ids; the text of each is in the table in event_log.cpp
+enum LogMessage : uint8_t {
+  LOG_DROPPED,               // written by the drain itself
+  LOG_CARD_DETECTED,
+  LOG_CARD_CACHED,
+  LOG_CARD_NUMBER,
+  LOG_CARD_AUTH_FAILED,
+  LOG_CARD_READ_FAILED,
+  LOG_CARD_EMPTY,
+  LOG_CARD_NO_RECORD,
+  LOG_CARD_INVALID,
+  LOG_PLAY_FOLDER,
+  LOG_PLAY_TRACK,
+  LOG_PLAY_FINISHED,
+  LOG_PLAY_PAUSED,
+  LOG_PLAY_RESUMED,
+  LOG_PLAY_NEXT,
+  LOG_PLAY_PREVIOUS,
+  LOG_SHUFFLE_ORDER,
+  LOG_SHUFFLE_CYCLE,
+  LOG_SHUFFLE_STARTED,
+  LOG_SHUFFLE_TRACK,
+  LOG_SHUFFLE_FINISHED,
+  LOG_SHUFFLE_EXIT,
+  LOG_QUEUE_ADDED,
+  LOG_QUEUE_FULL,
+  LOG_QUEUE_TRACK,
+  LOG_QUEUE_MODE_ON,
+  LOG_QUEUE_MODE_OFF,
+  LOG_BUTTON_HOLD_RESET,
+  LOG_MESSAGE_COUNT
+};
+
+class EventLog {
+ public:
+  static const uint16_t CAPACITY = 128;            // records, a power of two
+  static const uint8_t MAX_LINE = 120;             // longest formatted record
+
+  // Any task: append a record. Use the LOG_* macros, which drop calls above
+  // JUKEBOX_LOG_LEVEL at compile time.
+  void write(uint8_t level, LogMessage message, int32_t a = 0, int32_t b = 0, int16_t c = 0);
+  void writeUid(uint8_t level, LogMessage message, const byte* uid, uint8_t size);
+
+  // Log task: print pending records to out, at most `budget` bytes, without
+  // splitting a record. Returns the number of records printed.
+  uint16_t drain(Print& out, size_t budget);
+
+  // Any task: records from sequence number `since` on that the ring still
+  // holds, one "seq ms level text" line each. Returns the sequence number
+  // to ask for next.
+  uint32_t printSince(Print& out, uint32_t since) const;
+
+  // Statistics
+  uint32_t written() const { return next_.load(std::memory_order_relaxed) - 1; }
+  uint32_t drained() const { return drained_; }
+  uint32_t dropped() const { return dropped_; }    // overwritten before the drain got to them
+
+ private:
+  struct Record {
+    std::atomic<uint32_t> seq{0};                  // 0 while being written
+    uint32_t ms;
+    uint8_t message;
+    uint8_t level;
+    int16_t c;
+    int32_t a;
+    int32_t b;
+  };
+
+  // Copy record seq out of the ring; false if it is not (or no longer) there
+  bool read(uint32_t seq, Record& copy) const;
+  // Track names (%t) come from the caller's own catalog reader: the shared
+  // one belongs to the player task
+  static size_t format(const Record& record, char* line, size_t size, SongCatalogReader& songs);
+
+  Record records_[CAPACITY];
+  std::atomic<uint32_t> next_{1};                  // sequence number of the next write
+  uint32_t drainNext_ = 1;                         // next record for the drain
+  SongCatalogReader drainSongs_;                   // song names for the drain
+  uint32_t drained_ = 0;
+  uint32_t dropped_ = 0;
+  uint32_t droppedUnreported_ = 0;
+};
+
+extern EventLog eventLog;
+
+#define LOG_ERROR(...) eventLog.write(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#if JUKEBOX_LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) eventLog.write(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+
+#if JUKEBOX_LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) eventLog.write(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_INFO_UID(message, uid) eventLog.writeUid(LOG_LEVEL_INFO, message, (uid).uidByte, (uid).size)
+#else
+#define LOG_INFO(...) ((void)0)
+#define LOG_INFO_UID(message, uid) ((void)0)
+#endif
+
+#if JUKEBOX_LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) eventLog.write(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#endif // EVENT_LOG_H
@@ -0,0 +1,99 @@
+/*
+   ESP32 RFID Jukebox - input events
+
+   Buttons and cards are sampled on their own tasks (see jukebox_tasks.h),
+   but what a press or a tap does to the player happens on the player task.
+   handleButtons() and handleRFID() push an InputEvent here and
+   handleInputEvents() pops and acts on them, so the player state keeps a
+   single writer. In programming mode the player task discards them.
+
+   On the ESP32 this is a FreeRTOS queue: safe with two producers, and the
+   player task sleeps in wait() until an event arrives or its next tick is
+   due. The native simulation runs every step from loop() on one thread and
+   uses a plain ring of the same capacity.
+*/
+
+#ifndef INPUT_EVENTS_H
+#define INPUT_EVENTS_H
+
+#include <Arduino.h>
+#include <atomic>
+#ifndef JUKEBOX_NATIVE
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#endif
+
+enum InputEventType : uint8_t {
+  INPUT_BUTTON,        // a button was pressed (value: InputButton)
+  INPUT_CARD           // a card was read (value: card number)
+};
+
+enum InputButton : uint8_t {
+  BUTTON_PLAY_PAUSE,
+  BUTTON_NEXT,
+  BUTTON_PREVIOUS,
+  BUTTON_SHUFFLE,
+  BUTTON_RESET
+};
+
+// What the button did (see button_input.h)
+enum ButtonGesture : uint8_t {
+  GESTURE_PRESS,       // pressed (or, with double press enabled, pressed once)
+  GESTURE_LONG,        // held; repeats while the button stays down
+  GESTURE_DOUBLE       // pressed twice in quick succession
+};
+
+// INPUT_BUTTON value: button in the low byte, gesture above it
+inline int32_t buttonEventValue(InputButton button, ButtonGesture gesture) {
+  return button | (int32_t)gesture << 8;
+}
+inline InputButton eventButton(int32_t value) { return (InputButton)(value & 0xFF); }
+inline ButtonGesture eventGesture(int32_t value) { return (ButtonGesture)(value >> 8); }
+
+struct InputEvent {
+  InputEventType type;
+  int32_t value;
+  uint32_t queuedUs;   // micros() of the input: the button edge, or when pushed
+};
+
+class InputEventQueue {
+ public:
+  static const uint8_t CAPACITY = 16;
+
+  // Create the queue; call once in setup() before any task pushes
+  void begin();
+
+  // Producer side (input and RFID tasks). False if the queue is full.
+  bool push(InputEventType type, int32_t value) { return push(type, value, micros()); }
+  // With the micros() at which the input happened, for edge -> action latency
+  bool push(InputEventType type, int32_t value, uint32_t sinceUs);
+
+  // Consumer side (player task). False when there is no event.
+  bool pop(InputEvent& event);
+
+  // Consumer side: block up to waitMs for an event without taking it
+  void wait(uint32_t waitMs);
+
+  // Consumer side: throw away every queued event (programming mode)
+  void clear();
+
+  // Statistics
+  uint32_t pushed() const { return pushed_.load(std::memory_order_relaxed); }
+  uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+  uint32_t maxLatencyUs() const { return maxLatencyUs_; }
+
+ private:
+#ifdef JUKEBOX_NATIVE
+  InputEvent ring_[CAPACITY];
+  uint8_t head_ = 0;
+  uint8_t count_ = 0;
+#else
+  QueueHandle_t queue_ = nullptr;
+#endif
+
+  std::atomic<uint32_t> pushed_{0};
+  std::atomic<uint32_t> dropped_{0};
+  uint32_t maxLatencyUs_ = 0;        // push -> pop, written by the consumer
+};
+
+#endif // INPUT_EVENTS_H
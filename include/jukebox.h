@@ -0,0 +1,136 @@
+/*
+   ESP32 RFID Jukebox - shared declarations
+
+   Globals and functions defined in main.cpp that are also used by the
+   other translation units (web server, native simulation benchmarks).
+*/
+
+#ifndef JUKEBOX_H
+#define JUKEBOX_H
+
+#include <Arduino.h>
+#include <MFRC522.h>
+#include <DFRobotDFPlayerMini.h>
+#include "dfplayer_scheduler.h"
+#include "web_command_queue.h"
+#include "web_response_ring.h"
+#include "card_cache.h"
+#include "play_queue.h"
+#include "player_events.h"
+#include "shuffle_order.h"
+#include "input_events.h"
+#include "jukebox_tasks.h"
+#include "rfid_detector.h"
+#include "card_record.h"
+#include "button_input.h"
+#include "loop_metrics.h"
+#include "event_log.h"
+#include "commands.h"
+#include "card_batch.h"
+#include "player_state.h"
+
+// ESP32 Pin definitions for RC522 (same as RFID programmer)
+#define RST_PIN         21          // Reset pin
+#define SS_PIN          5           // SDA (SS) pin
+#define RFID_IRQ_PIN    4           // IRQ pin, card detection interrupt (optional)
+#define RFID_DETECT_MODE RFID_DETECT_IRQ  // polling is used if IRQ is not wired
+
+// ESP32 Pin definitions for buttons (using safe GPIO pins)
+#define RESET_BUTTON    32          // Reset button (safe pin)
+#define PREV_BUTTON     33          // Previous track button (safe pin)
+#define NEXT_BUTTON     25          // Next track button (safe pin)
+#define PLAY_PAUSE_BUTTON 26        // Play/pause button (safe pin)
+#define SHUFFLE_BUTTON  27          // Shuffle button (safe pin)
+
+// Volume control constants
+#define MAX_VOLUME      30          // Maximum volume
+#define MIN_VOLUME      0           // Minimum volume
+
+// Hardware instances
+extern MFRC522 mfrc522;
+extern DFRobotDFPlayerMini myDFPlayer;
+extern DFPlayerScheduler playerScheduler;
+extern CardCache cardCache;
+extern RfidDetector rfidDetector;
+
+// Console input
+extern CommandLine serialLine;
+
+// Button presses and card reads on their way to the player task
+extern InputEventQueue inputEvents;
+extern ButtonInput buttonInput;
+
+// Web commands and their results
+extern WebCommandQueue webCommands;
+extern WebResponseRing webResponses;
+extern PlayerEvents playerEvents;
+
+// Programming mode steps (programmerMode() in main.cpp)
+enum ProgrammerState : uint8_t {
+  PROGRAM_IDLE,              // waiting for 'auto', 'manual' or 'read'
+  PROGRAM_AUTO_START,        // auto: waiting for the starting number
+  PROGRAM_AUTO,              // auto: numbering each card placed
+  PROGRAM_MANUAL,            // manual: waiting for a card
+  PROGRAM_MANUAL_NUMBER,     // manual: card selected, waiting for its number
+  PROGRAM_MANUAL_WRITE,      // manual: number typed, write it next pass
+  PROGRAM_BATCH,             // batch: writing and verifying a card_batch.h job
+  PROGRAM_READ               // read: printing the number of each card placed
+};
+
+// Player state
+extern boolean isPlaying;
+extern int currentSong;
+extern int currentVolume;
+extern bool jukeboxMode;
+extern ProgrammerState programmerState;
+
+// Custom shuffle state
+extern bool customShuffleMode;
+extern int shuffleIndex;
+extern int shuffleSize;
+extern ShuffleOrder shuffleOrder;
+
+// Play queue
+extern PlayQueue playQueue;
+extern bool cardQueueMode;
+
+// Main loop handlers
+void handleButtons();
+void handleRFID();
+void readDetectedCard();
+void readRecordCard();
+String switchRfidDetectMode();
+String rfidDetectReport();
+String buttonReport();
+void handleInputEvents();
+void handleButtonPress(InputButton button, ButtonGesture gesture);
+void handleSerialCommands();
+void checkAutoProgression();
+void performSystemCheck();
+
+// Playback
+void playCardNumber(int number);
+void startCustomShuffle();
+void playNextShuffleTrack();
+void announceShuffleTrack(int trackToPlay);
+bool enqueueTrack(int trackNumber);
+void playQueuedTrack();
+void announceQueuedTrack(int trackNumber);
+void printPlayQueue(Print& out);
+void armNextTrack();
+void announceArmedTrack();
+String getSongInfo(int trackNumber);
+bool resumePlayerState();
+
+// WiFi and web interface
+void setupWiFi();
+void handleWiFiConnection();
+void setupWebServer();
+void handleWebCommands();
+
+// Modes; false if already in that mode
+bool enterProgrammerMode();
+bool enterJukeboxMode();
+void startCardBatch(const CardBatchSpec& spec);
+
+#endif // JUKEBOX_H
@@ -0,0 +1,123 @@
+/*
+   ESP32 RFID Jukebox - subsystem tasks
+
+   setup() starts one FreeRTOS task per subsystem instead of running
+   everything from loop():
+
+     task     core  prio  stack  runs
+     input      1     4   3072   on a button interrupt or a debounce/gesture
+                                 timer, else every 100 ms: button edges ->
+                                 input events
+     player     1     3   8192   on an input event, at most 2 ms apart:
+                                 DFPlayer scheduler, web commands, input
+                                 events, console, auto-progression,
+                                 programmer mode, state events
+     rfid       1     2   6144   every 10 ms, or on the RC522 IRQ: card detect
+                                 and read -> input events
+     network    0     1   4096   every 100 ms until WiFi is up or timed
+                                 out: WiFi bring-up (reconnects are left
+                                 to the WiFi driver's auto-reconnect)
+     log        0     1   3072   every 10 ms: event log -> Serial, as much as
+                                 the UART TX FIFO takes (see event_log.h)
+
+   Core 0 is left to the WiFi stack and the web server (async_tcp), with the
+   network and log tasks beside them; the sketch's own work is on core 1. Input
+   outranks the player so a press is never held up by a track change, and
+   RFID is lowest on core 1 because a card read keeps the SPI bus for
+   milliseconds nobody else should wait on.
+
+   The tasks talk through queues: inputEvents (buttons and cards -> player)
+   and webCommands (web server -> player). The reader and the card cache
+   are used by both the RFID task and the player task (programmer mode,
+   'k'), which take them with lockReader().
+
+   Every task times its own work. 's' and /api/tasks show, per task, the
+   CPU load over the last second, the longest single run and the stack
+   high-water mark (least free stack seen), to tune the table above.
+
+   In the native simulation, or if a task cannot be created, loop() runs
+   the same steps one after the other.
+*/
+
+#ifndef JUKEBOX_TASKS_H
+#define JUKEBOX_TASKS_H
+
+#include <Arduino.h>
+
+enum JukeboxTask : uint8_t {
+  TASK_INPUT,
+  TASK_PLAYER,
+  TASK_RFID,
+  TASK_NETWORK,
+  TASK_LOG,
+  JUKEBOX_TASK_COUNT
+};
+
+struct JukeboxTaskConfig {
+  const char* name;
+  uint8_t core;
+  uint8_t priority;
+  uint16_t stackBytes;
+  uint16_t periodMs;
+};
+
+class TaskStats {
+ public:
+  static const uint32_t WINDOW_US = 1000000;
+
+  void begin() { startUs_ = micros(); }
+  void end();
+
+  float load() const { return load_; }          // % of one core, last window
+  uint32_t maxUs() const { return maxUs_; }     // longest run
+  uint32_t runs() const { return runs_; }
+
+ private:
+  uint32_t startUs_ = 0;
+  uint32_t windowStartUs_ = 0;
+  uint32_t windowBusyUs_ = 0;
+  uint32_t maxUs_ = 0;
+  uint32_t runs_ = 0;
+  float load_ = 0;
+};
+
+// Steps of each subsystem, in main.cpp
+void inputStep();
+void playerStep();
+void rfidStep();
+void networkStep();
+void logStep();
+
+// Start the subsystem tasks; false (and loop() keeps running the steps) if
+// one could not be created
+bool startJukeboxTasks();
+bool jukeboxTasksRunning();
+
+// One pass of every step, timed, for loop() when the tasks are not running
+void runJukeboxStepsOnce();
+
+// Called from loop() once the tasks are running: ends the loop task
+void retireLoopTask();
+
+// From an interrupt handler: wake a task waiting for its next run (the
+// RFID task sleeps between passes until the RC522 IRQ fires or its period
+// ends, the input task until a button edge or its next timer)
+void wakeTaskFromIsr(JukeboxTask task);
+
+// Reader and card cache, shared by the RFID and player tasks
+void lockReader();
+void unlockReader();
+
+const JukeboxTaskConfig& taskConfig(JukeboxTask task);
+const TaskStats& taskStats(JukeboxTask task);
+
+// Least free stack seen in bytes, 0 if the task is not running
+uint32_t taskStackFree(JukeboxTask task);
+
+// "player core 1 prio 3: 2.4% CPU, max 812 us, 5120 of 8192 B stack free"
+String taskReportLine(JukeboxTask task);
+
+// {"tasks":[{"name":"input","core":1,...},...],"running":true,"inputEvents":{...}}
+String taskReportJson();
+
+#endif // JUKEBOX_TASKS_H
@@ -0,0 +1,88 @@
+/*
+   ESP32 RFID Jukebox - step timing histograms for /api/metrics
+
+   The handlers that make up the jukebox's work - buttons, RFID, console,
+   auto-progression, WiFi and every DFPlayer UART transfer - time each
+   call with the CPU cycle counter (two register reads, no system call)
+   and add it to a fixed-bucket histogram:
+
+     le   10 50 100 500 us   1 5 10 50 100 500 ms   +Inf
+
+   METRIC_TIMER(step) at the top of a function times the rest of it.
+
+   The player task (the old loop() body) counts its passes: the pass rate
+   over the last second is the loop frequency, the gaps between passes go
+   into a histogram of their own, and the longest gap since boot is the
+   worst loop stall.
+
+   writeMetrics() prints everything in the Prometheus text format, with the
+   free heap and the event log counters, for /api/metrics. Each histogram
+   has a single writer (the task its step runs on); a scrape reads without
+   locking, and clamps the buckets to the _count it read so a sample
+   landing meanwhile cannot make them inconsistent.
+*/
+
+#ifndef LOOP_METRICS_H
+#define LOOP_METRICS_H
+
+#include <Arduino.h>
+
+enum MetricStep : uint8_t {
+  METRIC_BUTTONS,            // handleButtons()
+  METRIC_RFID,               // handleRFID()
+  METRIC_SERIAL,             // handleSerialCommands()
+  METRIC_AUTOPROGRESSION,    // checkAutoProgression()
+  METRIC_WIFI,               // handleWiFiConnection()
+  METRIC_DFPLAYER_TX,        // DFPlayer frame written to the UART
+  METRIC_DFPLAYER_RX,        // DFPlayer UART receive buffer drained
+  METRIC_STEP_COUNT
+};
+
+class StepHistogram {
+ public:
+  static const uint8_t BUCKETS = 10;               // finite buckets, +Inf is count()
+  static const uint32_t BOUNDS_US[BUCKETS];
+
+  void record(uint32_t us);
+
+  uint32_t bucket(uint8_t i) const { return buckets_[i]; }  // not cumulative
+  uint32_t count() const { return count_; }
+  uint64_t sumUs() const { return sumUs_; }
+  uint32_t maxUs() const { return maxUs_; }
+
+ private:
+  uint32_t buckets_[BUCKETS] = {};
+  uint32_t count_ = 0;
+  uint64_t sumUs_ = 0;
+  uint32_t maxUs_ = 0;
+};
+
+// Add one call of `cycles` CPU cycles
+void recordStep(MetricStep step, uint32_t cycles);
+
+const StepHistogram& stepHistogram(MetricStep step);
+
+// Times the enclosing scope
+class MetricTimer {
+ public:
+  explicit MetricTimer(MetricStep step) : step_(step), start_(ESP.getCycleCount()) {}
+  ~MetricTimer() { recordStep(step_, ESP.getCycleCount() - start_); }
+
+ private:
+  MetricStep step_;
+  uint32_t start_;
+};
+
+#define METRIC_TIMER(step) MetricTimer metricTimer_(step)
+
+// Once per player pass
+void countLoopPass();
+
+float loopFrequency();                             // passes/s, last second
+uint32_t maxLoopStallUs();                         // longest gap between passes
+const StepHistogram& loopGapHistogram();           // every gap between passes
+
+// Prometheus text format (version 0.0.4)
+void writeMetrics(Print& out);
+
+#endif // LOOP_METRICS_H
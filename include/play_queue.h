@@ -0,0 +1,51 @@
+/*
+   ESP32 RFID Jukebox - play queue
+
+   Tracks lined up to play after the current one, oldest first. Filled from
+   cards (in card queue mode), the web interface (/queue, batch "queue N")
+   and the console; drained by the next button/command and when a track
+   ends. Queued tracks come before the shuffle order, which continues once
+   the queue is empty.
+
+   A fixed ring of track numbers, used only from the loop task (web
+   requests reach it through the web command queue).
+*/
+
+#ifndef PLAY_QUEUE_H
+#define PLAY_QUEUE_H
+
+#include <Arduino.h>
+
+class PlayQueue {
+ public:
+  static const uint8_t CAPACITY = 32;
+
+  // Append a track; false if the queue is full
+  bool push(uint16_t track);
+
+  // Take the oldest track; false if the queue is empty
+  bool pop(uint16_t& track);
+
+  // Oldest track without taking it, 0 when empty
+  uint16_t peek() const { return count_ ? tracks_[head_] : 0; }
+
+  // i-th queued track, 0 = next to play
+  uint16_t at(uint8_t i) const { return i < count_ ? tracks_[(head_ + i) % CAPACITY] : 0; }
+
+  void clear() { head_ = 0; count_ = 0; }
+  uint8_t size() const { return count_; }
+
+  // Statistics
+  uint32_t enqueued() const { return enqueued_; }
+  uint32_t dropped() const { return dropped_; }
+
+ private:
+  uint16_t tracks_[CAPACITY];
+  uint8_t head_ = 0;
+  uint8_t count_ = 0;
+
+  uint32_t enqueued_ = 0;
+  uint32_t dropped_ = 0;
+};
+
+#endif // PLAY_QUEUE_H
@@ -0,0 +1,91 @@
+/*
+   ESP32 RFID Jukebox - player events
+
+   Pushes command results and player state to the browser over one
+   long-lived Server-Sent Events connection (/events), so the web page no
+   longer has to wait and poll /response after every action.
+
+   Two events, both produced on the player task:
+
+     result  the text a web command returned; the SSE id is the command's
+             ticket, so a page only shows the results of its own commands
+     state   {"track":3,"title":"...","artist":"...","playing":true,
+              "volume":30,"shuffle":true,"shufflePos":4,"shuffleSize":41,
+              "queued":2,"jukebox":true}
+             sent when any field changes, at most every STATE_INTERVAL_MS
+             so a burst of volume steps goes out as one event
+
+   The transport is a sink function: web_server.cpp hands the events to
+   async_tcp, which sends them on its AsyncEventSource; the native
+   benchmarks record the events.
+*/
+
+#ifndef PLAYER_EVENTS_H
+#define PLAYER_EVENTS_H
+
+#include <Arduino.h>
+#include <atomic>
+
+class PlayerEvents {
+ public:
+  // id 0 = no SSE id field
+  typedef void (*Sink)(const char* event, const char* data, uint32_t id);
+
+  static const uint32_t STATE_INTERVAL_MS = 100;
+
+  // Fixed fields plus title and artist, each escaped to at most 2 x 255 bytes
+  static const uint16_t STATE_JSON_SIZE = 160 + 4 * 255;
+
+  void setSink(Sink sink) { sink_ = sink; }
+
+  // Player task: send a state event if the state changed
+  void update();
+
+  // Player task: send the result of the web command with this ticket
+  void commandResult(uint32_t ticket, const String& result);
+
+  // Any task: send the full state with the next update() (a client connected)
+  void requestState() { resend_.store(true, std::memory_order_relaxed); }
+
+  // Statistics
+  uint32_t stateEvents() const { return stateEvents_; }
+  uint32_t resultEvents() const { return resultEvents_; }
+  uint32_t coalesced() const { return coalesced_; }
+
+ private:
+  struct State {
+    int track;
+    int volume;
+    int shufflePos;
+    int shuffleSize;
+    int queued;
+    bool playing;
+    bool shuffle;
+    bool jukebox;
+
+    bool operator==(const State& other) const {
+      return track == other.track && volume == other.volume &&
+             shufflePos == other.shufflePos && shuffleSize == other.shuffleSize &&
+             queued == other.queued &&
+             playing == other.playing && shuffle == other.shuffle &&
+             jukebox == other.jukebox;
+    }
+  };
+
+  static State capture();
+  void sendState(const State& state);
+
+  Sink sink_ = nullptr;
+  State sent_ = {};                     // state of the last event
+  State seen_ = {};                     // state at the last update()
+  bool changed_ = false;                // seen_ changed since the last event
+  uint32_t lastStateMs_ = 0;
+  std::atomic<bool> resend_{true};
+  char json_[STATE_JSON_SIZE];
+
+  uint32_t stateEvents_ = 0;
+  uint32_t resultEvents_ = 0;
+  uint32_t coalesced_ = 0;              // changes merged into a later event
+};
+
+#endif // PLAYER_EVENTS_H
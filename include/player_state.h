@@ -0,0 +1,94 @@
+/*
+   ESP32 RFID Jukebox - saved player state
+
+   Keeps volume, current track, play/pause and the shuffle position in NVS
+   (Preferences, namespace "jukebox"), so a restart - the reset button, the
+   'r' command, the DFPlayer recovery in performSystemCheck() - or a power
+   cut comes back where it left off. resumePlayerState() in main.cpp loads
+   it at boot and starts the track again from its beginning; the DFPlayer
+   cannot seek within a track.
+
+   The shuffle order itself is not stored: ShuffleOrder computes it from a
+   seed and a cycle number, so those two plus the position are the whole
+   playlist, whether the catalog has 41 songs or 10000.
+
+   Writes are coalesced the way PlayerEvents coalesces state events:
+   update() compares the state with the last one it saw on every player
+   pass, and writes only once nothing has changed for SAVE_DELAY_MS. Ten
+   presses of '+' are one write of the final volume; a change that is
+   undone before the delay runs out is never written. State that keeps
+   changing is written at least every MAX_SAVE_DELAY_MS. flush() writes
+   at once and runs before every ESP.restart(); a power cut loses the
+   changes of the last few seconds.
+
+   The record is one 20-byte blob, three 32-byte NVS entries per write.
+   NVS fills its pages in turn and erases one only to reuse it: a page
+   holds 126 entries, 42 writes, so each page of the default 20 KB
+   partition is erased roughly once every 200 writes.
+*/
+
+#ifndef PLAYER_STATE_H
+#define PLAYER_STATE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+class PlayerStateStore {
+ public:
+  static const uint32_t SAVE_DELAY_MS = 5000;       // quiet time before a write
+  static const uint32_t MAX_SAVE_DELAY_MS = 60000;  // longest a change waits
+
+  struct State {
+    uint8_t version;
+    uint8_t volume;
+    uint8_t flags;                      // FLAG_* below
+    uint8_t reserved;
+    uint16_t track;                     // currentSong, 0 = none
+    uint16_t shuffleIndex;              // next position in the shuffle cycle
+    uint16_t shuffleSize;               // catalog size the order was made for
+    uint16_t reserved2;
+    uint32_t shuffleSeed;
+    uint32_t shuffleCycle;
+
+    bool operator==(const State& other) const {
+      return memcmp(this, &other, sizeof(State)) == 0;
+    }
+  };
+
+  static const uint8_t VERSION = 1;
+  static const uint8_t FLAG_PLAYING = 0x01;
+  static const uint8_t FLAG_SHUFFLE = 0x02;
+  static const uint8_t FLAG_SWAPPED_FIRST = 0x04;   // ShuffleOrder::swappedFirst()
+
+  // Open the namespace and read the saved state; false if there is none
+  bool begin(State& saved);
+
+  // Player task: note state changes, write once they have settled
+  void update();
+
+  // Write pending changes now (before a restart)
+  void flush();
+
+  // Statistics
+  uint32_t changes() const { return changes_; }    // state changes seen
+  uint32_t saves() const { return saves_; }        // NVS writes
+  uint32_t coalesced() const { return changes_ > saves_ ? changes_ - saves_ : 0; }
+
+ private:
+  static State capture();
+
+  Preferences prefs_;
+  bool open_ = false;
+  State saved_ = {};                    // what NVS holds
+  State seen_ = {};                     // state at the last update()
+  bool dirty_ = false;                  // seen_ not written yet
+  uint32_t firstChangeMs_ = 0;          // oldest change not written
+  uint32_t lastChangeMs_ = 0;
+
+  uint32_t changes_ = 0;
+  uint32_t saves_ = 0;
+};
+
+extern PlayerStateStore playerStateStore;
+
+#endif // PLAYER_STATE_H
@@ -0,0 +1,90 @@
+/*
+   ESP32 RFID Jukebox - RC522 card detection
+
+   How handleRFID() finds out that a card has been placed on the reader:
+
+   RFID_DETECT_POLL calls PICC_IsNewCardPresent() on every pass. Each call
+   sends a REQA and waits for an answer that, without a card, never comes:
+   about a dozen register accesses and a millisecond of SPI traffic per
+   pass, all the time.
+
+   RFID_DETECT_IRQ uses the reader's IRQ pin. The RC522 cannot sense a card
+   on its own, so each pass still sends a REQA, but without waiting: four
+   register writes (clear interrupts, REQA into the FIFO, Transceive,
+   StartSend) and back to sleep. Only when a card answers does the chip
+   raise RxIRq, the IRQ line falls and the ISR wakes the RFID task, which
+   then selects and reads the card as before.
+
+   begin() checks the IRQ wiring by setting an interrupt bit in the chip
+   and watching for the edge. With no edge (IRQ not connected) the
+   detector stays in polling mode, which also remains selectable at run
+   time ('i').
+
+   Statistics cover the time since the mode was set: detection passes,
+   SPI transactions (counted for IRQ mode; POLL_SPI per pass for polling,
+   the accesses the library makes for an unanswered REQA) and the CPU time
+   spent in cardPresent().
+*/
+
+#ifndef RFID_DETECTOR_H
+#define RFID_DETECTOR_H
+
+#include <Arduino.h>
+#include <MFRC522.h>
+
+enum RfidDetectMode : uint8_t {
+  RFID_DETECT_POLL,
+  RFID_DETECT_IRQ
+};
+
+class RfidDetector {
+ public:
+  static const uint8_t POLL_SPI = 12;       // register accesses per unanswered poll
+  static const uint8_t ARM_SPI = 4;         // register writes per REQA sent in IRQ mode
+
+  // Attach the IRQ pin and test the line; falls back to polling if it is silent
+  void begin(MFRC522& reader, uint8_t irqPin, RfidDetectMode mode);
+
+  // Switch modes; false if IRQ mode is asked for but the line failed its test
+  bool setMode(RfidDetectMode mode);
+  RfidDetectMode mode() const { return mode_; }
+  bool irqWorks() const { return irqWorks_; }
+
+  // True when a card answered: a poll, or (IRQ) the interrupt since the
+  // last pass. Otherwise, in IRQ mode, sends the next REQA.
+  bool cardPresent();
+
+  // After a detected card has been handled: clear the chip's interrupts
+  // raised while it was read
+  void cardDone();
+
+  // Statistics since the mode was set
+  uint32_t passes() const { return passes_; }
+  uint32_t interrupts() const { return interrupts_; }
+  uint32_t spiTransactions() const { return spiTransactions_; }
+  uint32_t cpuUs() const { return cpuUs_; }
+  float spiPerSecond() const;
+  float cpuPercent() const;
+
+  static const char* modeName(RfidDetectMode mode);
+
+ private:
+  static void IRAM_ATTR onIrq();
+  void clearInterrupts();
+  void resetStats();
+
+  static volatile bool irqFlag_;
+  static volatile uint32_t irqCount_;
+
+  MFRC522* reader_ = nullptr;
+  RfidDetectMode mode_ = RFID_DETECT_POLL;
+  bool irqWorks_ = false;
+
+  uint32_t passes_ = 0;
+  uint32_t interrupts_ = 0;
+  uint32_t spiTransactions_ = 0;
+  uint32_t cpuUs_ = 0;
+  uint32_t sinceMs_ = 0;
+};
+
+#endif // RFID_DETECTOR_H
@@ -0,0 +1,62 @@
+/*
+   ESP32 RFID Jukebox - shuffle order
+
+   A random order of tracks 1..size that is computed, not stored: position
+   p of the current cycle maps to a track through a 4-round Feistel
+   network over the smallest even number of bits that covers the catalog,
+   and values outside the catalog are walked through the network again
+   (cycle walking) until they land in it. The network is a permutation, so
+   every track comes up exactly once per cycle, and any position can be
+   looked up directly. The state is the seed and the cycle number, a dozen
+   bytes for 41 songs or for 10000.
+
+   Each cycle derives its round keys from (seed, cycle), so the same seed
+   replays the same sequence of cycles. If a new cycle would open with the
+   track that closed the previous one, its first two positions are swapped:
+   no track plays twice in a row across a reshuffle.
+
+   Saving seed, cycle and that swap flag is enough to pick the order up
+   again after a restart (player_state.h).
+*/
+
+#ifndef SHUFFLE_ORDER_H
+#define SHUFFLE_ORDER_H
+
+#include <Arduino.h>
+
+class ShuffleOrder {
+ public:
+  static const uint8_t ROUNDS = 4;
+
+  // Start cycle 0 of a new order over tracks 1..size
+  void begin(uint16_t size, uint32_t seed);
+
+  // Move on to the next cycle (a different order)
+  void nextCycle();
+
+  // Continue an order saved as seed(), cycle() and swappedFirst()
+  void resume(uint16_t size, uint32_t seed, uint32_t cycle, bool swappedFirst);
+
+  // Track at position 0..size-1 of the current cycle, 0 if out of range
+  uint16_t at(uint16_t position) const;
+
+  // Track at position; size or beyond is the first track of the next cycle
+  uint16_t upcoming(uint16_t position) const;
+
+  uint16_t size() const { return size_; }
+  uint32_t seed() const { return seed_; }
+  uint32_t cycle() const { return cycle_; }
+  bool swappedFirst() const { return swapFirst_; }
+
+ private:
+  uint32_t permute(uint32_t value) const;
+  uint32_t roundKey(uint8_t round) const;
+
+  uint32_t seed_ = 0;
+  uint32_t cycle_ = 0;
+  uint16_t size_ = 0;
+  uint8_t halfBits_ = 1;                // bits per Feistel half
+  bool swapFirst_ = false;              // positions 0 and 1 swapped this cycle
+};
+
+#endif // SHUFFLE_ORDER_H
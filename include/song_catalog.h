@@ -0,0 +1,82 @@
+/*
+   ESP32 RFID Jukebox - song catalog
+
+   Titles and artists of the songs on the SD card. Two sources:
+
+   - /catalog.bin on SPIFFS, for collections of any size. Only the file
+     handle stays open; a lookup reads one fixed-width index entry and then
+     the one record it points to, so RAM use does not grow with the number
+     of songs. The song count is read from the file at boot.
+   - The built-in table generated at build time from SONG_REFERENCE.md
+     (scripts/gen_song_catalog.py), used when there is no catalog file.
+
+   Catalog file layout (little-endian):
+
+     "JBS" 0x01  uint32 count            header, 8 bytes
+     uint32 offset[count + 1]            record i runs offset[i]..offset[i+1]
+     [len][title]\0[len][artist]\0       one record per song
+
+   scripts/gen_song_catalog.py writes data/catalog.bin together with the
+   built-in table; upload it with "pio run -t uploadfs".
+*/
+
+#ifndef SONG_CATALOG_H
+#define SONG_CATALOG_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+struct SongInfo {
+  const char* title;        // NUL-terminated
+  const char* artist;
+  uint8_t titleLength;
+  uint8_t artistLength;
+};
+
+// Reads songs through its own file handle and record buffer. The global
+// functions below share one reader and belong to the loop task; code on
+// other tasks (web handlers) uses a reader of its own.
+class SongCatalogReader {
+ public:
+  // Open the catalog chosen by beginSongCatalog(); always true for the
+  // built-in table
+  bool open();
+  void close();
+
+  // Same contract as lookupSong(); file entries live in this reader's buffer
+  bool lookup(int trackNumber, SongInfo& info);
+
+  // Same output as printSongInfo(); opens the reader on first use
+  void print(Print& out, int trackNumber);
+
+ private:
+  static const uint16_t MAX_RECORD = 2 * (1 + 255 + 1);
+
+  File file_;
+  char record_[MAX_RECORD];
+  int recordTrack_ = 0;                 // track held in record_
+  bool opened_ = false;
+};
+
+// Open the catalog file; false (built-in table in use) if missing or invalid
+bool beginSongCatalog(fs::FS& fs, const char* path = "/catalog.bin");
+
+// Number of songs in the catalog (card numbers 1..songCount())
+uint16_t songCount();
+
+// True when songs come from the SPIFFS catalog file
+bool songCatalogFromFile();
+
+// Title and artist of a track; false for numbers outside the catalog.
+// Built-in entries point into flash; entries read from the catalog file
+// point into a shared buffer that the next lookup overwrites.
+bool lookupSong(int trackNumber, SongInfo& info);
+
+// Single fields, nullptr for numbers outside the catalog (same lifetime)
+const char* songTitle(int trackNumber);
+const char* songArtist(int trackNumber);
+
+// Print "Title - Artist" (or "Unknown Track #n") without building a String
+void printSongInfo(Print& out, int trackNumber);
+
+#endif // SONG_CATALOG_H
@@ -0,0 +1,70 @@
+/*
+   ESP32 RFID Jukebox - song catalog data
+
+   GENERATED by scripts/gen_song_catalog.py from SONG_REFERENCE.md.
+   Do not edit; change the song table and rebuild.
+
+   Each song is two fields, title then artist, and each field is a
+   length byte, the UTF-8 text and a terminating NUL.
+*/
+
+#ifndef SONG_CATALOG_DATA_H
+#define SONG_CATALOG_DATA_H
+
+#include <stdint.h>
+
+#define SONG_CATALOG_COUNT 41
+
+static constexpr char SONG_CATALOG_DATA[] =
+  /*   1 */ "\x1C" "Did Jesus Have a Baby Sister" "\0" "\x0B" "Dory Previn" "\0"
+  /*   2 */ "\x10" "That's All Right" "\0" "\x0D" "Elvis Presley" "\0"
+  /*   3 */ "\x07" "Hey Joe" "\0" "\x0C" "Jimi Hendrix" "\0"
+  /*   4 */ "\x0C" "Delia's Gone" "\0" "\x0B" "Johnny Cash" "\0"
+  /*   5 */ "\x0A" "In Da Club" "\0" "\x07" "50 Cent" "\0"
+  /*   6 */ "\x1B" "Keep the Customer Satisfied" "\0" "\x11" "Simon & Garfunkel" "\0"
+  /*   7 */ "\x0B" "Thrift Shop" "\0" "\x17" "Macklemore & Ryan Lewis" "\0"
+  /*   8 */ "\x07" "Old Man" "\0" "\x0A" "Neil Young" "\0"
+  /*   9 */ "\x16" "Never Going Back Again" "\0" "\x0D" "Fleetwood Mac" "\0"
+  /*  10 */ "\x24" "Norwegian Wood (This Bird Has Flown)" "\0" "\x0B" "The Beatles" "\0"
+  /*  11 */ "\x0A" "Chain Gang" "\0" "\x09" "Sam Cooke" "\0"
+  /*  12 */ "\x0A" "Yakety Yak" "\0" "\x0C" "The Coasters" "\0"
+  /*  13 */ "\x14" "I've Been Everywhere" "\0" "\x0B" "Johnny Cash" "\0"
+  /*  14 */ "\x0D" "Thunderstruck" "\0" "\x05" "AC/DC" "\0"
+  /*  15 */ "\x0D" "Duurt Te Lang" "\0" "\x0F" "Davina Michelle" "\0"
+  /*  16 */ "\x12" "Alles Gaat Voorbij" "\0" "\x08" "Doe Maar" "\0"
+  /*  17 */ "\x0B" "The Painter" "\0" "\x0B" "William Ben" "\0"
+  /*  18 */ "\x05" "Think" "\0" "\x0F" "Aretha Franklin" "\0"
+  /*  19 */ "\x12" "Scotland the Brave" "\0" "\x16" "Auld Town Band & Pipes" "\0"
+  /*  20 */ "\x0D" "Single Ladies" "\0" "\x08" "Beyonc\xC3" "\xA9" "\0"
+  /*  21 */ "\x0F" "Grandma's Hands" "\0" "\x0C" "Bill Withers" "\0"
+  /*  22 */ "\x0A" "Without Me" "\0" "\x06" "Eminem" "\0"
+  /*  23 */ "\x0B" "Spraakwater" "\0" "\x07" "Extince" "\0"
+  /*  24 */ "\x11" "King of the World" "\0" "\x0D" "First Aid Kit" "\0"
+  /*  25 */ "\x0C" "Komodovaraan" "\0" "\x10" "Yentl en De Boer" "\0"
+  /*  26 */ "\x25" "Look What They've Done To My Song, Ma" "\0" "\x07" "Melanie" "\0"
+  /*  27 */ "\x1A" "The Man Who Sold The World" "\0" "\x07" "Nirvana" "\0"
+  /*  28 */ "\x09" "Rotterdam" "\0" "\x0D" "Pokey LaFarge" "\0"
+  /*  29 */ "\x0E" "'t Roeie Klied" "\0" "\x0B" "Rowwen Heze" "\0"
+  /*  30 */ "\x12" "You Never Can Tell" "\0" "\x0B" "Chuck Berry" "\0"
+  /*  31 */ "\x16" "Sit Still, Look Pretty" "\0" "\x04" "Daya" "\0"
+  /*  32 */ "\x12" "Gangsta's Paradise" "\0" "\x0F" "Coolio ft. L.V." "\0"
+  /*  33 */ "\x12" "Me And Bobby McGee" "\0" "\x0C" "Janis Joplin" "\0"
+  /*  34 */ "\x09" "Big River" "\0" "\x0B" "Johnny Cash" "\0"
+  /*  35 */ "\x1A" "Non, Non, Rien N'a Chang\xC3" "\xA9" "\0" "\x0A" "Les Poppys" "\0"
+  /*  36 */ "\x16" "Over in the Glory Land" "\0" "\x1B" "The Broken Circle Breakdown" "\0"
+  /*  37 */ "\x15" "Hell's Comin' With Me" "\0" "\x11" "Poor Man's Poison" "\0"
+  /*  38 */ "\x19" "A far l'amore comincia tu" "\0" "\x10" "Raffaella Carr\xC3" "\xA0" "\0"
+  /*  39 */ "\x0F" "Auto, Vliegtuug" "\0" "\x0C" "Rowwen H\xC3" "\xA8" "ze" "\0"
+  /*  40 */ "\x1C" "Stuck In The Middle With You" "\0" "\x0E" "Stealers Wheel" "\0"
+  /*  41 */ "\x0A" "Lonely Boy" "\0" "\x0E" "The Black Keys" "\0";
+
+// Offset of each song's title field, index = card number - 1
+static constexpr uint16_t SONG_CATALOG_OFFSETS[SONG_CATALOG_COUNT] = {
+  0, 43, 76, 99, 126, 147, 195, 233, 254, 293,
+  344, 367, 393, 428, 450, 482, 512, 538, 562, 606,
+  631, 662, 682, 704, 738, 770, 818, 855, 881, 910,
+  943, 973, 1010, 1044, 1068, 1108, 1161, 1203, 1248, 1279,
+  1325,
+};
+
+#endif // SONG_CATALOG_DATA_H
@@ -0,0 +1,62 @@
+/*
+   ESP32 RFID Jukebox - streamed JSON song list
+
+   Produces the /api/songs body piece by piece for AsyncWebServer's chunked
+   response callback, so the song list is never held in one String:
+
+     {"total":41,"offset":0,"count":2,"songs":[
+       {"n":1,"title":"...","artist":"..."},{"n":2,...}]}
+
+   Each read() renders at most one song into a fixed pending buffer and
+   copies as much as fits into the TCP buffer it was given. Memory use is
+   this object (about 1.5 KB) no matter how many songs are listed. Songs are
+   read through a SongCatalogReader of its own, since the callback runs on
+   the async_tcp task.
+*/
+
+#ifndef SONG_LIST_JSON_H
+#define SONG_LIST_JSON_H
+
+#include <Arduino.h>
+#include "song_catalog.h"
+
+class SongListJson {
+ public:
+  // Songs offset+1 .. offset+limit, clipped to the catalog
+  bool begin(uint32_t offset, uint32_t limit);
+
+  // Copy the next bytes of the body into buffer; 0 once the body is complete
+  size_t read(uint8_t* buffer, size_t maxLen);
+
+  uint32_t count() const { return end_ - first_; }
+
+  // Write text as the inside of a JSON string (quotes, backslashes and
+  // newlines escaped, other control characters as spaces); stops when out
+  // has no room.
+  // Returns the bytes written, at most 2 * length.
+  static size_t escape(char* out, size_t room, const char* text, size_t length);
+
+ private:
+  // One song: {"n":65535,"title":"...","artist":"..."} with every byte of
+  // both fields escaped to at most two characters
+  static const uint16_t PENDING_SIZE = 40 + 4 * 255;
+
+  enum Stage : uint8_t { HEADER, SONGS, FOOTER, DONE };
+
+  void render();
+  void append(const char* text);
+  void appendEscaped(const char* text, uint8_t length);
+
+  SongCatalogReader reader_;
+  uint32_t offset_ = 0;
+  uint32_t first_ = 0;                  // first track to list
+  uint32_t end_ = 0;                    // one past the last track
+  uint32_t next_ = 0;
+  Stage stage_ = DONE;
+
+  char pending_[PENDING_SIZE];
+  uint16_t pendingLength_ = 0;
+  uint16_t pendingPos_ = 0;
+};
+
+#endif // SONG_LIST_JSON_H
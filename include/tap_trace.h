@@ -0,0 +1,32 @@
+/*
+   ESP32 RFID Jukebox - tap-to-audio stage markers
+
+   handleRFID() and playCardNumber() mark each stage of a card tap with
+   TAP_TRACE(). In the native build the markers are timestamped on the
+   virtual clock for the tap latency benchmark (sim/src/bench_tap.cpp); on
+   the ESP32 they compile to nothing.
+*/
+
+#ifndef TAP_TRACE_H
+#define TAP_TRACE_H
+
+enum TapStage {
+  TAP_DETECT,     // PICC_IsNewCardPresent() saw a card
+  TAP_SELECT,     // UID read and card selected
+  TAP_AUTH,       // sector authenticated
+  TAP_READ,       // data block read
+  TAP_PARSE,      // card number decoded
+  TAP_DISPATCH,   // playCardNumber() entered
+  TAP_UART,       // DFPlayer play command handed to the UART
+  TAP_DONE,       // handleRFID() returning to loop()
+  TAP_STAGE_COUNT
+};
+
+#ifdef JUKEBOX_NATIVE
+void tapTrace(TapStage stage);
+#define TAP_TRACE(stage) tapTrace(stage)
+#else
+#define TAP_TRACE(stage) ((void)0)
+#endif
+
+#endif // TAP_TRACE_H
@@ -0,0 +1,55 @@
+/*
+   ESP32 RFID Jukebox - compressed web assets
+
+   scripts/build_web_assets.py minifies and gzips the browser UI in data/
+   at build time. SPIFFS then holds only /index.html.gz (and any other
+   .css/.js/.json/.svg as <name>.gz), plus /assets.idx, one line per asset:
+
+     /index.html /index.html.gz "17787e223309e867"
+
+   The quoted value is a strong ETag, a hash of the gzipped bytes, so it
+   changes exactly when the uploaded file does. beginWebAssets() reads the
+   index once at boot; the web server then answers a request for an asset
+   without touching the filesystem to look for it:
+
+   - If-None-Match carrying the asset's ETag: 304, no body, no flash read
+   - otherwise: 200 with the .gz file and Content-Encoding: gzip
+
+   HTML pages are sent with "Cache-Control: no-cache" - the browser keeps
+   them but asks again on every load, which costs one 304 - so a new
+   uploadfs shows up on the next reload. Other assets may be used for a
+   day without asking.
+
+   Without /assets.idx (a filesystem image from before the pipeline), the
+   server falls back to sending /index.html as it is.
+*/
+
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+struct WebAsset {
+  char path[32];            // URL, "/index.html"
+  char file[32];            // SPIFFS file, "/index.html.gz"
+  char etag[20];            // with quotes, as sent in the ETag header
+  const char* contentType;
+  const char* cacheControl;
+};
+
+// Read the asset index; false (no compressed assets) if it is missing
+bool beginWebAssets(fs::FS& fs, const char* path = "/assets.idx");
+
+// Number of assets in the index
+uint8_t webAssetCount();
+const WebAsset& webAsset(uint8_t i);
+
+// Asset served at this URL ("/" is "/index.html"), nullptr if none
+const WebAsset* findWebAsset(const char* path);
+
+// True if an If-None-Match value ("*", or a list of tags, weak or strong)
+// names this ETag, so the browser's copy can be used: answer 304
+bool etagMatches(const char* ifNoneMatch, const char* etag);
+
+#endif // WEB_ASSETS_H
@@ -0,0 +1,37 @@
+/*
+   ESP32 RFID Jukebox - batch web commands
+
+   POST /api/batch takes up to WebCommandQueue::BATCH_MAX commands in one
+   request body, one per line (or separated by ';'):
+
+     volume 20
+     h
+     play 12
+
+   Each line is a command as typed on the console (commands.h): "play N"
+   plays track N, "queue N" adds it to the play queue, "volume N" sets the
+   volume (0-30), "h" or "shuffle" starts shuffle, and so on. The batch is
+   queued as a unit (pushBatch) and the player task runs it in one go. The
+   handler answers 202 at once with the tickets, {"first":7,"count":3};
+   each result arrives as an /events result event, and
+   GET /api/batch?first=7&count=3 returns them all once the batch has run:
+
+     {"results":[{"ticket":7,"result":"VOLUME: ..."},...]}
+*/
+
+#ifndef WEB_BATCH_H
+#define WEB_BATCH_H
+
+#include <Arduino.h>
+#include "web_command_queue.h"
+
+// Parse a batch body into commands. Returns the number of commands, or -1
+// with the 1-based number of the offending line in errorLine.
+int parseWebBatch(const char* body, size_t length, WebCommand* commands, uint8_t max,
+                  int& errorLine);
+
+// JSON results of count commands from firstTicket on, read from
+// webResponses; a result that was already overwritten is null
+String webBatchResults(uint32_t firstTicket, uint8_t count);
+
+#endif // WEB_BATCH_H
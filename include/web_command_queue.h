@@ -0,0 +1,74 @@
+/*
+   ESP32 RFID Jukebox - web command queue
+
+   AsyncWebServer handlers run on the async_tcp task, not the player task.
+   Instead of touching the DFPlayer, the player state or the SPIFFS from
+   there, a handler pushes a WebCommand into this queue and answers the
+   request straight away with the command's ticket number. The player task
+   pops the commands and executes them (handleWebCommands() in main.cpp), so
+   every player action still happens on a single task.
+
+   The queue is a bounded single-producer/single-consumer ring: async_tcp is
+   the only producer and the player task the only consumer, so the head and
+   tail indices are the only shared state and need no lock. When the ring is
+   full the command is rejected and counted as dropped.
+
+   A batch is pushed as a whole or not at all and published with a single
+   tail update, so the player task never sees part of one. Its commands get
+   consecutive tickets and run back to back in one handleWebCommands().
+*/
+
+#ifndef WEB_COMMAND_QUEUE_H
+#define WEB_COMMAND_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "commands.h"
+
+struct WebCommand {
+  uint32_t ticket;
+  uint8_t batchRemaining;  // commands still to come in the same batch
+  CommandCall call;        // parsed command (commands.h)
+};
+
+class WebCommandQueue {
+ public:
+  static const uint32_t CAPACITY = 16;             // must be a power of two
+
+  static const uint8_t BATCH_MAX = 8;
+
+  // Producer side (async_tcp). Returns the ticket, or 0 if the queue is full.
+  uint32_t push(const CommandCall& call);
+
+  // Producer side: queue count commands (only the call of each is
+  // used) with consecutive tickets. Returns the first ticket, or 0 if they
+  // don't all fit.
+  uint32_t pushBatch(const WebCommand* commands, uint8_t count);
+
+  // Consumer side (player task). Returns false when the queue is empty.
+  bool pop(WebCommand& command);
+
+  // Consumer side: mark a popped command as executed
+  void complete(uint32_t ticket);
+
+  // Statistics, safe to read from either task
+  uint32_t depth() const;
+  uint32_t maxDepth() const { return maxDepth_.load(std::memory_order_relaxed); }
+  uint32_t accepted() const { return nextTicket_.load(std::memory_order_relaxed) - 1; }
+  uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+  uint32_t lastCompleted() const { return lastCompleted_.load(std::memory_order_relaxed); }
+
+ private:
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+  WebCommand slots_[CAPACITY];
+  std::atomic<uint32_t> head_{0};          // next slot to pop, written by the consumer
+  std::atomic<uint32_t> tail_{0};          // next slot to fill, written by the producer
+
+  std::atomic<uint32_t> nextTicket_{1};
+  std::atomic<uint32_t> dropped_{0};
+  std::atomic<uint32_t> maxDepth_{0};
+  std::atomic<uint32_t> lastCompleted_{0};
+};
+
+#endif // WEB_COMMAND_QUEUE_H
@@ -0,0 +1,63 @@
+/*
+   ESP32 RFID Jukebox - web response slots
+
+   Results of web commands, kept per ticket so every client reads back its
+   own result instead of whatever the last command left in a shared String.
+   The player task stores the text a command returned in slot ticket % SLOTS;
+   /response?id=<ticket> on the async_tcp task copies it out. The slots are
+   fixed arrays, so memory stays at SLOTS x SLOT_SIZE however many clients
+   there are, and a result stays readable until SLOTS newer commands have
+   run. SLOTS covers a full command queue plus a batch, so one pass of
+   handleWebCommands() never overwrites a result it stored itself.
+
+   Web replies are one or a few lines; the longest, the help text, is
+   about 250 bytes. SLOT_SIZE is sized to that, so the ring takes 6 KB,
+   and the rare longer result is cut off and counted in truncated().
+
+   Each slot is guarded like a seqlock: the writer clears the slot's ticket,
+   writes the text and then publishes the ticket; a reader that sees the
+   ticket change while copying treats the result as gone.
+*/
+
+#ifndef WEB_RESPONSE_RING_H
+#define WEB_RESPONSE_RING_H
+
+#include <Arduino.h>
+#include <atomic>
+
+class WebResponseRing {
+ public:
+  static const uint32_t SLOTS = 24;            // >= queue CAPACITY + BATCH_MAX
+  static const uint16_t SLOT_SIZE = 256;           // longer results are cut off
+
+  // Player task: keep the result of a command
+  void store(uint32_t ticket, const char* text, size_t length);
+
+  // Any task: copy the result of ticket into out (NUL-terminated, at most
+  // SLOT_SIZE bytes). False if it hasn't run yet or was overwritten.
+  bool read(uint32_t ticket, char* out, size_t size) const;
+
+  // Ticket of the most recent result, 0 before the first
+  uint32_t latest() const { return latest_.load(std::memory_order_acquire); }
+
+  // Statistics
+  uint32_t stored() const { return stored_; }
+  uint32_t truncated() const { return truncated_; }
+  uint32_t expired() const { return expired_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Slot {
+    std::atomic<uint32_t> ticket{0};              // 0 while being written
+    uint16_t length = 0;
+    char text[SLOT_SIZE];
+  };
+
+  Slot slots_[SLOTS];
+  std::atomic<uint32_t> latest_{0};
+
+  uint32_t stored_ = 0;
+  uint32_t truncated_ = 0;
+  mutable std::atomic<uint32_t> expired_{0};       // reads of overwritten results
+};
+
+#endif // WEB_RESPONSE_RING_H
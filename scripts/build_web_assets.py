@@ -0,0 +1,170 @@
+"""
+ESP32 RFID Jukebox - web asset pipeline
+
+Builds the SPIFFS image contents from data/:
+
+- .html, .css, .js, .json and .svg files are minified (comments and
+  indentation dropped, inline <style> and <script> included) and stored
+  gzipped as <name>.gz; the uncompressed file is left out of the image
+- everything else (catalog.bin) is copied as it is
+- assets.idx lists each compressed asset with a strong ETag, a hash of
+  its gzipped bytes, which src/web_assets.cpp loads at boot
+
+The result goes to the PlatformIO data_dir (.pio/data, see [platformio]
+in platformio.ini), so `pio run --target uploadfs` flashes it while data/
+keeps the readable sources. Runs before every build after the song
+catalog generator, and can be run by hand:
+
+    python scripts/build_web_assets.py
+
+Outputs are only rewritten when their content changes, and gzip gets a
+fixed timestamp, so unchanged sources keep their ETag across builds.
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO/SCons
+    PROJECT_DIR = env["PROJECT_DIR"]  # noqa: F821
+    OUTPUT_DIR = env.subst("$PROJECT_DATA_DIR")  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    OUTPUT_DIR = os.path.join(PROJECT_DIR, ".pio", "data")
+
+SOURCE_DIR = os.path.join(PROJECT_DIR, "data")
+MANIFEST = "assets.idx"
+COMPRESSED = (".html", ".css", ".js", ".json", ".svg")
+
+# SPIFFS object names are limited to 31 characters
+MAX_NAME = 31
+
+
+def minify_css(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    text = re.sub(r"\s+", " ", text)
+    text = re.sub(r"\s*([{};,])\s*", r"\1", text)
+    return text.replace(";}", "}").strip()
+
+
+def strip_line_comment(line):
+    """Drop a trailing // comment unless it could be inside a string."""
+    match = re.search(r"(^|\s)//", line)
+    if not match:
+        return line
+    code = line[:match.start()]
+    if any(code.count(quote) % 2 for quote in "'\"`") or "/" in code.replace("//", ""):
+        return line
+    return code
+
+
+def minify_js(text):
+    # Line breaks stay: the scripts rely on automatic semicolon insertion
+    lines = []
+    in_comment = False
+    for line in text.splitlines():
+        line = line.strip()
+        if in_comment:
+            if "*/" in line:
+                in_comment = False
+                line = line.split("*/", 1)[1].strip()
+            else:
+                continue
+        if line.startswith("/*"):
+            if "*/" not in line:
+                in_comment = True
+                continue
+            line = line.split("*/", 1)[1].strip()
+        line = strip_line_comment(line).rstrip()
+        if line:
+            lines.append(line)
+    return "\n".join(lines)
+
+
+BLOCK = re.compile(r"(<(style|script)\b[^>]*>)(.*?)(</\2>)", re.S | re.I)
+
+
+def minify_html(text):
+    parts = []
+    position = 0
+    for match in BLOCK.finditer(text):
+        parts.append(minify_markup(text[position:match.start()]))
+        body = match.group(3)
+        if "src=" not in match.group(1):
+            body = minify_css(body) if match.group(2).lower() == "style" else minify_js(body)
+        parts.append(match.group(1) + body + match.group(4))
+        position = match.end()
+    parts.append(minify_markup(text[position:]))
+    return "".join(parts)
+
+
+def minify_markup(text):
+    if re.search(r"<(pre|textarea)\b", text, re.I):
+        sys.exit("build_web_assets: <pre> and <textarea> are not supported by the minifier")
+    text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+    # Whitespace between inline elements renders as a space: keep one
+    return re.sub(r"\s+", " ", text)
+
+
+MINIFIERS = {".html": minify_html, ".css": minify_css, ".js": minify_js}
+
+
+def compress(name, data):
+    minify = MINIFIERS.get(os.path.splitext(name)[1].lower())
+    if minify:
+        data = minify(data.decode("utf-8")).encode("utf-8")
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def write_if_changed(path, content):
+    try:
+        with open(path, "rb") as existing:
+            if existing.read() == content:
+                return False
+    except FileNotFoundError:
+        pass
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "wb") as output:
+        output.write(content)
+    return True
+
+
+def main():
+    manifest = []
+    expected = {MANIFEST}
+    for root, _, files in os.walk(SOURCE_DIR):
+        for file_name in sorted(files):
+            source = os.path.join(root, file_name)
+            name = os.path.relpath(source, SOURCE_DIR).replace(os.sep, "/")
+            with open(source, "rb") as input_file:
+                data = input_file.read()
+
+            if name.lower().endswith(COMPRESSED):
+                stored = name + ".gz"
+                content = compress(name, data)
+                etag = hashlib.sha256(content).hexdigest()[:16]
+                manifest.append("/%s /%s \"%s\"" % (name, stored, etag))
+                if write_if_changed(os.path.join(OUTPUT_DIR, stored), content):
+                    print("build_web_assets: %s %d -> %d bytes gzipped"
+                          % (name, len(data), len(content)))
+            else:
+                stored = name
+                write_if_changed(os.path.join(OUTPUT_DIR, stored), data)
+            if len(stored) + 1 > MAX_NAME:
+                sys.exit("build_web_assets: /%s is over %d characters" % (stored, MAX_NAME))
+            expected.add(stored)
+
+    write_if_changed(os.path.join(OUTPUT_DIR, MANIFEST), ("\n".join(manifest) + "\n").encode("ascii"))
+
+    # Files whose source was removed or renamed
+    for root, _, files in os.walk(OUTPUT_DIR):
+        for file_name in files:
+            path = os.path.join(root, file_name)
+            if os.path.relpath(path, OUTPUT_DIR).replace(os.sep, "/") not in expected:
+                os.remove(path)
+
+
+main()
@@ -0,0 +1,212 @@
+"""
+ESP32 RFID Jukebox - song catalog generator
+
+Reads the "Quick Song Lookup" table of SONG_REFERENCE.md and writes
+
+- include/song_catalog_data.h: a constexpr, length-prefixed title/artist
+  table that the firmware keeps in flash (see src/song_catalog.cpp)
+- data/catalog.bin: the same songs as a SPIFFS catalog file with a
+  fixed-width offset index (layout in include/song_catalog.h)
+
+Runs before every PlatformIO build (extra_scripts in platformio.ini) and
+can be run by hand:
+
+    python scripts/gen_song_catalog.py
+
+Collections too large for the reference card can be kept in a CSV file
+(number,title,artist per line, numbers 1..N). This only writes the SPIFFS
+catalog; the built-in table keeps coming from SONG_REFERENCE.md:
+
+    python scripts/gen_song_catalog.py --csv songs.csv
+
+Outputs are only rewritten when their content changes, so unchanged songs
+don't trigger a rebuild or a different filesystem image.
+"""
+
+import csv
+import os
+import re
+import struct
+import sys
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO/SCons
+    PROJECT_DIR = env["PROJECT_DIR"]  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+SOURCE = os.path.join(PROJECT_DIR, "SONG_REFERENCE.md")
+OUTPUT = os.path.join(PROJECT_DIR, "include", "song_catalog_data.h")
+CATALOG = os.path.join(PROJECT_DIR, "data", "catalog.bin")
+
+ROW = re.compile(r"^\|\s*(\d+)\s*\|\s*(.*?)\s*\|\s*(.*?)\s*\|\s*$")
+
+
+def read_songs(path):
+    """Rows of the first table after the "Quick Song Lookup" heading."""
+    songs = []
+    in_section = False
+    with open(path, encoding="utf-8") as source:
+        for line in source:
+            line = line.rstrip("\n")
+            if line.startswith("## "):
+                if in_section:
+                    break
+                in_section = line.strip() == "## Quick Song Lookup"
+                continue
+            match = ROW.match(line) if in_section else None
+            if match:
+                songs.append((int(match.group(1)), match.group(2), match.group(3)))
+    return songs
+
+
+def read_csv(path):
+    with open(path, encoding="utf-8", newline="") as source:
+        return [(int(row[0]), row[1].strip(), row[2].strip())
+                for row in csv.reader(source) if row and row[0].strip().isdigit()]
+
+
+def check(songs, source):
+    if not songs:
+        sys.exit("gen_song_catalog: no songs found in %s" % source)
+    if len(songs) > 0xFFFF:
+        sys.exit("gen_song_catalog: more than 65535 songs")
+    for expected, (number, title, artist) in enumerate(songs, start=1):
+        if number != expected:
+            sys.exit("gen_song_catalog: card #%d follows #%d, numbers must run 1..N"
+                     % (number, expected - 1))
+        for field in (title, artist):
+            if len(field.encode("utf-8")) > 255:
+                sys.exit("gen_song_catalog: card #%d has a field over 255 bytes" % number)
+
+
+def c_string(data):
+    """Bytes as C string literal pieces; non-ASCII goes out as \\x escapes."""
+    out = '"'
+    for i, byte in enumerate(data):
+        if byte >= 0x80 or byte < 0x20:
+            out += "\\x%02X" % byte
+            # A hex escape swallows following hex digits - close the piece
+            if i + 1 < len(data):
+                out += '" "'
+        elif chr(byte) in '"\\':
+            out += "\\" + chr(byte)
+        else:
+            out += chr(byte)
+    return out + '"'
+
+
+def field(text):
+    """Length byte, text, terminator - so entries work as C strings too."""
+    data = text.encode("utf-8")
+    return len(data) + 2, '"\\x%02X" %s "\\0"' % (len(data), c_string(data))
+
+
+def generate(songs):
+    lines = [
+        "/*",
+        "   ESP32 RFID Jukebox - song catalog data",
+        "",
+        "   GENERATED by scripts/gen_song_catalog.py from SONG_REFERENCE.md.",
+        "   Do not edit; change the song table and rebuild.",
+        "",
+        "   Each song is two fields, title then artist, and each field is a",
+        "   length byte, the UTF-8 text and a terminating NUL.",
+        "*/",
+        "",
+        "#ifndef SONG_CATALOG_DATA_H",
+        "#define SONG_CATALOG_DATA_H",
+        "",
+        "#include <stdint.h>",
+        "",
+        "#define SONG_CATALOG_COUNT %d" % len(songs),
+        "",
+        "static constexpr char SONG_CATALOG_DATA[] =",
+    ]
+    offsets = []
+    offset = 0
+    for number, title, artist in songs:
+        offsets.append(offset)
+        title_size, title_literal = field(title)
+        artist_size, artist_literal = field(artist)
+        lines.append("  /* %3d */ %s %s" % (number, title_literal, artist_literal))
+        offset += title_size + artist_size
+    lines[-1] += ";"
+    if offset > 0xFFFF:
+        sys.exit("gen_song_catalog: catalog is over 64 KiB")
+
+    lines.append("")
+    lines.append("// Offset of each song's title field, index = card number - 1")
+    lines.append("static constexpr uint16_t SONG_CATALOG_OFFSETS[SONG_CATALOG_COUNT] = {")
+    for i in range(0, len(offsets), 10):
+        lines.append("  " + ", ".join(str(o) for o in offsets[i:i + 10]) + ",")
+    lines.append("};")
+    lines.append("")
+    lines.append("#endif // SONG_CATALOG_DATA_H")
+    return "\n".join(lines) + "\n"
+
+
+def generate_catalog(songs):
+    """SPIFFS catalog: header, offset[count + 1], records."""
+    records = []
+    for _, title, artist in songs:
+        record = b""
+        for text in (title, artist):
+            data = text.encode("utf-8")
+            record += bytes([len(data)]) + data + b"\0"
+        records.append(record)
+
+    offset = 8 + (len(songs) + 1) * 4
+    offsets = []
+    for record in records:
+        offsets.append(offset)
+        offset += len(record)
+    offsets.append(offset)
+
+    header = b"JBS\x01" + struct.pack("<I", len(songs))
+    return header + struct.pack("<%dI" % len(offsets), *offsets) + b"".join(records)
+
+
+def write_if_changed(path, content, songs):
+    mode = "b" if isinstance(content, bytes) else ""
+    try:
+        with open(path, "r" + mode) as existing:
+            if existing.read() == content:
+                return
+    except FileNotFoundError:
+        pass
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    if mode:
+        with open(path, "wb") as output:
+            output.write(content)
+    else:
+        with open(path, "w", encoding="utf-8", newline="\n") as output:
+            output.write(content)
+    print("gen_song_catalog: %d songs -> %s" % (len(songs), os.path.relpath(path, PROJECT_DIR)))
+
+
+def catalog_count(path):
+    with open(path, "rb") as catalog:
+        header = catalog.read(8)
+    if len(header) < 8 or header[:4] != b"JBS\x01":
+        return 0
+    return struct.unpack("<I", header[4:])[0]
+
+
+def main(argv):
+    if len(argv) == 3 and argv[1] == "--csv":
+        songs = read_csv(argv[2])
+        check(songs, argv[2])
+        write_if_changed(CATALOG, generate_catalog(songs), songs)
+        return
+
+    songs = read_songs(SOURCE)
+    check(songs, SOURCE)
+    write_if_changed(OUTPUT, generate(songs), songs)
+    # Leave a catalog built from a CSV alone
+    if not os.path.exists(CATALOG) or catalog_count(CATALOG) <= len(songs):
+        write_if_changed(CATALOG, generate_catalog(songs), songs)
+
+
+# PlatformIO runs this file via SCons, where sys.argv belongs to the build
+main(sys.argv if __name__ == "__main__" else [])
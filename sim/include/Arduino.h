@@ -0,0 +1,277 @@
+/*
+   ESP32 RFID Jukebox - host simulation of the Arduino core
+
+   Just enough of the Arduino-ESP32 API for src/ to build on Linux in the
+   [env:native] environment. Time comes from the virtual clock in sim.h, so
+   delay() advances simulated time instantly and every run is reproducible.
+*/
+
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+
+#include "sim.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH            0x1
+#define LOW             0x0
+
+#define INPUT           0x01
+#define OUTPUT          0x03
+#define INPUT_PULLUP    0x05
+
+#define RISING          0x01
+#define FALLING         0x02
+#define CHANGE          0x03
+
+// Interrupt handlers run from sim::setPin() on the host
+#define IRAM_ATTR
+#define digitalPinToInterrupt(p) (p)
+
+#define DEC             10
+#define HEX             16
+#define OCT             8
+#define BIN             2
+
+#define SERIAL_8N1      0x800001c
+
+// Flash strings are plain pointers on the host
+#define F(string_literal) (string_literal)
+#define PROGMEM
+#define PSTR(s) (s)
+
+using std::min;
+using std::max;
+
+// Sketch entry points (src/main.cpp)
+void setup();
+void loop();
+
+// Timing
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// GPIO
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+uint16_t analogRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode);
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode);
+void detachInterrupt(uint8_t pin);
+
+// Random numbers (deterministic on the host)
+void randomSeed(unsigned long seed);
+long random(long howbig);
+long random(long howsmall, long howbig);
+
+//*****************************************************************************
+// String - thin wrapper over std::string with the Arduino WString interface
+//*****************************************************************************
+class String {
+ public:
+  String() {}
+  String(const char* cstr) : s_(cstr ? cstr : "") {}
+  String(const std::string& str) : s_(str) {}
+  explicit String(char c) : s_(1, c) {}
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(float value, unsigned char decimalPlaces = 2);
+  explicit String(double value, unsigned char decimalPlaces = 2);
+
+  unsigned int length() const { return s_.length(); }
+  bool isEmpty() const { return s_.empty(); }
+  const char* c_str() const { return s_.c_str(); }
+  bool reserve(unsigned int size) { s_.reserve(size); return true; }
+
+  String& operator+=(const String& rhs) { s_ += rhs.s_; return *this; }
+  String& operator+=(const char* rhs) { s_ += rhs ? rhs : ""; return *this; }
+  String& operator+=(char c) { s_ += c; return *this; }
+  String& operator+=(int num) { return *this += String(num); }
+  String& operator+=(unsigned int num) { return *this += String(num); }
+  String& operator+=(long num) { return *this += String(num); }
+  String& operator+=(unsigned long num) { return *this += String(num); }
+  bool concat(const String& rhs) { *this += rhs; return true; }
+  bool concat(const char* rhs) { *this += rhs; return true; }
+  bool concat(char c) { *this += c; return true; }
+  bool concat(const char* rhs, unsigned int len) { s_.append(rhs, len); return true; }
+
+  bool operator==(const String& rhs) const { return s_ == rhs.s_; }
+  bool operator==(const char* rhs) const { return s_ == (rhs ? rhs : ""); }
+  bool operator!=(const String& rhs) const { return s_ != rhs.s_; }
+  bool operator!=(const char* rhs) const { return !(*this == rhs); }
+  bool operator<(const String& rhs) const { return s_ < rhs.s_; }
+  bool equals(const String& rhs) const { return s_ == rhs.s_; }
+  bool equalsIgnoreCase(const String& rhs) const;
+  bool startsWith(const String& prefix) const { return s_.compare(0, prefix.s_.size(), prefix.s_) == 0; }
+  bool endsWith(const String& suffix) const;
+
+  char charAt(unsigned int index) const { return index < s_.size() ? s_[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+  char& operator[](unsigned int index) { return s_[index]; }
+  void setCharAt(unsigned int index, char c) { if (index < s_.size()) s_[index] = c; }
+  void getBytes(unsigned char* buf, unsigned int bufsize, unsigned int index = 0) const;
+  void toCharArray(char* buf, unsigned int bufsize, unsigned int index = 0) const {
+    getBytes((unsigned char*)buf, bufsize, index);
+  }
+
+  int indexOf(char ch, unsigned int fromIndex = 0) const;
+  int indexOf(const String& str, unsigned int fromIndex = 0) const;
+  int lastIndexOf(char ch) const;
+  String substring(unsigned int beginIndex) const;
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+  void replace(const String& find, const String& replace);
+  void remove(unsigned int index, unsigned int count = (unsigned int)-1);
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+
+  long toInt() const { return atol(s_.c_str()); }
+  float toFloat() const { return (float)atof(s_.c_str()); }
+
+  const std::string& str() const { return s_; }
+
+ private:
+  std::string s_;
+};
+
+String operator+(const String& lhs, const String& rhs);
+String operator+(const String& lhs, const char* rhs);
+String operator+(const char* lhs, const String& rhs);
+String operator+(const String& lhs, char rhs);
+String operator+(const String& lhs, int rhs);
+String operator+(const String& lhs, unsigned int rhs);
+String operator+(const String& lhs, long rhs);
+String operator+(const String& lhs, unsigned long rhs);
+
+//*****************************************************************************
+// Print / Stream
+//*****************************************************************************
+class Print;
+
+class Printable {
+ public:
+  virtual ~Printable() {}
+  virtual size_t printTo(Print& p) const = 0;
+};
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+  size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+
+  size_t print(const char* str) { return write(str); }
+  size_t print(const String& str) { return write(str.c_str(), str.length()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char value, int base = DEC) { return printNumber(value, base); }
+  size_t print(int value, int base = DEC);
+  size_t print(unsigned int value, int base = DEC) { return printNumber(value, base); }
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC) { return printNumber(value, base); }
+  size_t print(long long value, int base = DEC);
+  size_t print(unsigned long long value, int base = DEC) { return printNumber(value, base); }
+  size_t print(double value, int digits = 2);
+  size_t print(const Printable& p) { return p.printTo(*this); }
+
+  template <typename T>
+  size_t println(const T& value) { size_t n = print(value); return n + println(); }
+  template <typename T>
+  size_t println(const T& value, int format) { size_t n = print(value, format); return n + println(); }
+  size_t println(const char* str) { size_t n = print(str); return n + println(); }
+  size_t println() { return write("\r\n"); }
+
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+ private:
+  size_t printNumber(unsigned long long value, int base);
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual void flush() {}
+
+  void setTimeout(unsigned long timeout) { timeout_ = timeout; }
+  unsigned long getTimeout() const { return timeout_; }
+  size_t readBytes(uint8_t* buffer, size_t length);
+  String readString();
+  String readStringUntil(char terminator);
+
+  // Simulation hook for library models that poll in a busy loop on real
+  // hardware: skip ahead in virtual time until a byte arrives
+  bool waitForByteUntil(uint64_t deadlineNs) { return waitForByte(deadlineNs); }
+
+ protected:
+  // Blocks (in virtual time) until a byte arrives or the stream timeout ends
+  int timedRead();
+  virtual bool waitForByte(uint64_t deadlineNs) = 0;
+
+  unsigned long timeout_ = 1000;
+};
+
+//*****************************************************************************
+// HardwareSerial - UARTs backed by sim::Uart line models
+//*****************************************************************************
+class HardwareSerial : public Stream {
+ public:
+  explicit HardwareSerial(int uartNum) : uartNum_(uartNum) {}
+
+  void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1);
+  void end() {}
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  void flush() override;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  int availableForWrite();                         // free bytes in the TX FIFO
+
+  operator bool() const { return true; }
+
+ protected:
+  bool waitForByte(uint64_t deadlineNs) override;
+
+ private:
+  int uartNum_;
+};
+
+extern HardwareSerial Serial;
+
+//*****************************************************************************
+// ESP - chip services
+//*****************************************************************************
+class EspClass {
+ public:
+  void restart();
+  uint32_t getFreeHeap();
+  uint32_t getCycleCount();
+  uint32_t getCpuFreqMHz() { return 240; }
+};
+
+extern EspClass ESP;
+
+#endif // SIM_ARDUINO_H
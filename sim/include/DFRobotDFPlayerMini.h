@@ -0,0 +1,125 @@
+/*
+   ESP32 RFID Jukebox - host simulation of the DFRobotDFPlayerMini library
+
+   Follows the behaviour of DFRobotDFPlayerMini 1.0.6 byte for byte: frames
+   go out over the Stream, ACK mode makes every command wait for the
+   previous ACK, and queries block until the reply (or the timeout) arrives.
+   The module on the other end of the UART is modelled in sim_dfplayer.cpp.
+*/
+
+#ifndef SIM_DFROBOTDFPLAYERMINI_H
+#define SIM_DFROBOTDFPLAYERMINI_H
+
+#include <Arduino.h>
+
+#define DFPLAYER_EQ_NORMAL 0
+#define DFPLAYER_EQ_POP 1
+#define DFPLAYER_EQ_ROCK 2
+#define DFPLAYER_EQ_JAZZ 3
+#define DFPLAYER_EQ_CLASSIC 4
+#define DFPLAYER_EQ_BASS 5
+
+#define DFPLAYER_DEVICE_U_DISK 1
+#define DFPLAYER_DEVICE_SD 2
+#define DFPLAYER_DEVICE_AUX 3
+#define DFPLAYER_DEVICE_SLEEP 4
+#define DFPLAYER_DEVICE_FLASH 5
+
+#define DFPLAYER_RECEIVED_LENGTH 10
+#define DFPLAYER_SEND_LENGTH 10
+
+#define TimeOut 0
+#define WrongStack 1
+#define DFPlayerCardInserted 2
+#define DFPlayerCardRemoved 3
+#define DFPlayerCardOnline 4
+#define DFPlayerPlayFinished 5
+#define DFPlayerError 6
+#define DFPlayerUSBInserted 7
+#define DFPlayerUSBRemoved 8
+#define DFPlayerUSBOnline 9
+#define DFPlayerCardUSBOnline 10
+#define DFPlayerFeedBack 11
+
+#define Busy 1
+#define Sleeping 2
+#define SerialWrongStack 3
+#define CheckSumNotMatch 4
+#define FileIndexOut 5
+#define FileMismatch 6
+#define Advertise 7
+
+#define Stack_Header 0
+#define Stack_Version 1
+#define Stack_Length 2
+#define Stack_Command 3
+#define Stack_ACK 4
+#define Stack_Parameter 5
+#define Stack_CheckSum 7
+#define Stack_End 9
+
+class DFRobotDFPlayerMini {
+ public:
+  bool begin(Stream& stream, bool isACK = true, bool doReset = true);
+  bool waitAvailable(unsigned long duration = 0);
+  bool available();
+  uint8_t readType();
+  uint16_t read();
+
+  void setTimeOut(unsigned long timeOutDuration) { _timeOutDuration = timeOutDuration; }
+  void next() { sendStack(0x01); }
+  void previous() { sendStack(0x02); }
+  void play(int fileNumber = 1) { sendStack(0x03, fileNumber); }
+  void volumeUp() { sendStack(0x04); }
+  void volumeDown() { sendStack(0x05); }
+  void volume(uint8_t volume) { sendStack(0x06, volume); }
+  void EQ(uint8_t eq) { sendStack(0x07, eq); }
+  void loop(int fileNumber) { sendStack(0x08, fileNumber); }
+  void outputDevice(uint8_t device) { sendStack(0x09, device); delay(200); }
+  void sleep() { sendStack(0x0A); }
+  void reset() { sendStack(0x0C); }
+  void start() { sendStack(0x0D); }
+  void pause() { sendStack(0x0E); }
+  void playFolder(uint8_t folderNumber, uint8_t fileNumber) { sendStack(0x0F, folderNumber, fileNumber); }
+  void enableLoopAll() { sendStack(0x11, 0x01); }
+  void disableLoopAll() { sendStack(0x11, 0x00); }
+  void playMp3Folder(int fileNumber) { sendStack(0x12, fileNumber); }
+  void playLargeFolder(uint8_t folderNumber, uint16_t fileNumber) {
+    sendStack(0x14, (((uint16_t)folderNumber) << 12) | fileNumber);
+  }
+  void stop() { sendStack(0x16); }
+  void loopFolder(int folderNumber) { sendStack(0x17, folderNumber); }
+  void randomAll() { sendStack(0x18); }
+
+  int readState() { return query(0x42); }
+  int readVolume() { return query(0x43); }
+  int readEQ() { return query(0x44); }
+  int readFileCounts() { return query(0x48); }
+  int readCurrentFileNumber() { return query(0x4C); }
+
+  uint8_t _received[DFPLAYER_RECEIVED_LENGTH];
+  uint8_t _sending[DFPLAYER_SEND_LENGTH] = {0x7E, 0xFF, 06, 00, 01, 00, 00, 00, 00, 0xEF};
+
+ private:
+  Stream* _serial = nullptr;
+  unsigned long _timeOutTimer = 0;
+  unsigned long _timeOutDuration = 500;
+  uint8_t _receivedIndex = 0;
+  uint8_t _handleType = 0;
+  uint8_t _handleCommand = 0;
+  uint16_t _handleParameter = 0;
+  bool _isAvailable = false;
+  bool _isSending = false;
+
+  void sendStack();
+  void sendStack(uint8_t command, uint16_t argument = 0);
+  void sendStack(uint8_t command, uint8_t argumentHigh, uint8_t argumentLow);
+  int query(uint8_t command);
+  bool handleMessage(uint8_t type, uint16_t parameter = 0);
+  bool handleError(uint8_t type, uint16_t parameter = 0);
+  bool validateStack();
+  void parseStack();
+  void waitForBytes(unsigned long startMillis, unsigned long duration);
+};
+
+#endif // SIM_DFROBOTDFPLAYERMINI_H
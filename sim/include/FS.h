@@ -0,0 +1,87 @@
+/*
+   ESP32 RFID Jukebox - host simulation of the flash filesystem API
+
+   Files live in RAM for the lifetime of the process. Reads and writes are
+   counted so benchmarks can report flash traffic.
+*/
+
+#ifndef SIM_FS_H
+#define SIM_FS_H
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+namespace sim {
+struct FlashStats {
+  uint64_t opens = 0;
+  uint64_t bytesRead = 0;
+  uint64_t bytesWritten = 0;
+};
+FlashStats& flashStats();
+}  // namespace sim
+
+namespace fs {
+
+typedef std::shared_ptr<std::vector<uint8_t>> FileData;
+
+class File : public Stream {
+ public:
+  File() {}
+  File(const String& path, FileData data, bool writable)
+      : path_(path), data_(data), writable_(writable) {}
+
+  explicit operator bool() const { return (bool)data_; }
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t read(uint8_t* buf, size_t size);
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t size) override;
+  using Print::write;
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const { return pos_; }
+  size_t size() const { return data_ ? data_->size() : 0; }
+  void close() { data_.reset(); }
+  const char* path() const { return path_.c_str(); }
+  const char* name() const { return path_.c_str(); }
+
+ protected:
+  bool waitForByte(uint64_t deadlineNs) override { (void)deadlineNs; return available() > 0; }
+
+ private:
+  String path_;
+  FileData data_;
+  size_t pos_ = 0;
+  bool writable_ = false;
+};
+
+class FS {
+ public:
+  File open(const char* path, const char* mode = FILE_READ);
+  File open(const String& path, const char* mode = FILE_READ) { return open(path.c_str(), mode); }
+  bool exists(const char* path) { return files_.count(path) > 0; }
+  bool exists(const String& path) { return exists(path.c_str()); }
+  bool remove(const char* path) { return files_.erase(path) > 0; }
+  bool remove(const String& path) { return remove(path.c_str()); }
+  bool rename(const char* from, const char* to);
+  bool rename(const String& from, const String& to) { return rename(from.c_str(), to.c_str()); }
+
+ protected:
+  std::map<std::string, FileData> files_;
+};
+
+}  // namespace fs
+
+using fs::FS;
+using fs::File;
+
+#endif // SIM_FS_H
@@ -0,0 +1,10 @@
+/*
+   ESP32 RFID Jukebox - host simulation: HardwareSerial lives in Arduino.h
+*/
+
+#ifndef SIM_HARDWARESERIAL_H
+#define SIM_HARDWARESERIAL_H
+
+#include <Arduino.h>
+
+#endif // SIM_HARDWARESERIAL_H
@@ -0,0 +1,132 @@
+/*
+   ESP32 RFID Jukebox - host simulation of the MFRC522 library
+
+   Same class layout and signatures as miguelbalboa/MFRC522 for the calls the
+   sketch makes. Each call is served from the card placed in the simulated
+   field (sim::presentCard) and charges its bus time to the virtual clock.
+*/
+
+#ifndef SIM_MFRC522_H
+#define SIM_MFRC522_H
+
+#include <Arduino.h>
+
+class MFRC522 {
+ public:
+  enum PCD_Register : byte {
+    CommandReg = 0x01 << 1,
+    ComIEnReg = 0x02 << 1,
+    DivIEnReg = 0x03 << 1,
+    ComIrqReg = 0x04 << 1,
+    DivIrqReg = 0x05 << 1,
+    FIFODataReg = 0x09 << 1,
+    FIFOLevelReg = 0x0A << 1,
+    BitFramingReg = 0x0D << 1,
+    TxControlReg = 0x14 << 1,
+    RFCfgReg = 0x26 << 1,
+    VersionReg = 0x37 << 1
+  };
+
+  enum PCD_Command : byte {
+    PCD_Idle = 0x00,
+    PCD_CalcCRC = 0x03,
+    PCD_Transceive = 0x0C,
+    PCD_MFAuthent = 0x0E,
+    PCD_SoftReset = 0x0F
+  };
+
+  enum PCD_RxGain : byte {
+    RxGain_18dB = 0x00 << 4,
+    RxGain_23dB = 0x01 << 4,
+    RxGain_33dB = 0x04 << 4,
+    RxGain_38dB = 0x05 << 4,
+    RxGain_43dB = 0x06 << 4,
+    RxGain_48dB = 0x07 << 4,
+    RxGain_min = 0x00 << 4,
+    RxGain_avg = 0x04 << 4,
+    RxGain_max = 0x07 << 4
+  };
+
+  enum PICC_Command : byte {
+    PICC_CMD_REQA = 0x26,
+    PICC_CMD_WUPA = 0x52,
+    PICC_CMD_HLTA = 0x50,
+    PICC_CMD_MF_AUTH_KEY_A = 0x60,
+    PICC_CMD_MF_AUTH_KEY_B = 0x61,
+    PICC_CMD_MF_READ = 0x30,
+    PICC_CMD_MF_WRITE = 0xA0,
+    PICC_CMD_UL_WRITE = 0xA2
+  };
+
+  enum PICC_Type : byte {
+    PICC_TYPE_UNKNOWN,
+    PICC_TYPE_ISO_14443_4,
+    PICC_TYPE_ISO_18092,
+    PICC_TYPE_MIFARE_MINI,
+    PICC_TYPE_MIFARE_1K,
+    PICC_TYPE_MIFARE_4K,
+    PICC_TYPE_MIFARE_UL,
+    PICC_TYPE_MIFARE_PLUS,
+    PICC_TYPE_MIFARE_DESFIRE,
+    PICC_TYPE_TNP3XXX,
+    PICC_TYPE_NOT_COMPLETE = 0xff
+  };
+
+  enum StatusCode : byte {
+    STATUS_OK,
+    STATUS_ERROR,
+    STATUS_COLLISION,
+    STATUS_TIMEOUT,
+    STATUS_NO_ROOM,
+    STATUS_INTERNAL_ERROR,
+    STATUS_INVALID,
+    STATUS_CRC_WRONG,
+    STATUS_MIFARE_NACK = 0xff
+  };
+
+  typedef struct {
+    byte size;
+    byte uidByte[10];
+    byte sak;
+  } Uid;
+
+  typedef struct {
+    byte keyByte[6];
+  } MIFARE_Key;
+
+  Uid uid;
+
+  MFRC522(byte chipSelectPin, byte resetPowerDownPin);
+
+  void PCD_Init();
+  void PCD_SetAntennaGain(byte mask);
+  void PCD_WriteRegister(PCD_Register reg, byte value);
+  byte PCD_ReadRegister(PCD_Register reg);
+
+  bool PICC_IsNewCardPresent();
+  bool PICC_ReadCardSerial();
+  StatusCode PICC_HaltA();
+  void PCD_StopCrypto1();
+
+  StatusCode PCD_Authenticate(byte command, byte blockAddr, MIFARE_Key* key, Uid* uid);
+  StatusCode MIFARE_Read(byte blockAddr, byte* buffer, byte* bufferSize);
+  StatusCode MIFARE_Write(byte blockAddr, byte* buffer, byte bufferSize);
+  StatusCode MIFARE_Ultralight_Write(byte page, byte* buffer, byte bufferSize);
+
+  static PICC_Type PICC_GetType(byte sak);
+  static const char* PICC_GetTypeName(PICC_Type type);
+  static const char* GetStatusCodeName(StatusCode code);
+
+ private:
+  bool selected_ = false;
+  int authSector_ = -1;
+
+  // Interrupt registers and the last FIFO byte, for the IRQ line model
+  byte comIEn_ = 0x80;
+  byte comIrq_ = 0;
+  byte fifoByte_ = 0;
+  byte command_ = PCD_Idle;
+  void updateIrqLine();
+};
+
+#endif // SIM_MFRC522_H
@@ -0,0 +1,46 @@
+/*
+   ESP32 RFID Jukebox - host simulation of the NVS Preferences API
+
+   Keys live in RAM for the lifetime of the process, so they survive a
+   simulated restart. Writes are counted in NVS entries (32 bytes each) so
+   benchmarks can report flash wear.
+*/
+
+#ifndef SIM_PREFERENCES_H
+#define SIM_PREFERENCES_H
+
+#include <Arduino.h>
+#include <string>
+
+namespace sim {
+struct NvsStats {
+  uint64_t writes = 0;                  // put calls that changed a value
+  uint64_t unchanged = 0;               // put calls with the stored value
+  uint64_t entries = 0;                 // 32-byte entries programmed
+  uint64_t reads = 0;
+};
+NvsStats& nvsStats();
+void clearNvs();
+}  // namespace sim
+
+class Preferences {
+ public:
+  bool begin(const char* name, bool readOnly = false, const char* partitionLabel = nullptr);
+  void end() { open_ = false; }
+  bool clear();
+  bool remove(const char* key);
+  bool isKey(const char* key);
+
+  size_t putBytes(const char* key, const void* value, size_t length);
+  size_t getBytes(const char* key, void* buffer, size_t maxLength);
+  size_t getBytesLength(const char* key);
+
+ private:
+  std::string key(const char* name) const { return namespace_ + "/" + name; }
+
+  std::string namespace_;
+  bool open_ = false;
+  bool readOnly_ = false;
+};
+
+#endif // SIM_PREFERENCES_H
@@ -0,0 +1,18 @@
+/*
+   ESP32 RFID Jukebox - host simulation of the SPI bus
+*/
+
+#ifndef SIM_SPI_H
+#define SIM_SPI_H
+
+#include <Arduino.h>
+
+class SPIClass {
+ public:
+  void begin() {}
+  void end() {}
+};
+
+extern SPIClass SPI;
+
+#endif // SIM_SPI_H
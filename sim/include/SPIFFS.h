@@ -0,0 +1,22 @@
+/*
+   ESP32 RFID Jukebox - host simulation of SPIFFS
+*/
+
+#ifndef SIM_SPIFFS_H
+#define SIM_SPIFFS_H
+
+#include "FS.h"
+
+class SPIFFSFS : public fs::FS {
+ public:
+  bool begin(bool formatOnFail = false, const char* basePath = "/spiffs",
+             uint8_t maxOpenFiles = 10, const char* partitionLabel = nullptr);
+  bool format() { files_.clear(); return true; }
+  size_t totalBytes() { return 1378241; }
+  size_t usedBytes();
+  void end() {}
+};
+
+extern SPIFFSFS SPIFFS;
+
+#endif // SIM_SPIFFS_H
@@ -0,0 +1,53 @@
+/*
+   ESP32 RFID Jukebox - host simulation of the WiFi station
+
+   The native build has no network stack: WiFi never associates, so the
+   sketch takes its "continuing without web interface" path after the
+   connection timeout.
+*/
+
+#ifndef SIM_WIFI_H
+#define SIM_WIFI_H
+
+#include <Arduino.h>
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3
+} wifi_mode_t;
+
+class IPAddress : public Printable {
+ public:
+  IPAddress() : IPAddress(0, 0, 0, 0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets_{a, b, c, d} {}
+  String toString() const;
+  size_t printTo(Print& p) const override { return p.print(toString()); }
+
+ private:
+  uint8_t octets_[4];
+};
+
+class WiFiClass {
+ public:
+  bool config(IPAddress localIP, IPAddress gateway, IPAddress subnet,
+              IPAddress dns1 = IPAddress(), IPAddress dns2 = IPAddress());
+  bool mode(wifi_mode_t mode);
+  wl_status_t begin(const char* ssid, const char* passphrase = nullptr);
+  wl_status_t status();
+  IPAddress localIP();
+};
+
+extern WiFiClass WiFi;
+
+#endif // SIM_WIFI_H
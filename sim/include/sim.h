@@ -0,0 +1,193 @@
+/*
+   ESP32 RFID Jukebox - host simulation control
+
+   The hardware-abstraction layer behind the [env:native] build: a virtual
+   clock, GPIO levels, byte-level UART lines, a simulated RC522 field and a
+   simulated DFPlayer Mini. Benchmarks drive the sketch through this API and
+   read back timings that only depend on the modelled hardware, never on the
+   speed of the host.
+
+   Cost figures below are approximations of the real bus timings (4 MHz SPI
+   to the RC522, 9600 baud to the DFPlayer, 115200 baud console) and are
+   kept together so they can be tuned in one place.
+*/
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace sim {
+
+//*****************************************************************************
+// Virtual clock
+//*****************************************************************************
+uint64_t nowNs();
+void advanceNs(uint64_t ns);
+void advanceTo(uint64_t ns);
+
+// Total virtual time spent inside delay()/delayMicroseconds()
+uint64_t blockedNs();
+
+inline uint64_t msToNs(uint64_t ms) { return ms * 1000000ULL; }
+inline uint64_t usToNs(uint64_t us) { return us * 1000ULL; }
+
+// Cost model (nanoseconds)
+const uint64_t kGpioReadNs          = 100;       // digitalRead()
+const uint64_t kRfidPollNoCardNs    = 1100000;   // REQA + wait loop timing out
+const uint64_t kRfidPollCardNs      = 600000;    // REQA answered (ATQA)
+const uint64_t kRfidSelectNs        = 2500000;   // anticollision + SELECT
+const uint64_t kRfidCascadeNs       = 1200000;   // second cascade level (7-byte UID)
+const uint64_t kRfidAuthNs          = 4500000;   // Crypto1 three-pass auth
+const uint64_t kRfidReadNs          = 2000000;   // 16-byte block read
+const uint64_t kRfidWriteNs         = 9000000;   // two-phase write + EEPROM
+const uint64_t kRfidPageWriteNs     = 5500000;   // Ultralight WRITE: one 4-byte page + EEPROM
+const uint64_t kRfidHaltNs          = 1000000;   // HLTA (times out by design)
+const uint64_t kRfidRegisterNs      = 10000;     // single register access
+const uint64_t kDfplayerProcessNs   = 20000000;  // module decodes a frame
+const uint64_t kDfplayerAudioNs     = 60000000;  // frame -> first audio sample
+const uint64_t kFlashOpenNs         = 1000000;   // SPIFFS open: object lookup scan
+const uint64_t kFlashSeekNs         = 30000;     // SPIFFS seek: index page walk
+const uint64_t kFlashReadOpNs       = 20000;     // per read() call
+const uint64_t kFlashReadByteNs     = 100;       // cached flash read, ~10 MB/s
+const uint64_t kFlashWriteByteNs    = 3000;      // page program, ~0.7 ms per 256 B
+const uint64_t kNvsWriteOpNs        = 400000;    // NVS set + commit: hash lookup, erase old item
+const uint64_t kNvsEntryNs          = 100000;    // one 32-byte entry and its state bits
+
+//*****************************************************************************
+// UART line model
+//
+// Bytes written by the sketch leave the TX FIFO at the line rate; a write
+// blocks (in virtual time) while the FIFO is full. Received bytes carry the
+// virtual time at which their stop bit arrives and only become available()
+// once the clock reaches it.
+//*****************************************************************************
+class UartDevice {
+ public:
+  virtual ~UartDevice() {}
+  // Called when a byte written by the sketch has fully arrived at the device
+  virtual void onByte(uint8_t c, uint64_t arrivalNs) = 0;
+  // Bring the device model up to the current virtual time
+  virtual void poll(uint64_t nowNs) = 0;
+};
+
+struct Uart {
+  uint32_t baud = 115200;
+  size_t txFifoSize = 128;
+  uint64_t txLineFreeNs = 0;           // when the last queued TX byte is on the wire
+  uint64_t rxLineFreeNs = 0;           // when the last queued RX byte arrives
+  std::deque<std::pair<uint64_t, uint8_t>> rx;
+  UartDevice* device = nullptr;
+  uint64_t txBytes = 0;
+  uint64_t rxBytes = 0;
+  uint64_t txBlockedNs = 0;            // time the sketch spent waiting on a full FIFO
+  bool echo = false;                   // copy TX bytes to stdout (console only)
+  std::string captured;                // recent TX text (console only)
+
+  uint64_t byteNs() const { return 10ULL * 1000000000ULL / baud; }
+  // Queue bytes towards the sketch, sent back-to-back once the line is free
+  void inject(const uint8_t* data, size_t len, uint64_t startNs);
+  void inject(const std::string& text, uint64_t startNs);
+};
+
+Uart& uart(int num);
+
+//*****************************************************************************
+// GPIO
+//*****************************************************************************
+// Set an input level; an edge runs the pin's attachInterrupt() handler
+void setPin(uint8_t pin, int level);
+int pinLevel(uint8_t pin);
+
+//*****************************************************************************
+// RC522 field
+//*****************************************************************************
+struct Card {
+  std::vector<uint8_t> uid;
+  uint8_t sak = 0x08;                  // MIFARE Classic 1K; 0x00 Ultralight/NTAG
+  uint8_t blocks[64][16] = {};         // Ultralight: page p at blocks[p / 4][(p % 4) * 4]
+  bool halted = false;
+};
+
+// Build a MIFARE Classic card holding `number` in block 1 the way
+// autoModus() writes it (ASCII digits, space padded)
+Card makeClassicCard(uint32_t uidValue, long number);
+
+// Build an NTAG213 card (7-byte UID) holding the binary record for
+// `number` in pages 4-5 the way autoModus() writes it
+Card makeNtagCard(uint32_t uidValue, long number);
+
+void presentCard(Card* card);
+void removeCard();
+Card* cardInField();
+
+// Wire the RC522 IRQ output to a GPIO (255 = not connected, the default).
+// The line follows ComIrqReg & ComIEnReg, active low with IRqInv set.
+void wireRfidIrq(uint8_t pin);
+uint8_t rfidIrqPin();
+
+struct RfidStats {
+  uint64_t spiTransactions = 0;
+  uint64_t polls = 0;
+  uint64_t authentications = 0;
+  uint64_t reads = 0;
+  uint64_t writes = 0;
+};
+RfidStats& rfidStats();
+
+// Probability (0..1) that an authentication or read fails
+void setRfidFailureRate(double authFail, double readFail);
+
+// Probability (0..1) that a write is acknowledged but the card keeps
+// corrupted data (weak card, card pulled away mid-write)
+void setRfidWriteFaultRate(double torn);
+
+//*****************************************************************************
+// DFPlayer Mini
+//*****************************************************************************
+struct DfplayerFrame {
+  uint64_t atNs;
+  uint8_t command;
+  uint16_t parameter;
+};
+
+struct DfplayerModel {
+  uint8_t state = 0;                   // 0 stopped, 1 playing, 2 paused
+  uint16_t track = 0;
+  uint8_t volume = 0;
+  uint16_t trackCount = 41;
+  uint64_t trackEndNs = 0;             // when the current track runs out
+  uint64_t remainingNs = 0;            // remaining time while paused
+  uint64_t audioStartNs = 0;           // first audio of the current track
+  uint64_t defaultTrackNs = 180000000000ULL;
+  std::vector<uint64_t> trackNs;       // per-track overrides (index = track)
+  bool doubleFinish = true;            // real modules report 0x3D twice
+  std::vector<DfplayerFrame> received; // every frame the module accepted
+};
+
+DfplayerModel& dfplayer();
+uint64_t trackDurationNs(uint16_t track);
+
+//*****************************************************************************
+// Console and chip
+//*****************************************************************************
+// Bytes typed into the serial monitor
+void typeSerial(const std::string& text);
+uint32_t restartCount();
+
+// Heap allocations made by the process so far (String, new, containers)
+uint64_t heapAllocations();
+size_t heapInUse();                     // bytes currently allocated
+size_t heapPeak();                      // most bytes allocated since resetHeapPeak()
+void resetHeapPeak();
+
+// Put everything back to power-on state (clock keeps running)
+void resetHardware();
+
+}  // namespace sim
+
+#endif // SIM_H
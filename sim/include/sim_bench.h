@@ -0,0 +1,64 @@
+/*
+   ESP32 RFID Jukebox - native benchmark harness
+
+   Benchmarks register themselves with SIM_BENCHMARK(name) and are run by
+   bench_main.cpp, either all in registration order or by name:
+
+     .pio/build/native/program               run everything
+     .pio/build/native/program idle rfid     run selected benchmarks
+
+   All latencies are virtual time, so results are identical between runs and
+   between hosts; a change in the numbers means a change in the sketch.
+*/
+
+#ifndef SIM_BENCH_H
+#define SIM_BENCH_H
+
+#include <Arduino.h>
+#include <vector>
+
+namespace sim {
+
+typedef void (*BenchmarkFn)();
+
+struct BenchmarkRegistrar {
+  BenchmarkRegistrar(const char* name, BenchmarkFn fn);
+};
+
+#define SIM_BENCHMARK(name)                                              \
+  static void bench_##name();                                            \
+  static sim::BenchmarkRegistrar bench_registrar_##name(#name, bench_##name); \
+  static void bench_##name()
+
+// Latency samples in nanoseconds with percentile reporting
+class LatencyStats {
+ public:
+  void add(uint64_t ns) { samples_.push_back(ns); sorted_ = false; }
+  void clear() { samples_.clear(); }
+  size_t count() const { return samples_.size(); }
+  uint64_t percentile(double p);
+  uint64_t max();
+  double meanNs() const;
+
+ private:
+  std::vector<uint64_t> samples_;
+  bool sorted_ = true;
+};
+
+// Output helpers - one table per benchmark
+void printHeader(const char* title);
+void printTableHeader();
+void printRow(const char* label, LatencyStats& stats);
+void printValue(const char* label, double value, const char* unit);
+
+// Sketch lifecycle
+const uint64_t kRunForStepNs = 100000;   // runFor() pads short iterations to this
+void bootSketch();                       // setup() + loop() until WiFi gives up
+uint64_t timeCall(void (*fn)());         // virtual ns spent in fn
+void runFor(uint64_t ns);                // keep calling loop() for ns
+void loopStep(uint64_t minNs);           // one loop(), taking at least minNs
+void jukeboxLoopOnce();                  // loop() body for jukebox mode
+
+}  // namespace sim
+
+#endif // SIM_BENCH_H
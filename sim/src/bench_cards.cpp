@@ -0,0 +1,404 @@
+/*
+   ESP32 RFID Jukebox - card reader benchmarks
+
+   cardcache:  taps every card of a 41-card set several times, first with
+               an empty cache (full MIFARE read, then a cache fill) and then
+               from the cache, and checks that the cache file restores the
+               same cards after a reboot.
+   rfiddetect: card detection by polling against the RC522 IRQ line, run
+               on the RFID task's 10 ms period: SPI traffic and reader time
+               with no card, and tap -> play command latency.
+   programmer: manual programming mode while the number for a card is
+               being typed. manualModus() used to wait for it in a loop,
+               so one pass lasted the whole typing time (up to 30 s).
+   cardbatch:  a stack of blank MIFARE Classic and NTAG cards numbered by
+               auto mode and by a batch job, with weak cards that take a
+               write without keeping it: wrong cards, retries, flagged
+               cards and throughput.
+*/
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include "jukebox.h"
+#include "sim_bench.h"
+#include "card_record.h"
+#include <random>
+
+using namespace sim;
+
+// One tap: present the card and time the loop iteration that handles it
+static uint64_t tapOnce(Card* card) {
+  presentCard(card);
+  uint64_t deadline = nowNs() + msToNs(2000);
+  uint64_t handled = 0;
+  uint32_t changes = playerScheduler.trackChanges();
+  while (playerScheduler.trackChanges() == changes && nowNs() < deadline) {
+    uint64_t t = nowNs();
+    jukeboxLoopOnce();
+    handled = nowNs() - t;
+  }
+  removeCard();
+  runFor(msToNs(400));
+  return handled;
+}
+
+SIM_BENCHMARK(cardcache) {
+  bootSketch();
+  printHeader("cardcache: 41 cards, 1 cold + 10 warm passes");
+
+  std::vector<Card> cards;
+  for (int n = 1; n <= 41; n++) cards.push_back(makeClassicCard(0xC0000000u + n, n));
+
+  cardCache.clear();
+  uint32_t hits = cardCache.hits();
+  uint32_t misses = cardCache.misses();
+  size_t authBefore = rfidStats().authentications;
+
+  LatencyStats cold;
+  LatencyStats warm;
+  for (Card& card : cards) cold.add(tapOnce(&card));
+  for (int pass = 0; pass < 10; pass++) {
+    for (Card& card : cards) warm.add(tapOnce(&card));
+  }
+  size_t auths = rfidStats().authentications - authBefore;
+
+  // Reload from the file, as after a restart
+  size_t fileSize = SPIFFS.open("/cards.bin", FILE_READ).size();
+  CardCache reloaded;
+  reloaded.begin(SPIFFS);
+
+  printTableHeader();
+  printRow("tap iteration, cache miss", cold);
+  printRow("tap iteration, cache hit", warm);
+  printValue("hit rate", (cardCache.hits() - hits) * 100.0 /
+             (cardCache.hits() - hits + cardCache.misses() - misses), "%");
+  printValue("MIFARE authentications", (double)auths, "");
+  printValue("cache file size", (double)fileSize, "bytes");
+  printValue("cards restored from file", (double)reloaded.size(), "");
+}
+
+// The RFID task: a pass every period, or straight away when the IRQ line
+// is low (the ISR woke it); the player task dispatches what it queued
+struct DetectRun {
+  uint64_t readerNs = 0;               // time inside handleRFID()
+  uint64_t spi = 0;
+  uint64_t elapsedNs = 0;
+};
+
+// A card placed on the reader while the task sleeps
+static Card* g_arriving = nullptr;
+static uint64_t g_arrivalNs = 0;
+
+static void cardArrives() {
+  if (g_arriving && nowNs() >= g_arrivalNs) {
+    presentCard(g_arriving);
+    g_arriving = nullptr;
+  }
+}
+
+static void rfidTaskFor(uint64_t ns, DetectRun& run) {
+  const uint64_t period = msToNs(taskConfig(TASK_RFID).periodMs);
+  uint64_t end = nowNs() + ns;
+  uint64_t spiBefore = rfidStats().spiTransactions;
+  uint64_t start = nowNs();
+  while (nowNs() < end) {
+    uint64_t next = nowNs() + period;
+    uint64_t t = nowNs();
+    handleRFID();
+    run.readerNs += nowNs() - t;
+    handleInputEvents();
+    playerScheduler.update();
+    if (rfidIrqPin() != 255 && pinLevel(rfidIrqPin()) == LOW) continue;
+    while (nowNs() < next) {
+      advanceTo(std::min(next, nowNs() + usToNs(100)));
+      cardArrives();
+      playerScheduler.update();
+      if (rfidIrqPin() != 255 && pinLevel(rfidIrqPin()) == LOW) break;
+    }
+  }
+  run.spi += rfidStats().spiTransactions - spiBefore;
+  run.elapsedNs += nowNs() - start;
+}
+
+static void detectTaps(std::vector<Card>& cards, LatencyStats& latency, DetectRun& run) {
+  std::mt19937 rng(16);
+  std::uniform_int_distribution<int> phase(0, 9999);
+  for (size_t i = 0; i < cards.size(); i++) {
+    uint32_t changes = playerScheduler.trackChanges();
+    uint64_t tap = nowNs() + usToNs(phase(rng));
+    g_arriving = &cards[i];
+    g_arrivalNs = tap;
+    while (playerScheduler.trackChanges() == changes && nowNs() < tap + msToNs(2000)) {
+      rfidTaskFor(usToNs(500), run);
+    }
+    latency.add(nowNs() - tap);
+    removeCard();
+    rfidTaskFor(msToNs(500), run);
+  }
+}
+
+struct DetectReport {
+  float spiPerSecond;
+  float cpuPercent;
+};
+
+static void printDetect(const char* mode, const DetectRun& idle, const DetectReport& reported) {
+  char label[48];
+  double seconds = idle.elapsedNs / 1e9;
+  snprintf(label, sizeof(label), "%s: SPI transactions, idle", mode);
+  printValue(label, idle.spi / seconds, "/s");
+  snprintf(label, sizeof(label), "%s: reader busy, idle", mode);
+  printValue(label, 100.0 * idle.readerNs / idle.elapsedNs, "%");
+  snprintf(label, sizeof(label), "%s: reported by 's'", mode);
+  char value[64];
+  snprintf(value, sizeof(value), "%.0f SPI/s, %.1f%% CPU", reported.spiPerSecond, reported.cpuPercent);
+  printf("  %-32s %s\n", label, value);
+}
+
+SIM_BENCHMARK(rfiddetect) {
+  bootSketch();
+  printHeader("rfiddetect: polling vs IRQ detection on a 10 s idle reader and 41 taps");
+  cardCache.clear();
+  std::vector<Card> cards;
+  for (int n = 1; n <= 41; n++) cards.push_back(makeClassicCard(0xD0000000u + n, n));
+
+  // IRQ not wired: begin() must fall back to polling
+  rfidDetector.begin(mfrc522, RFID_IRQ_PIN, RFID_DETECT_IRQ);
+  bool fellBack = rfidDetector.mode() == RFID_DETECT_POLL;
+
+  DetectRun pollIdle;
+  rfidTaskFor(msToNs(10000), pollIdle);
+  DetectReport pollReport = {rfidDetector.spiPerSecond(), rfidDetector.cpuPercent()};
+  LatencyStats pollTap;
+  DetectRun pollTaps;
+  detectTaps(cards, pollTap, pollTaps);
+
+  wireRfidIrq(RFID_IRQ_PIN);
+  rfidDetector.begin(mfrc522, RFID_IRQ_PIN, RFID_DETECT_IRQ);
+  bool irqMode = rfidDetector.mode() == RFID_DETECT_IRQ;
+  cardCache.clear();
+  DetectRun irqIdle;
+  rfidTaskFor(msToNs(10000), irqIdle);
+  DetectReport irqReport = {rfidDetector.spiPerSecond(), rfidDetector.cpuPercent()};
+  LatencyStats irqTap;
+  DetectRun irqTaps;
+  detectTaps(cards, irqTap, irqTaps);
+  uint32_t interrupts = rfidDetector.interrupts();
+
+  // Back to the unwired reader the other benchmarks expect
+  wireRfidIrq(255);
+  rfidDetector.begin(mfrc522, RFID_IRQ_PIN, RFID_DETECT_POLL);
+  cardCache.clear();
+
+  printTableHeader();
+  printRow("tap -> play command, polling", pollTap);
+  printRow("tap -> play command, IRQ", irqTap);
+  printDetect("polling", pollIdle, pollReport);
+  printDetect("IRQ", irqIdle, irqReport);
+  printValue("interrupts for 41 taps", (double)interrupts, "");
+  printf("  IRQ not wired -> polling: %s, wired -> IRQ: %s\n", fellBack ? "yes" : "NO", irqMode ? "yes" : "NO");
+}
+
+// Loop passes until the programming mode step is `state`, or 2 s
+static bool runUntilProgrammer(ProgrammerState state) {
+  uint64_t deadline = nowNs() + msToNs(2000);
+  while (programmerState != state && nowNs() < deadline) jukeboxLoopOnce();
+  return programmerState == state;
+}
+
+SIM_BENCHMARK(programmer) {
+  bootSketch();
+  printHeader("programmer: 20 cards numbered in manual mode, 3 s to type each number");
+  typeSerial("p\n");
+  runFor(msToNs(100));
+  typeSerial("manual\n");
+  runFor(msToNs(100));
+
+  std::vector<Card> cards;
+  for (int n = 1; n <= 20; n++) cards.push_back(makeClassicCard(0xC0000000u + n, 0));
+
+  LatencyStats pass;
+  LatencyStats webWait;
+  LatencyStats typedToWritten;
+  int written = 0;
+  for (int n = 1; n <= 20; n++) {
+    presentCard(&cards[n - 1]);
+    if (!runUntilProgrammer(PROGRAM_MANUAL_NUMBER)) continue;
+
+    // Thinking about the number: a web command every 100 ms meanwhile
+    uint64_t typing = nowNs() + msToNs(3000);
+    while (nowNs() < typing) {
+      uint32_t ticket = webCommands.push({CMD_VOLUME, 0});
+      uint64_t sent = nowNs();
+      while (webCommands.lastCompleted() < ticket && nowNs() < typing) {
+        uint64_t t = nowNs();
+        jukeboxLoopOnce();
+        pass.add(nowNs() - t);
+      }
+      webWait.add(nowNs() - sent);
+      runFor(msToNs(100));
+    }
+
+    typeSerial(std::to_string(n) + "\n");
+    uint64_t typed = nowNs();
+    if (runUntilProgrammer(PROGRAM_MANUAL)) typedToWritten.add(nowNs() - typed);
+    if (atoi((const char*)cards[n - 1].blocks[1]) == n) written++;
+    removeCard();
+    runFor(msToNs(200));
+  }
+
+  // A card nobody types a number for is released after the timeout
+  Card idle = makeClassicCard(0xC0000100u, 0);
+  presentCard(&idle);
+  runUntilProgrammer(PROGRAM_MANUAL_NUMBER);
+  runFor(msToNs(31000));
+  bool released = programmerState == PROGRAM_MANUAL && idle.halted;
+  removeCard();
+
+  typeSerial("jukebox\n");
+  runFor(msToNs(100));
+  cardCache.clear();
+
+  printTableHeader();
+  printRow("player pass, waiting for number", pass);
+  printRow("web command -> run, waiting", webWait);
+  printRow("number typed -> card written", typedToWritten);
+  printValue("cards written correctly", written, "of 20");
+  printf("  card without a number released after 30 s: %s\n", released ? "yes" : "NO");
+  printf("  back in jukebox mode: %s\n", jukeboxMode ? "yes" : "NO");
+}
+
+// Number a card holds, 0 if it holds none
+static int numberOnCard(Card& card) {
+  if (card.sak != 0x00) return atoi((const char*)card.blocks[1]);
+  CardRecord record;
+  byte data[CARD_RECORD_SIZE];
+  memcpy(data, &card.blocks[1][0], CARD_RECORD_SIZE);     // pages 4-5
+  return decodeCardRecord(data, record) ? cardNumber(record) : 0;
+}
+
+struct ByteCount : public Print {
+  size_t bytes = 0;
+  size_t write(uint8_t) override { bytes++; return 1; }
+  using Print::write;
+};
+
+struct ProgramRun {
+  LatencyStats perCard;            // card placed -> halted
+  int cardsUsed = 0;
+  int wrong = 0;                   // halted as done, but holding the wrong number
+  uint64_t firstNs = 0;
+  uint64_t lastNs = 0;
+  int done = 0;
+};
+
+// Place blank cards one at a time until `done` says the job is over; the
+// operator takes 1 s to swap cards. `expected` is the number the next card
+// should get, `flagged` the count of cards set aside as bad.
+template <typename Done, typename Expected, typename Flagged>
+static void programStack(std::vector<Card>& cards, ProgramRun& run, Done done, Expected expected,
+                         Flagged flagged) {
+  for (Card& card : cards) {
+    if (done()) break;
+    int number = expected();
+    int flaggedBefore = flagged();
+    presentCard(&card);
+    uint64_t placed = nowNs();
+    while (!card.halted && nowNs() - placed < msToNs(3000)) jukeboxLoopOnce();
+    run.perCard.add(nowNs() - placed);
+    run.cardsUsed++;
+    if (card.halted && flagged() == flaggedBefore) {
+      if (numberOnCard(card) != number) run.wrong++;
+      if (run.done == 0) run.firstNs = nowNs();
+      run.lastNs = nowNs();
+      run.done++;
+    }
+    removeCard();
+    runFor(msToNs(1000));
+  }
+}
+
+static double cardsPerMinute(const ProgramRun& run) {
+  if (run.done < 2) return 0;
+  return (run.done - 1) * 60e9 / (run.lastNs - run.firstNs);
+}
+
+SIM_BENCHMARK(cardbatch) {
+  bootSketch();
+  printHeader("cardbatch: 41 cards, 5% bad writes, 2% failed authentications");
+  std::vector<Card> autoCards, batchCards;
+  for (int n = 0; n < 60; n++) {
+    autoCards.push_back(n % 2 ? makeNtagCard(0xB0000000u + n, 0) : makeClassicCard(0xB0000000u + n, 0));
+    batchCards.push_back(n % 2 ? makeNtagCard(0xB1000000u + n, 0) : makeClassicCard(0xB1000000u + n, 0));
+  }
+  RfidStats before = rfidStats();
+  setRfidFailureRate(0.02, 0.0);
+  setRfidWriteFaultRate(0.05);
+
+  // Auto mode: write, no read-back
+  typeSerial("p\n");
+  runFor(msToNs(100));
+  typeSerial("auto\n");
+  runFor(msToNs(100));
+  typeSerial("1\n");
+  runFor(msToNs(100));
+  ProgramRun autoRun;
+  programStack(autoCards, autoRun, [&] { return autoRun.done == 41; },
+               [&] { return autoRun.done + 1; }, [] { return 0; });
+  RfidStats afterAuto = rfidStats();
+
+  // Batch job: write, read back, retry
+  typeSerial("batch 1-41\n");
+  runFor(msToNs(100));
+  ProgramRun batchRun;
+  programStack(batchCards, batchRun, [] { return !cardBatch.running(); },
+               [] { return cardBatch.nextNumber(); }, [] { return (int)cardBatch.failed(); });
+  RfidStats afterBatch = rfidStats();
+
+  setRfidFailureRate(0.0, 0.0);
+  setRfidWriteFaultRate(0.0);
+  ByteCount json;
+  cardBatch.writeJson(json);
+
+  printTableHeader();
+  printRow("auto: card placed -> done", autoRun.perCard);
+  printRow("batch: card placed -> done", batchRun.perCard);
+  printValue("auto: cards with a wrong number", autoRun.wrong, "of 41");
+  printValue("batch: cards with a wrong number", batchRun.wrong, "of 41");
+  printValue("batch: cards written", cardBatch.written(), "");
+  printValue("batch: retries", cardBatch.retries(), "");
+  printValue("batch: bad cards flagged", cardBatch.failed(), "");
+  printValue("auto: cards/min, 1 s swaps", cardsPerMinute(autoRun), "");
+  printValue("batch: cards/min, 1 s swaps", cardBatch.cardsPerMinute(), "");
+  printValue("auto: reads per card", (double)(afterAuto.reads - before.reads) / autoRun.cardsUsed, "");
+  printValue("batch: reads per card", (double)(afterBatch.reads - afterAuto.reads) / batchRun.cardsUsed, "");
+  printValue("batch: authentications per card",
+             (double)(afterBatch.authentications - afterAuto.authentications) / batchRun.cardsUsed, "");
+  printValue("/api/program JSON", json.bytes, "bytes");
+
+  // Two cards, then the first one put back: it keeps its number
+  std::vector<Card> putBack = {makeClassicCard(0xB2000000u, 0), makeNtagCard(0xB2000001u, 0)};
+  typeSerial("batch 50-52\n");
+  runFor(msToNs(100));
+  for (Card* card : {&putBack[0], &putBack[1], &putBack[0]}) {
+    presentCard(card);
+    runFor(msToNs(1500));
+    removeCard();
+    runFor(msToNs(1000));
+  }
+  bool skipped = numberOnCard(putBack[0]) == 50 && cardBatch.nextNumber() == 52;
+  CardBatchSpec crossing;
+  bool rejected = !CardBatch::parse("-3-3", 4, crossing);
+
+  // A job list longer than the old 32-character console line
+  typeSerial("batch 1-12,15,20-25,30,33,40-41,50\n");
+  runFor(msToNs(100));
+  bool longList = cardBatch.running() && cardBatch.total() == 24;
+  typeSerial("jukebox\n");
+  runFor(msToNs(100));
+  cardCache.clear();
+
+  printf("  written card put back skipped: %s, \"-3-3\" rejected: %s\n",
+         skipped ? "yes" : "NO", rejected ? "yes" : "NO");
+  printf("  7-range job list from the console: %s\n", longList ? "yes" : "NO");
+}
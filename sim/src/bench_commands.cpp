@@ -0,0 +1,139 @@
+/*
+   ESP32 RFID Jukebox - command dispatch benchmark
+
+   commands: host CPU cost of parsing a line and of going through the
+   command table instead of a hand-written switch case, and what a line
+   typed one key at a time costs the console handler: the CommandLine
+   reader against the old Serial.readStringUntil('\n'), which sits in the
+   handler until the line end (or the stream timeout) arrives. Also the
+   size of the status reply, which on the web has to fit one response slot,
+   and whether a line over MAX_LENGTH gets an error.
+*/
+
+#include <Arduino.h>
+#include <chrono>
+#include "jukebox.h"
+#include "sim_bench.h"
+
+using namespace sim;
+
+namespace {
+
+struct NullPrint : public Print {
+  size_t bytes = 0;
+  size_t write(uint8_t) override { bytes++; return 1; }
+  using Print::write;
+};
+
+const int kHostRounds = 1000000;
+const uint64_t kKeyGapNs = 150000000ULL;   // someone typing, 150 ms per key
+
+// Host ns per call of fn
+template <typename Fn>
+double hostNsPerCall(Fn fn) {
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < kHostRounds; i++) fn(i);
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / kHostRounds;
+}
+
+// Key presses of text, kKeyGapNs apart from now on
+void typeSlowly(const char* text) {
+  for (size_t i = 0; text[i]; i++) uart(0).inject((const uint8_t*)&text[i], 1, nowNs() + i * kKeyGapNs);
+}
+
+// The old console read
+void readLineBlocking() {
+  if (Serial.available()) Serial.readStringUntil('\n');
+}
+
+}  // namespace
+
+SIM_BENCHMARK(commands) {
+  bootSketch();
+  printHeader("commands: parse and dispatch cost, a line typed key by key");
+
+  // Host CPU cost, for scale
+  static volatile int32_t sink;
+  CommandCall call;
+  double parseShort = hostNsPerCall([&](int) {
+    parseCommand("s", 1, call);
+    sink = call.id;
+  });
+  double parseNumber = hostNsPerCall([&](int) {
+    parseCommand("volume 20", 9, call);
+    sink = call.argument;
+  });
+  double parseUnknown = hostNsPerCall([&](int) { sink = parseCommand("xyzzy", 5, call); });
+
+  NullPrint out;
+  double direct = hostNsPerCall([&](int) {
+    out.print("VOLUME: Current volume: ");
+    out.println(currentVolume);
+  });
+  double table = hostNsPerCall([&](int) { runCommand({CMD_VOLUME, 0}, out, COMMAND_SERIAL); });
+  double line = hostNsPerCall([&](int) { dispatchCommand("volume", out, COMMAND_SERIAL); });
+
+  CommandLine reader;
+  const char* typed = "volume 20\n";
+  double feed = hostNsPerCall([&](int i) { sink = reader.feed(typed[i % 10]); });
+
+  // A line typed key by key, run by the console handler
+  LatencyStats pass;
+  LatencyStats lineToRun;
+  currentVolume = 30;
+  for (int i = 0; i < 20; i++) {
+    const char* text = i % 2 ? "volume 20\n" : "volume 25\n";
+    int target = i % 2 ? 20 : 25;
+    typeSlowly(text);
+    uint64_t lineEnd = nowNs() + 9 * kKeyGapNs;
+    while (currentVolume != target) {
+      pass.add(timeCall(handleSerialCommands));
+      jukeboxLoopOnce();
+    }
+    lineToRun.add(nowNs() - lineEnd);
+    runFor(msToNs(50));
+  }
+
+  // The same with the old blocking read (programming mode used it)
+  LatencyStats blocked;
+  for (int i = 0; i < 20; i++) {
+    typeSlowly("volume 20\n");
+    uint64_t end = nowNs() + 10 * kKeyGapNs;
+    while (nowNs() < end) {
+      blocked.add(timeCall(readLineBlocking));
+      advanceNs(kRunForStepNs);
+    }
+  }
+
+  // A line over MAX_LENGTH is reported, not run
+  uart(0).captured.clear();
+  uint32_t droppedBefore = serialLine.dropped();
+  typeSerial(std::string(CommandLine::MAX_LENGTH + 8, 'x') + "\n");
+  runFor(msToNs(100));
+  bool reported = serialLine.dropped() == droppedBefore + 1 &&
+                  uart(0).captured.find("Line too long") != std::string::npos;
+
+  // The web status has to fit one response slot
+  NullPrint serialStatus;
+  NullPrint webStatus;
+  runCommand({CMD_STATUS, 0}, serialStatus, COMMAND_SERIAL);
+  runCommand({CMD_STATUS, 0}, webStatus, COMMAND_WEB);
+
+  printTableHeader();
+  printRow("handleSerialCommands() pass", pass);
+  printRow("line end -> command run", lineToRun);
+  printRow("readStringUntil() pass", blocked);
+  printValue("parse \"s\" (host)", parseShort, "ns");
+  printValue("parse \"volume 20\" (host)", parseNumber, "ns");
+  printValue("parse unknown (host)", parseUnknown, "ns");
+  printValue("switch case, inline (host)", direct, "ns");
+  printValue("runCommand() (host)", table, "ns");
+  printValue("dispatchCommand() (host)", line, "ns");
+  printValue("CommandLine::feed() (host)", feed, "ns/byte");
+  printf("  over-long line reported on the console: %s\n", reported ? "yes" : "NO");
+  printValue("status reply, serial", (double)serialStatus.bytes, "bytes");
+  printValue("status reply, web", (double)webStatus.bytes, "bytes");
+  printf("  web status fits a %u-byte response slot: %s\n", (unsigned)WebResponseRing::SLOT_SIZE,
+         webStatus.bytes < WebResponseRing::SLOT_SIZE ? "yes" : "NO");
+  (void)sink;
+}
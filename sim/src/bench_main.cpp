@@ -0,0 +1,842 @@
+/*
+   ESP32 RFID Jukebox - native benchmark runner
+
+   Entry point of the [env:native] program. Boots the sketch against the
+   simulated hardware and runs the registered benchmarks. The loop handler
+   benchmarks live here; feature-specific suites register from their own
+   files.
+*/
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "jukebox.h"
+#include "sim_bench.h"
+#include "song_catalog.h"
+
+namespace sim {
+
+namespace {
+
+struct Benchmark {
+  const char* name;
+  BenchmarkFn fn;
+};
+
+std::vector<Benchmark>& registry() {
+  static std::vector<Benchmark> benchmarks;
+  return benchmarks;
+}
+
+bool g_booted = false;
+
+}  // namespace
+
+BenchmarkRegistrar::BenchmarkRegistrar(const char* name, BenchmarkFn fn) {
+  registry().push_back(Benchmark{name, fn});
+}
+
+//*****************************************************************************
+// Statistics and output
+//*****************************************************************************
+uint64_t LatencyStats::percentile(double p) {
+  if (samples_.empty()) return 0;
+  if (!sorted_) {
+    std::sort(samples_.begin(), samples_.end());
+    sorted_ = true;
+  }
+  size_t index = (size_t)(p / 100.0 * (samples_.size() - 1) + 0.5);
+  return samples_[std::min(index, samples_.size() - 1)];
+}
+
+uint64_t LatencyStats::max() { return percentile(100.0); }
+
+double LatencyStats::meanNs() const {
+  if (samples_.empty()) return 0.0;
+  double sum = 0.0;
+  for (uint64_t s : samples_) sum += (double)s;
+  return sum / samples_.size();
+}
+
+void printHeader(const char* title) {
+  printf("\n[%s]\n", title);
+}
+
+void printTableHeader() {
+  printf("  %-30s %8s %10s %10s %10s %10s\n", "", "samples", "mean ms", "p50 ms", "p99 ms", "max ms");
+}
+
+void printRow(const char* label, LatencyStats& stats) {
+  printf("  %-30s %8zu %10.3f %10.3f %10.3f %10.3f\n", label, stats.count(),
+         stats.meanNs() / 1e6, stats.percentile(50) / 1e6, stats.percentile(99) / 1e6,
+         stats.max() / 1e6);
+}
+
+void printValue(const char* label, double value, const char* unit) {
+  printf("  %-30s %12.2f %s\n", label, value, unit);
+}
+
+//*****************************************************************************
+// Sketch lifecycle
+//*****************************************************************************
+void bootSketch() {
+  if (g_booted) return;
+  g_booted = true;
+  setup();
+  // WiFi never connects in the simulation; let the sketch reach its timeout
+  uint64_t end = nowNs() + msToNs(11000);
+  while (nowNs() < end) {
+    loop();
+    advanceNs(usToNs(100));
+  }
+}
+
+uint64_t timeCall(void (*fn)()) {
+  uint64_t start = nowNs();
+  fn();
+  return nowNs() - start;
+}
+
+void runFor(uint64_t ns) {
+  uint64_t end = nowNs() + ns;
+  while (nowNs() < end) loopStep(kRunForStepNs);
+}
+
+void loopStep(uint64_t minNs) {
+  // Iterations that return early (debounce, read hold-off) are padded so
+  // settling periods don't take millions of host iterations
+  uint64_t start = nowNs();
+  jukeboxLoopOnce();
+  uint64_t spent = nowNs() - start;
+  if (spent < minNs) advanceNs(minNs - spent);
+}
+
+void jukeboxLoopOnce() {
+  // Keep in step with runJukeboxStepsOnce() once WiFi setup has completed
+  uint64_t start = nowNs();
+  if (jukeboxMode) {
+    handleButtons();
+    handleRFID();
+    playerStep();
+    logStep();
+  } else {
+    loop();
+  }
+  // An iteration with nothing to do still costs the loop() call overhead
+  if (nowNs() == start) advanceNs(1000);
+}
+
+}  // namespace sim
+
+//*****************************************************************************
+// Loop handler benchmarks
+//*****************************************************************************
+using namespace sim;
+
+// One loop iteration with each handler timed separately
+static void timedIteration(LatencyStats* stats) {
+  stats[0].add(timeCall(handleButtons));
+  stats[1].add(timeCall(handleRFID));
+  stats[2].add(timeCall(handleInputEvents));
+  stats[3].add(timeCall(handleSerialCommands));
+  stats[4].add(timeCall(checkAutoProgression));
+}
+
+static void printHandlerTable(LatencyStats* stats) {
+  static const char* names[] = {"handleButtons", "handleRFID", "handleInputEvents",
+                                "handleSerialCommands", "checkAutoProgression"};
+  printTableHeader();
+  for (int i = 0; i < 5; i++) printRow(names[i], stats[i]);
+}
+
+SIM_BENCHMARK(idle) {
+  bootSketch();
+  printHeader("idle: 10000 loop iterations, no input");
+  LatencyStats stats[5];
+  LatencyStats iteration;
+  uint64_t start = nowNs();
+  for (int i = 0; i < 10000; i++) {
+    uint64_t t = nowNs();
+    timedIteration(stats);
+    iteration.add(nowNs() - t);
+  }
+  printHandlerTable(stats);
+  printRow("loop iteration", iteration);
+  printValue("loop rate", 10000.0 / ((nowNs() - start) / 1e9), "iterations/s");
+}
+
+SIM_BENCHMARK(buttons) {
+  bootSketch();
+  printHeader("buttons: 200 presses each of play/pause, next, previous");
+  const uint8_t pins[] = {PLAY_PAUSE_BUTTON, NEXT_BUTTON, PREV_BUTTON};
+  const char* names[] = {"play/pause edge", "next edge", "previous edge"};
+  printTableHeader();
+  for (int b = 0; b < 3; b++) {
+    LatencyStats edge;
+    for (int i = 0; i < 200; i++) {
+      setPin(pins[b], LOW);
+      edge.add(timeCall([] { handleButtons(); handleInputEvents(); }));
+      runFor(msToNs(80));
+      setPin(pins[b], HIGH);
+      runFor(msToNs(200));
+    }
+    printRow(names[b], edge);
+  }
+}
+
+static uint32_t g_frames = 0;          // DFPlayer frames seen so far
+static uint64_t g_frameNs = 0;         // when the last one was sent
+
+static void noteFrame() {
+  if (playerScheduler.framesSent() == g_frames) return;
+  g_frames = playerScheduler.framesSent();
+  g_frameNs = nowNs();
+}
+
+// Every interrupt wakes the input task, and an event from it the player task
+static void afterInterrupt() {
+  handleButtons();
+  playerStep();
+  noteFrame();
+}
+
+// Move a button contact to `level` the way a real one does: a few short
+// bounces first
+static void bounceTo(uint8_t pin, int level, int bounces) {
+  for (int i = 0; i < bounces; i++) {
+    setPin(pin, level);
+    afterInterrupt();
+    advanceNs(usToNs(300));
+    setPin(pin, !level);
+    afterInterrupt();
+    advanceNs(usToNs(500));
+  }
+  setPin(pin, level);
+  afterInterrupt();
+}
+
+// Start counting frames from now
+static uint32_t framesNow() {
+  g_frames = playerScheduler.framesSent();
+  return g_frames;
+}
+
+// Run the steps until the player has sent a DFPlayer frame; time from `since`
+static uint64_t untilFrame(uint32_t frames, uint64_t since) {
+  uint64_t deadline = nowNs() + msToNs(2000);
+  while (g_frames == frames && nowNs() < deadline) {
+    jukeboxLoopOnce();
+    noteFrame();
+  }
+  return g_frameNs - since;
+}
+
+SIM_BENCHMARK(gestures) {
+  bootSketch();
+  printHeader("gestures: bouncing contacts, long, double and reset presses");
+  const int kBounces = 4;
+  LatencyStats press, single;
+
+  // Play/pause with bouncing contacts: one action per physical press
+  uint32_t presses = buttonInput.gestures(GESTURE_PRESS);
+  uint32_t edges = buttonInput.edges();
+  for (int i = 0; i < 200; i++) {
+    uint32_t frames = framesNow();
+    uint64_t pressed = nowNs();
+    bounceTo(PLAY_PAUSE_BUTTON, LOW, kBounces);
+    press.add(untilFrame(frames, pressed));
+    runFor(msToNs(100));
+    bounceTo(PLAY_PAUSE_BUTTON, HIGH, kBounces);
+    runFor(msToNs(200));
+  }
+  double pressEvents = buttonInput.gestures(GESTURE_PRESS) - presses;
+  double pressEdges = buttonInput.edges() - edges;
+
+  // Next held for 3 s: a press, then fast skip
+  uint32_t frames = playerScheduler.framesSent();
+  uint32_t longs = buttonInput.gestures(GESTURE_LONG);
+  bounceTo(NEXT_BUTTON, LOW, kBounces);
+  runFor(msToNs(3000));
+  bounceTo(NEXT_BUTTON, HIGH, kBounces);
+  runFor(msToNs(500));
+  double heldSkips = playerScheduler.framesSent() - frames;
+  double heldLongs = buttonInput.gestures(GESTURE_LONG) - longs;
+
+  // Shuffle: 100 double presses, then 100 single presses (which wait out the double window)
+  uint32_t doubles = buttonInput.gestures(GESTURE_DOUBLE);
+  presses = buttonInput.gestures(GESTURE_PRESS);
+  for (int i = 0; i < 100; i++) {
+    for (int p = 0; p < 2; p++) {
+      bounceTo(SHUFFLE_BUTTON, LOW, kBounces);
+      runFor(msToNs(80));
+      bounceTo(SHUFFLE_BUTTON, HIGH, kBounces);
+      runFor(msToNs(120));
+    }
+    runFor(msToNs(600));
+  }
+  double doubleEvents = buttonInput.gestures(GESTURE_DOUBLE) - doubles;
+  double doubleStrays = buttonInput.gestures(GESTURE_PRESS) - presses;
+  for (int i = 0; i < 100; i++) {
+    uint32_t sent = framesNow();
+    uint64_t pressed = nowNs();
+    bounceTo(SHUFFLE_BUTTON, LOW, kBounces);
+    runFor(msToNs(80));
+    bounceTo(SHUFFLE_BUTTON, HIGH, kBounces);
+    single.add(untilFrame(sent, pressed));
+    runFor(msToNs(600));
+  }
+
+  // Reset: contact glitches must not restart, a hold must
+  uint32_t restarts = restartCount();
+  for (int i = 0; i < 100; i++) {
+    bounceTo(RESET_BUTTON, LOW, kBounces);
+    bounceTo(RESET_BUTTON, HIGH, kBounces);
+    runFor(msToNs(200));
+  }
+  double glitchRestarts = restartCount() - restarts;
+  bounceTo(RESET_BUTTON, LOW, kBounces);
+  runFor(msToNs(1000));
+  bounceTo(RESET_BUTTON, HIGH, kBounces);
+  runFor(msToNs(200));
+  double holdRestarts = restartCount() - restarts - glitchRestarts;
+
+  printTableHeader();
+  printRow("play/pause edge -> frame", press);
+  printRow("shuffle single edge -> frame", single);
+  printValue("edges per play/pause press", pressEdges / 200, "");
+  printValue("actions per play/pause press", pressEvents / 200, "");
+  printValue("next held 3 s: skips", heldSkips, "");
+  printValue("next held 3 s: long events", heldLongs, "");
+  printValue("shuffle doubles recognised", doubleEvents, "of 100");
+  printValue("shuffle singles during doubles", doubleStrays, "");
+  printValue("restarts from 100 reset glitches", glitchRestarts, "");
+  printValue("restarts from a 1 s reset hold", holdRestarts, "");
+}
+
+SIM_BENCHMARK(rfid) {
+  bootSketch();
+  printHeader("rfid: 1000 card taps, tracks 1-41");
+  LatencyStats read;
+  std::vector<Card> cards;
+  for (int n = 1; n <= 41; n++) cards.push_back(makeClassicCard(0xA0000000u + n, n));
+  for (int i = 0; i < 1000; i++) {
+    presentCard(&cards[i % cards.size()]);
+    uint32_t before = playerScheduler.trackChanges();
+    uint64_t deadline = nowNs() + msToNs(2000);
+    while (playerScheduler.trackChanges() == before && nowNs() < deadline) {
+      uint64_t t = nowNs();
+      jukeboxLoopOnce();
+      if (playerScheduler.trackChanges() != before) read.add(nowNs() - t);
+    }
+    runFor(msToNs(300));
+    removeCard();
+    runFor(msToNs(700));
+  }
+  printTableHeader();
+  printRow("loop iteration with tap", read);
+  printValue("SPI transactions", (double)rfidStats().spiTransactions, "");
+}
+
+SIM_BENCHMARK(serial) {
+  bootSketch();
+  printHeader("serial: 100 of each console command");
+  const char* commands = "vsz+-l";
+  printTableHeader();
+  for (const char* c = commands; *c; c++) {
+    LatencyStats handled;
+    for (int i = 0; i < 100; i++) {
+      typeSerial(std::string(1, *c) + "\n");
+      advanceNs(msToNs(1));
+      handled.add(timeCall(handleSerialCommands));
+      runFor(msToNs(50));
+    }
+    char label[32];
+    snprintf(label, sizeof(label), "command '%c'", *c);
+    printRow(label, handled);
+  }
+}
+
+// Start from silence, not from whatever an earlier benchmark left playing
+static void stopPlayback() {
+  customShuffleMode = false;
+  isPlaying = false;
+  playerScheduler.stop();
+  runFor(msToNs(300));
+}
+
+SIM_BENCHMARK(autoprogression) {
+  bootSketch();
+  printHeader("autoprogression: 100 shuffle tracks of 5 s");
+  stopPlayback();
+  dfplayer().defaultTrackNs = msToNs(5000);
+  LatencyStats poll;
+  LatencyStats detect;
+  LatencyStats gap;
+  startCustomShuffle();
+  size_t framesBefore = dfplayer().received.size();
+  for (int i = 0; i < 100; i++) {
+    // Wait for the module to start the track, then for the one after it
+    while (dfplayer().state != 1) jukeboxLoopOnce();
+    uint64_t started = dfplayer().audioStartNs;
+    uint64_t ended = dfplayer().trackEndNs;
+    uint32_t changes = playerScheduler.trackChanges();
+    bool detected = false;
+    while (dfplayer().audioStartNs == started || dfplayer().state != 1) {
+      playerScheduler.update();
+      announceArmedTrack();
+      handleButtons();
+      handleRFID();
+      handleInputEvents();
+      handleSerialCommands();
+      poll.add(timeCall(checkAutoProgression));
+      if (!detected && playerScheduler.trackChanges() != changes) {
+        detect.add(nowNs() - ended);
+        detected = true;
+      }
+    }
+    gap.add(dfplayer().audioStartNs - ended);
+  }
+  size_t queries = 0;
+  for (size_t f = framesBefore; f < dfplayer().received.size(); f++) {
+    if (dfplayer().received[f].command == 0x42) queries++;
+  }
+  dfplayer().defaultTrackNs = DfplayerModel().defaultTrackNs;
+  printTableHeader();
+  printRow("checkAutoProgression call", poll);
+  printRow("track end -> next track queued", detect);
+  printRow("track end -> next audio", gap);
+  printValue("state queries on the UART", (double)queries, "");
+}
+
+// Play 30 queued 5 s tracks; armed = next track sent from the finish frame
+static void playQueued(bool armed, LatencyStats& gap) {
+  for (int i = 0; i < 30; i++) enqueueTrack(1 + i % 41);
+  playQueuedTrack();
+  for (int i = 0; i < 29; i++) {
+    while (dfplayer().state != 1) jukeboxLoopOnce();
+    uint64_t started = dfplayer().audioStartNs;
+    uint64_t ended = dfplayer().trackEndNs;
+    while (dfplayer().audioStartNs == started || dfplayer().state != 1) {
+      jukeboxLoopOnce();
+      if (!armed) playerScheduler.armNext(0);
+    }
+    gap.add(dfplayer().audioStartNs - ended);
+  }
+}
+
+// A stop from the web that runs in the same pass in which the scheduler
+// starts the armed track: the player must end up stopped
+static bool stopInArmedPass() {
+  enqueueTrack(1);
+  enqueueTrack(2);
+  enqueueTrack(3);
+  playQueuedTrack();
+  while (dfplayer().state != 1) jukeboxLoopOnce();
+  Uart& line = uart(2);
+  uint32_t armedBefore = playerScheduler.armedAdvances();
+  bool stopQueued = false;
+  while (playerScheduler.armedAdvances() == armedBefore) {
+    if (line.device) line.device->poll(nowNs());
+    if (line.rx.size() < DFPLAYER_SEND_LENGTH) {
+      jukeboxLoopOnce();
+      continue;
+    }
+    // The finish frame is on its way: wait for its last byte, then run the
+    // player pass that parses it with a stop queued
+    uint64_t complete = line.rx[DFPLAYER_SEND_LENGTH - 1].first;
+    if (complete > nowNs()) advanceNs(complete - nowNs());
+    stopQueued = webCommands.push({CMD_STOP, 0}) != 0;
+    playerStep();
+  }
+  runFor(msToNs(300));
+  playQueue.clear();
+  return stopQueued && !isPlaying && dfplayer().state != 1;
+}
+
+SIM_BENCHMARK(playqueue) {
+  bootSketch();
+  printHeader("playqueue: 30 queued tracks of 5 s, armed vs sent by the loop");
+  stopPlayback();
+  dfplayer().defaultTrackNs = msToNs(5000);
+
+  LatencyStats unarmed;
+  playQueued(false, unarmed);
+  uint32_t unarmedMax = playerScheduler.maxAdvanceMs();
+  stopPlayback();
+
+  LatencyStats armed;
+  uint32_t armedBefore = playerScheduler.armedAdvances();
+  playQueued(true, armed);
+  uint32_t armedCount = playerScheduler.armedAdvances() - armedBefore;
+  uint32_t lastAdvance = playerScheduler.lastAdvanceMs();
+  stopPlayback();
+  bool stopped = stopInArmedPass();
+  stopPlayback();
+  dfplayer().defaultTrackNs = DfplayerModel().defaultTrackNs;
+
+  printTableHeader();
+  printRow("track end -> next audio, loop", unarmed);
+  printRow("track end -> next audio, armed", armed);
+  printValue("armed transitions", (double)armedCount, "of 29");
+  printValue("finish -> play frame, loop (max)", (double)unarmedMax, "ms");
+  printValue("finish -> play frame, armed", (double)lastAdvance, "ms");
+  printValue("queue capacity", PlayQueue::CAPACITY, "tracks");
+  printf("  stop in the pass of an armed start stops: %s\n", stopped ? "yes" : "NO");
+}
+
+// Tracks that play twice in a row where one cycle ends and the next begins,
+// for the old reshuffle (Fisher-Yates into a fresh array) and ShuffleOrder
+static int fisherYatesRepeats(uint16_t size, int cycles) {
+  std::vector<uint16_t> order(size);
+  uint16_t last = 0;
+  int repeats = 0;
+  for (int c = 0; c < cycles; c++) {
+    for (uint16_t i = 0; i < size; i++) order[i] = i + 1;
+    for (int i = size - 1; i > 0; i--) std::swap(order[i], order[rand() % (i + 1)]);
+    if (order[0] == last) repeats++;
+    last = order[size - 1];
+  }
+  return repeats;
+}
+
+static int shuffleOrderRepeats(uint16_t size, int cycles, bool& valid) {
+  ShuffleOrder order;
+  order.begin(size, rand());
+  std::vector<uint8_t> seen(size + 1);
+  int repeats = 0;
+  for (int c = 0; c < cycles; c++) {
+    if (c > 0) {
+      uint16_t last = order.at(size - 1);
+      uint16_t upcoming = order.upcoming(size);
+      order.nextCycle();
+      if (order.at(0) != upcoming) valid = false;
+      if (order.at(0) == last) repeats++;
+    }
+    std::fill(seen.begin(), seen.end(), 0);
+    for (uint16_t i = 0; i < size; i++) {
+      uint16_t track = order.at(i);
+      if (track < 1 || track > size || seen[track]) valid = false;
+      else seen[track] = 1;
+    }
+  }
+  return repeats;
+}
+
+SIM_BENCHMARK(shuffle) {
+  bootSketch();
+  printHeader("shuffle: computed order vs a stored Fisher-Yates playlist");
+
+  const int kCycles = 2000;
+  bool valid = true;
+  int oldSmall = fisherYatesRepeats(songCount(), kCycles);
+  int newSmall = shuffleOrderRepeats(songCount(), kCycles, valid);
+  shuffleOrderRepeats(10000, 200, valid);
+
+  // Two full cycles through the sketch, 5 s tracks, armed across the boundary
+  stopPlayback();
+  dfplayer().defaultTrackNs = msToNs(5000);
+  LatencyStats gap;
+  uint64_t boundaryGap = 0;
+  int sketchRepeats = 0;
+  int played = 0;
+  startCustomShuffle();
+  uint16_t previous = 0;
+  while (played < 2 * songCount() + 1) {
+    while (dfplayer().state != 1) jukeboxLoopOnce();
+    uint64_t started = dfplayer().audioStartNs;
+    uint64_t ended = dfplayer().trackEndNs;
+    if (currentSong == previous) sketchRepeats++;
+    previous = currentSong;
+    bool atBoundary = shuffleIndex == shuffleSize;
+    while (dfplayer().audioStartNs == started || dfplayer().state != 1) jukeboxLoopOnce();
+    uint64_t g = dfplayer().audioStartNs - ended;
+    gap.add(g);
+    if (atBoundary && boundaryGap == 0) boundaryGap = g;
+    played++;
+  }
+  stopPlayback();
+  dfplayer().defaultTrackNs = DfplayerModel().defaultTrackNs;
+
+  printTableHeader();
+  printRow("track end -> next audio", gap);
+  printValue("next audio at the cycle boundary", boundaryGap / 1e6, "ms");
+  printValue("boundary repeats, sketch", (double)sketchRepeats, "");
+  printValue("playlist memory, 41 songs, array", 2.0 * songCount(), "bytes");
+  printValue("playlist memory, 10000 songs, array", 2.0 * 10000, "bytes");
+  printValue("shuffle order memory, any size", (double)sizeof(ShuffleOrder), "bytes");
+  printValue("boundary repeats, Fisher-Yates", (double)oldSmall, "of 2000");
+  printValue("boundary repeats, ShuffleOrder", (double)newSmall, "of 2000");
+  printf("  every cycle a permutation (41, 10000): %s\n", valid ? "yes" : "NO");
+}
+
+// Press next at a random point and run single-loop passes until the
+// DFPlayer frame for it is sent; with a card tap at the same time the press
+// waits behind the card read in the same pass
+static void pressNext(Card* card, LatencyStats& latency) {
+  runJukeboxStepsOnce();
+  if (card) presentCard(card);
+  uint32_t frames = playerScheduler.framesSent();
+  uint64_t pressed = nowNs();
+  setPin(NEXT_BUTTON, LOW);
+  uint64_t deadline = nowNs() + msToNs(2000);
+  while (playerScheduler.framesSent() == frames && nowNs() < deadline) runJukeboxStepsOnce();
+  latency.add(nowNs() - pressed);
+  runFor(msToNs(80));
+  setPin(NEXT_BUTTON, HIGH);
+  if (card) removeCard();
+  runFor(msToNs(400));
+}
+
+SIM_BENCHMARK(tasks) {
+  bootSketch();
+  printHeader("tasks: subsystem steps run in turn, next pressed during card reads");
+  stopPlayback();
+  cardCache.clear();
+  std::vector<Card> cards;
+  for (int n = 1; n <= 41; n++) cards.push_back(makeClassicCard(0xC0000000u + n, n));
+
+  uint32_t queued = inputEvents.pushed();
+  LatencyStats alone;
+  LatencyStats withTap;
+  for (int i = 0; i < 100; i++) pressNext(nullptr, alone);
+  for (int i = 0; i < 41; i++) pressNext(&cards[i], withTap);
+  cardCache.clear();
+  stopPlayback();
+
+  printTableHeader();
+  printRow("press -> DFPlayer frame", alone);
+  printRow("press -> frame, card read", withTap);
+  for (uint8_t i = 0; i < JUKEBOX_TASK_COUNT; i++) {
+    const TaskStats& stats = taskStats((JukeboxTask)i);
+    char label[40];
+    snprintf(label, sizeof(label), "%s step, longest", taskConfig((JukeboxTask)i).name);
+    printValue(label, stats.maxUs() / 1000.0, "ms");
+  }
+  printValue("input events queued", (double)(inputEvents.pushed() - queued), "");
+  printValue("input events dropped", (double)inputEvents.dropped(), "");
+}
+
+SIM_BENCHMARK(trackchange) {
+  bootSketch();
+  printHeader("trackchange: 200 track changes through the scheduler");
+  LatencyStats dispatch;
+  LatencyStats iteration;
+  LatencyStats transition;
+  size_t loops = 0;
+  for (int i = 0; i < 200; i++) {
+    uint64_t start = nowNs();
+    dispatch.add(timeCall([] { playCardNumber(1 + rand() % 41); }));
+    while (playerScheduler.busy()) {
+      iteration.add(timeCall(jukeboxLoopOnce));
+      loops++;
+    }
+    transition.add(nowNs() - start);
+    runFor(msToNs(500));
+  }
+  printTableHeader();
+  printRow("playCardNumber call", dispatch);
+  printRow("loop iteration during change", iteration);
+  printRow("stop -> play sent", transition);
+  printValue("loop iterations per change", (double)loops / 200, "");
+  printValue("loop rate during changes", playerScheduler.transitionLoopRate(), "iterations/s");
+}
+
+namespace {
+
+struct CapturePrint : public Print {
+  std::string text;
+  size_t write(uint8_t c) override { text += (char)c; return 1; }
+};
+
+// Upper bound (us) of the bucket holding the q-quantile of the calls added since `before`
+double histogramQuantileUs(const StepHistogram& now, const StepHistogram& before, double q) {
+  uint32_t total = now.count() - before.count();
+  if (total == 0) return 0;
+  uint32_t cumulative = 0;
+  for (uint8_t i = 0; i < StepHistogram::BUCKETS; i++) {
+    cumulative += now.bucket(i) - before.bucket(i);
+    if (cumulative >= q * total) return StepHistogram::BOUNDS_US[i];
+  }
+  return INFINITY;
+}
+
+// Every sample line is `name{labels} value`, buckets rise to +Inf == _count
+bool validExposition(const std::string& text, int& samples) {
+  samples = 0;
+  size_t pos = 0;
+  double previousBucket = 0;
+  double infBucket = -1;
+  while (pos < text.size()) {
+    size_t end = text.find('\n', pos);
+    if (end == std::string::npos) return false;        // every line ends in \n
+    std::string line = text.substr(pos, end - pos);
+    pos = end + 1;
+    if (line.empty() || line[0] == '#') continue;
+    size_t space = line.rfind(' ');
+    if (space == std::string::npos) return false;
+    char* rest = nullptr;
+    double value = strtod(line.c_str() + space + 1, &rest);
+    if (*rest != '\0') return false;
+    samples++;
+    if (line.find("_bucket{") != std::string::npos) {
+      bool first = line.find("le=\"0.00001\"") != std::string::npos;
+      if (!first && value < previousBucket) return false;
+      previousBucket = value;
+      if (line.find("le=\"+Inf\"") != std::string::npos) infBucket = value;
+    } else if (line.find("_count") != std::string::npos && infBucket >= 0) {
+      if (value != infBucket) return false;
+      infBucket = -1;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+SIM_BENCHMARK(metrics) {
+  bootSketch();
+  printHeader("metrics: 60 s of taps, presses and console commands, then a scrape");
+  StepHistogram before[METRIC_STEP_COUNT];
+  for (uint8_t i = 0; i < METRIC_STEP_COUNT; i++) before[i] = stepHistogram((MetricStep)i);
+  StepHistogram gapsBefore = loopGapHistogram();
+
+  std::vector<Card> cards;
+  for (int n = 1; n <= 20; n++) cards.push_back(makeClassicCard(0xF0000000u + n, n));
+  for (int second = 0; second < 60; second++) {
+    if (second % 3 == 0) presentCard(&cards[(second / 3) % cards.size()]);
+    if (second % 2 == 1) setPin(NEXT_BUTTON, LOW);
+    if (second % 10 == 5) typeSerial("s\n");
+    runFor(msToNs(200));
+    removeCard();
+    setPin(NEXT_BUTTON, HIGH);
+    runFor(msToNs(800));
+  }
+  stopPlayback();
+  cardCache.clear();
+
+  CapturePrint scrape;
+  writeMetrics(scrape);
+  int samples = 0;
+  bool valid = validExposition(scrape.text, samples);
+
+  static const char* names[METRIC_STEP_COUNT] = {
+    "buttons", "rfid", "serial", "autoprogression", "wifi", "dfplayer tx", "dfplayer rx"
+  };
+  printf("  %-30s %9s %10s %10s\n", "step", "calls", "p50 <= us", "p99 <= us");
+  for (uint8_t i = 0; i < METRIC_STEP_COUNT; i++) {
+    const StepHistogram& now = stepHistogram((MetricStep)i);
+    printf("  %-30s %9u %10.0f %10.0f\n", names[i], now.count() - before[i].count(),
+           histogramQuantileUs(now, before[i], 0.5), histogramQuantileUs(now, before[i], 0.99));
+  }
+  printf("  %-30s %9u %10.0f %10.0f\n", "loop gap", loopGapHistogram().count() - gapsBefore.count(),
+         histogramQuantileUs(loopGapHistogram(), gapsBefore, 0.5),
+         histogramQuantileUs(loopGapHistogram(), gapsBefore, 0.99));
+  printValue("loop frequency", loopFrequency(), "Hz");
+  printValue("scrape size", (double)scrape.text.size(), "bytes");
+  printValue("scrape samples", samples, "");
+  printValue("scrape valid", valid ? 1 : 0, "");
+}
+
+// One pass of the jukebox steps. printInline formats the log records to
+// Serial right after the step that wrote them, as the Serial.print() calls
+// in the handlers used to; otherwise the log task drains them.
+static void eventLogPass(bool printInline) {
+  uint64_t start = nowNs();
+  handleButtons();
+  if (printInline) eventLog.drain(Serial, SIZE_MAX);
+  handleRFID();
+  if (printInline) eventLog.drain(Serial, SIZE_MAX);
+  playerStep();
+  if (printInline) {
+    eventLog.drain(Serial, SIZE_MAX);
+  } else {
+    logStep();
+  }
+  uint64_t spent = nowNs() - start;
+  if (spent < kRunForStepNs) advanceNs(kRunForStepNs - spent);
+}
+
+static void eventLogRun(bool printInline, std::vector<Card>& cards, LatencyStats& pass, LatencyStats& tap) {
+  uint64_t blockedBefore = uart(0).txBlockedNs;
+  for (int second = 0; second < 60; second++) {
+    uint64_t start = nowNs();
+    uint32_t frames = framesNow();
+    if (second % 2 == 0) {
+      presentCard(&cards[(second / 2) % cards.size()]);
+    } else {
+      setPin(NEXT_BUTTON, LOW);
+    }
+    uint64_t end = start + msToNs(200);
+    while (nowNs() < end) {
+      uint64_t t = nowNs();
+      eventLogPass(printInline);
+      pass.add(nowNs() - t);
+      if (g_frames == frames && playerScheduler.framesSent() != frames) {
+        noteFrame();
+        tap.add(g_frameNs - start);
+      }
+    }
+    removeCard();
+    setPin(NEXT_BUTTON, HIGH);
+    end = nowNs() + msToNs(800);
+    while (nowNs() < end) {
+      uint64_t t = nowNs();
+      eventLogPass(printInline);
+      pass.add(nowNs() - t);
+    }
+  }
+  printValue(printInline ? "inline: UART wait" : "deferred: UART wait",
+             (uart(0).txBlockedNs - blockedBefore) / 1e6, "ms");
+}
+
+SIM_BENCHMARK(eventlog) {
+  bootSketch();
+  printHeader("eventlog: 30 taps and 30 next presses, printed inline vs drained by the log task");
+  std::vector<Card> cards;
+  for (int n = 1; n <= 10; n++) cards.push_back(makeClassicCard(0xE0000000u + n, n));
+
+  LatencyStats inlinePass, inlineTap, deferredPass, deferredTap;
+  uint32_t written = eventLog.written();
+  eventLogRun(true, cards, inlinePass, inlineTap);
+  uint32_t perRun = eventLog.written() - written;
+  eventLogRun(false, cards, deferredPass, deferredTap);
+  stopPlayback();
+  cardCache.clear();
+  runFor(msToNs(100));
+
+  // Host CPU cost of a record, for scale; the ESP32 has no cache misses here
+  auto t0 = std::chrono::steady_clock::now();
+  EventLog scratch;
+  for (int i = 0; i < 1000000; i++) scratch.write(LOG_LEVEL_DEBUG, LOG_CARD_NUMBER, i);
+  double hostNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / 1e6;
+
+  printTableHeader();
+  printRow("inline: step pass", inlinePass);
+  printRow("deferred: step pass", deferredPass);
+  printRow("inline: input -> frame", inlineTap);
+  printRow("deferred: input -> frame", deferredTap);
+  printValue("records per run", perRun, "");
+  printValue("write() host cost", hostNs, "ns/record");
+  printValue("records drained", eventLog.drained(), "");
+  printValue("records lost", eventLog.dropped(), "");
+}
+
+//*****************************************************************************
+int main(int argc, char** argv) {
+  if (getenv("JUKEBOX_SIM_ECHO")) uart(0).echo = true;
+
+  printf("=== ESP32 RFID Jukebox - native benchmarks (virtual time) ===\n");
+  for (const Benchmark& bench : registry()) {
+    bool selected = argc < 2;
+    for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], bench.name) == 0) selected = true;
+    }
+    if (selected) bench.fn();
+  }
+  return 0;
+}
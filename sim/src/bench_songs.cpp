@@ -0,0 +1,241 @@
+/*
+   ESP32 RFID Jukebox - song catalog benchmarks
+
+   songs:   heap allocations per song lookup and per song list, counted by
+            the simulation's operator new
+   catalog: lookup time in a 10000-song SPIFFS catalog file
+   songlist: peak heap of the /api/songs body, streamed in TCP-sized
+            chunks, against building the whole list in one String
+*/
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <memory>
+#include <random>
+#include "jukebox.h"
+#include "sim_bench.h"
+#include "song_catalog.h"
+#include "song_list_json.h"
+
+using namespace sim;
+
+SIM_BENCHMARK(songs) {
+  bootSketch();
+  printHeader("songs: catalog lookups and the 'l' song list");
+
+  const int kRounds = 100;
+  uint64_t before = heapAllocations();
+  size_t length = 0;
+  for (int r = 0; r < kRounds; r++) {
+    for (int i = 1; i <= songCount(); i++) {
+      SongInfo song;
+      if (lookupSong(i, song)) length += song.titleLength + song.artistLength;
+    }
+  }
+  double lookupAllocs = (double)(heapAllocations() - before) / (kRounds * songCount());
+
+  before = heapAllocations();
+  for (int r = 0; r < kRounds; r++) {
+    for (int i = 1; i <= songCount(); i++) length += getSongInfo(i).length();
+  }
+  double stringAllocs = (double)(heapAllocations() - before) / (kRounds * songCount());
+
+  // Serial 'l': the listing itself, without the input handling
+  typeSerial("l\n");
+  advanceNs(msToNs(1));
+  before = heapAllocations();
+  uint64_t listNs = timeCall(handleSerialCommands);
+  double serialAllocs = (double)(heapAllocations() - before);
+
+  before = heapAllocations();
+  CommandReply reply;
+  runCommand({CMD_LIST, 0}, reply, COMMAND_WEB);
+  double webAllocs = (double)(heapAllocations() - before);
+
+  printValue("songs in catalog", songCount(), "");
+  printValue("lookupSong()", lookupAllocs, "allocations/call");
+  printValue("getSongInfo()", stringAllocs, "allocations/call");
+  printValue("serial 'l' list", serialAllocs, "allocations");
+  printValue("serial 'l' list time", listNs / 1e6, "ms");
+  printValue("web 'l' response", webAllocs, "allocations");
+  if (length == 0) printf("  (empty catalog)\n");
+}
+
+// Write a catalog file of count songs in the layout of song_catalog.h
+static void writeCatalog(const char* path, uint32_t count) {
+  std::vector<uint8_t> records;
+  std::vector<uint32_t> offsets;
+  uint32_t base = 8 + (count + 1) * 4;
+  for (uint32_t n = 1; n <= count; n++) {
+    offsets.push_back(base + records.size());
+    char title[48];
+    char artist[32];
+    snprintf(title, sizeof(title), "Song number %u of the big collection", (unsigned)n);
+    snprintf(artist, sizeof(artist), "Artist %u", (unsigned)(n % 700));
+    for (const char* text : {(const char*)title, (const char*)artist}) {
+      records.push_back((uint8_t)strlen(text));
+      records.insert(records.end(), text, text + strlen(text));
+      records.push_back(0);
+    }
+  }
+  offsets.push_back(base + records.size());
+
+  File file = SPIFFS.open(path, FILE_WRITE);
+  uint8_t header[8] = {'J', 'B', 'S', 0x01, (uint8_t)count, (uint8_t)(count >> 8),
+                       (uint8_t)(count >> 16), (uint8_t)(count >> 24)};
+  file.write(header, sizeof(header));
+  for (uint32_t offset : offsets) {
+    uint8_t le[4] = {(uint8_t)offset, (uint8_t)(offset >> 8), (uint8_t)(offset >> 16),
+                     (uint8_t)(offset >> 24)};
+    file.write(le, sizeof(le));
+  }
+  file.write(records.data(), records.size());
+  file.close();
+}
+
+SIM_BENCHMARK(catalog) {
+  const uint32_t kSongs = 10000;
+  bootSketch();
+  printHeader("catalog: SPIFFS song catalog with 10000 songs");
+
+  writeCatalog("/catalog.bin", kSongs);
+  uint64_t start = nowNs();
+  bool opened = beginSongCatalog(SPIFFS);
+  uint64_t openNs = nowNs() - start;
+
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> track(1, kSongs);
+  LatencyStats random;
+  LatencyStats repeat;
+  LatencyStats builtIn;
+  const int kLookups = 10000;
+  uint64_t allocs = heapAllocations();
+  for (int i = 0; i < kLookups; i++) {
+    SongInfo song;
+    lookupSong(track(rng), song);
+  }
+  allocs = heapAllocations() - allocs;
+
+  uint64_t bytesRead = flashStats().bytesRead;
+  for (int i = 0; i < kLookups; i++) {
+    SongInfo song;
+    int n = track(rng);
+    start = nowNs();
+    lookupSong(n, song);
+    random.add(nowNs() - start);
+    start = nowNs();
+    lookupSong(n, song);
+    repeat.add(nowNs() - start);
+  }
+  bytesRead = flashStats().bytesRead - bytesRead;
+  uint16_t count = songCount();
+
+  // Back to the built-in table for the other benchmarks
+  SPIFFS.remove("/catalog.bin");
+  beginSongCatalog(SPIFFS);
+  for (int i = 0; i < kLookups; i++) {
+    SongInfo song;
+    start = nowNs();
+    lookupSong(1 + i % songCount(), song);
+    builtIn.add(nowNs() - start);
+  }
+
+  printTableHeader();
+  printRow("lookup, random track", random);
+  printRow("lookup, same track again", repeat);
+  printRow("lookup, built-in table", builtIn);
+  printValue("catalog opened", opened ? 1 : 0, "");
+  printValue("song count read at boot", count, "");
+  printValue("open + header", openNs / 1e6, "ms");
+  printValue("flash bytes per lookup", (double)bytesRead / (2 * kLookups), "");
+  printValue("heap allocations", (double)allocs, "");
+}
+
+// The list as the web 'l' command used to build it, one += at a time
+static size_t buildListString() {
+  String list = "=== Song List ===\n";
+  for (int i = 1; i <= songCount(); i++) {
+    SongInfo song;
+    lookupSong(i, song);
+    list += "Track ";
+    list += i;
+    list += ": ";
+    list += song.title;
+    list += " - ";
+    list += song.artist;
+    list += "\n";
+  }
+  return list.length();
+}
+
+struct StreamResult {
+  size_t bytes;
+  size_t chunks;
+  size_t peakHeap;
+  uint64_t ns;
+};
+
+// Drain /api/songs the way AsyncWebServer's chunked response does
+static StreamResult streamList(uint32_t offset, uint32_t limit) {
+  const size_t kChunk = 1436;           // one TCP segment on the ESP32
+  static uint8_t buffer[kChunk];
+  StreamResult result = {0, 0, 0, 0};
+  resetHeapPeak();
+  size_t base = heapInUse();
+  uint64_t start = nowNs();
+  {
+    auto stream = std::make_shared<SongListJson>();
+    stream->begin(offset, limit);
+    size_t n;
+    while ((n = stream->read(buffer, kChunk)) > 0) {
+      result.bytes += n;
+      result.chunks++;
+    }
+  }
+  result.ns = nowNs() - start;
+  result.peakHeap = heapPeak() - base;
+  return result;
+}
+
+static size_t stringPeak(size_t* bytes) {
+  resetHeapPeak();
+  size_t base = heapInUse();
+  *bytes = buildListString();
+  return heapPeak() - base;
+}
+
+static void printList(const char* label, const StreamResult& r) {
+  char line[96];
+  snprintf(line, sizeof(line), "%s: %zu bytes in %zu chunks, %.2f ms",
+           label, r.bytes, r.chunks, r.ns / 1e6);
+  printf("  %s\n", line);
+}
+
+SIM_BENCHMARK(songlist) {
+  bootSketch();
+  printHeader("songlist: /api/songs streamed vs one String");
+
+  size_t smallBytes;
+  size_t smallString = stringPeak(&smallBytes);
+  StreamResult small = streamList(0, 0xFFFFFFFF);
+
+  writeCatalog("/catalog.bin", 10000);
+  beginSongCatalog(SPIFFS);
+  size_t bigBytes;
+  size_t bigString = stringPeak(&bigBytes);
+  StreamResult big = streamList(0, 0xFFFFFFFF);
+  StreamResult page = streamList(5000, 100);
+
+  SPIFFS.remove("/catalog.bin");
+  beginSongCatalog(SPIFFS);
+
+  printList("41 songs, streamed", small);
+  printList("10000 songs, streamed", big);
+  printList("10000 songs, page of 100", page);
+  printValue("peak heap, 41 songs, String", (double)smallString, "bytes");
+  printValue("peak heap, 41 songs, streamed", (double)small.peakHeap, "bytes");
+  printValue("peak heap, 10000 songs, String", (double)bigString, "bytes");
+  printValue("peak heap, 10000 songs, streamed", (double)big.peakHeap, "bytes");
+  printValue("peak heap, page of 100, streamed", (double)page.peakHeap, "bytes");
+  if (smallBytes == 0 || bigBytes == 0) printf("  (empty list)\n");
+}
@@ -0,0 +1,127 @@
+/*
+   ESP32 RFID Jukebox - saved player state benchmark
+
+   playerstate: NVS writes for a burst of '+' presses, for skipping
+   through tracks and for a shuffle session, with the debounced store
+   against writing every change (what changes() counts), and whether a
+   restart picks up volume, track and shuffle position again.
+*/
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "jukebox.h"
+#include "sim_bench.h"
+
+using namespace sim;
+
+namespace {
+
+struct Writes {
+  uint32_t changes;
+  uint32_t saves;
+  uint64_t entries;
+};
+
+Writes writesNow() {
+  return {playerStateStore.changes(), playerStateStore.saves(), nvsStats().entries};
+}
+
+// Write-through and debounced writes since start, as one table row each
+void printWrites(const char* label, const Writes& start) {
+  Writes now = writesNow();
+  char line[96];
+  snprintf(line, sizeof(line), "%s, every change", label);
+  printValue(line, now.changes - start.changes, "writes");
+  snprintf(line, sizeof(line), "%s, debounced", label);
+  printValue(line, now.saves - start.saves, "writes");
+}
+
+// Let pending changes reach NVS
+void settle() {
+  runFor(msToNs(PlayerStateStore::SAVE_DELAY_MS + 1000));
+}
+
+}  // namespace
+
+SIM_BENCHMARK(playerstate) {
+  bootSketch();
+  printHeader("playerstate: NVS writes of volume, track and shuffle position");
+
+  CommandReply reply;
+  runCommand({CMD_SET_VOLUME, 20}, reply, COMMAND_SERIAL);
+  settle();
+
+  // Ten '+' presses, 300 ms apart
+  Writes start = writesNow();
+  uint64_t entries = nvsStats().entries;
+  uint32_t saves = playerStateStore.saves();
+  uint64_t lastPress = 0;
+  for (int i = 0; i < 10; i++) {
+    if (i > 0) runFor(msToNs(300));
+    runCommand({CMD_VOLUME_UP, 0}, reply, COMMAND_SERIAL);
+    lastPress = nowNs();
+  }
+  while (playerStateStore.saves() == saves && nowNs() - lastPress < msToNs(20000)) {
+    runFor(msToNs(10));
+  }
+  printValue("10 x '+', saved after the last", (nowNs() - lastPress) / 1e9, "s");
+  printWrites("10 x '+'", start);
+  uint64_t entriesPerWrite = nvsStats().entries - entries;
+
+  // A shuffle session of 30 tracks, 20 s each
+  dfplayer().defaultTrackNs = msToNs(20000);
+  start = writesNow();
+  runCommand({CMD_SHUFFLE, 0}, reply, COMMAND_SERIAL);
+  runFor(msToNs(30 * 20000));
+  settle();
+  printWrites("30 shuffle tracks", start);
+
+  // Skipping: 30 x next, 250 ms apart, then a pause
+  start = writesNow();
+  for (int i = 0; i < 30; i++) {
+    runCommand({CMD_NEXT, 0}, reply, COMMAND_SERIAL);
+    runFor(msToNs(250));
+  }
+  runCommand({CMD_PLAY_PAUSE, 0}, reply, COMMAND_SERIAL);
+  settle();
+  printWrites("30 x next, pause", start);
+  runCommand({CMD_PLAY_PAUSE, 0}, reply, COMMAND_SERIAL);
+  runFor(msToNs(1000));
+
+  // Restart: save, lose the RAM state, pick it up again
+  runCommand({CMD_VOLUME_DOWN, 0}, reply, COMMAND_SERIAL);
+  runFor(msToNs(500));
+  playerStateStore.flush();
+  int volume = currentVolume;
+  int track = currentSong;
+  int index = shuffleIndex;
+  uint16_t next = shuffleOrder.upcoming(shuffleIndex);
+
+  playerScheduler.stop();
+  runFor(msToNs(300));
+  currentVolume = 30;
+  currentSong = 0;
+  isPlaying = false;
+  customShuffleMode = false;
+  shuffleIndex = 0;
+  shuffleOrder.begin(shuffleSize, 1);
+
+  uint64_t resumed = nowNs();
+  bool restored = resumePlayerState();
+  while (dfplayer().state != 1 && nowNs() - resumed < msToNs(2000)) jukeboxLoopOnce();
+  double toAudio = (dfplayer().audioStartNs - resumed) / 1e6;
+  restored = restored && currentVolume == volume && currentSong == track &&
+             customShuffleMode && shuffleIndex == index &&
+             shuffleOrder.upcoming(shuffleIndex) == next && dfplayer().track == track;
+
+  printValue("resume -> first audio", toAudio, "ms");
+  printValue("NVS entries per write", (double)entriesPerWrite, "x 32 bytes");
+  printf("  volume, track, shuffle position restored: %s\n", restored ? "yes" : "NO");
+
+  customShuffleMode = false;
+  isPlaying = false;
+  playerScheduler.stop();
+  dfplayer().defaultTrackNs = DfplayerModel().defaultTrackNs;
+  runCommand({CMD_SET_VOLUME, 30}, reply, COMMAND_SERIAL);
+  settle();
+}
@@ -0,0 +1,188 @@
+/*
+   ESP32 RFID Jukebox - tap-to-audio latency benchmark
+
+   Replays thousands of card taps and breaks the time between the card
+   entering the field and the first audio sample into the stages marked by
+   TAP_TRACE() in handleRFID() and playCardNumber().
+
+   cardformat compares the MIFARE Classic ASCII format with the NTAG
+   binary record on cold reads (card cache empty), and checks that the
+   record CRC rejects damaged and blank cards.
+*/
+
+#include <Arduino.h>
+#include <random>
+#include "jukebox.h"
+#include "sim_bench.h"
+#include "tap_trace.h"
+
+namespace {
+
+uint64_t g_stageNs[TAP_STAGE_COUNT];
+bool g_stageSeen[TAP_STAGE_COUNT];
+
+void clearTrace() {
+  for (int i = 0; i < TAP_STAGE_COUNT; i++) g_stageSeen[i] = false;
+}
+
+}  // namespace
+
+void tapTrace(TapStage stage) {
+  g_stageNs[stage] = sim::nowNs();
+  g_stageSeen[stage] = true;
+}
+
+using namespace sim;
+
+SIM_BENCHMARK(tap) {
+  const int kTaps = 5000;
+  const uint64_t kTapStepNs = usToNs(10);   // loop resolution while a track change is in flight
+  bootSketch();
+  printHeader("tap: 5000 card taps, tap -> first audio sample");
+
+  static const char* labels[] = {
+    "tap -> detect", "detect -> select", "select -> auth", "auth -> read",
+    "read -> parse", "parse -> dispatch", "dispatch -> UART command",
+  };
+  LatencyStats stages[TAP_UART + 1];
+  LatencyStats toUart;
+  LatencyStats toAudio;
+  LatencyStats uartToAudio;
+  LatencyStats blocked;
+
+  std::vector<Card> cards;
+  for (int n = 1; n <= 41; n++) cards.push_back(makeClassicCard(0xB0000000u + n, n));
+
+  // A card arrives at a random point of the previous loop iteration and is
+  // only seen by the next PICC_IsNewCardPresent()
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> phase(0.0, 1.0);
+
+  for (int i = 0; i < kTaps; i++) {
+    uint64_t iteration = timeCall(jukeboxLoopOnce);
+    clearTrace();
+    uint64_t previousAudio = dfplayer().audioStartNs;
+    uint64_t tapNs = nowNs() - (uint64_t)(phase(rng) * iteration);
+    presentCard(&cards[i % cards.size()]);
+
+    uint64_t deadline = nowNs() + msToNs(2000);
+    while (!g_stageSeen[TAP_DONE] && nowNs() < deadline) jukeboxLoopOnce();
+    while (dfplayer().audioStartNs == previousAudio && nowNs() < deadline) loopStep(kTapStepNs);
+
+    // Cards found in the card cache skip auth, read and parse
+    for (int s = TAP_AUTH; s <= TAP_PARSE; s++) {
+      if (!g_stageSeen[s] && g_stageSeen[s - 1]) {
+        g_stageNs[s] = g_stageNs[s - 1];
+        g_stageSeen[s] = true;
+      }
+    }
+
+    bool complete = true;
+    for (int s = 0; s < TAP_STAGE_COUNT; s++) complete = complete && g_stageSeen[s];
+    if (complete && dfplayer().audioStartNs != previousAudio) {
+      uint64_t previous = tapNs;
+      for (int s = TAP_DETECT; s <= TAP_UART; s++) {
+        stages[s].add(g_stageNs[s] - previous);
+        previous = g_stageNs[s];
+      }
+      uint64_t audio = dfplayer().audioStartNs;
+      toUart.add(g_stageNs[TAP_UART] - tapNs);
+      uartToAudio.add(audio - g_stageNs[TAP_UART]);
+      toAudio.add(audio - tapNs);
+      blocked.add(g_stageNs[TAP_DONE] - g_stageNs[TAP_DETECT]);
+    }
+
+    removeCard();
+    runFor(msToNs(500));
+  }
+
+  printTableHeader();
+  for (int s = TAP_DETECT; s <= TAP_UART; s++) printRow(labels[s], stages[s]);
+  printRow("UART command -> audio", uartToAudio);
+  printRow("tap -> UART command", toUart);
+  printRow("tap -> audio", toAudio);
+  printRow("loop blocked in handleRFID", blocked);
+  printValue("incomplete taps", (double)(kTaps - toAudio.count()), "");
+  printValue("card cache hit rate", cardCache.hitRate(), "%");
+}
+
+namespace {
+
+struct FormatRun {
+  LatencyStats toDispatch;
+  LatencyStats readerBusy;
+  uint64_t auths = 0;
+  int dispatched = 0;
+};
+
+// Tap each card once with the card cache empty, so every tap reads the card
+FormatRun tapCold(std::vector<Card>& cards, int taps, std::mt19937& rng) {
+  std::uniform_real_distribution<double> phase(0.0, 1.0);
+  FormatRun run;
+  uint64_t authsBefore = rfidStats().authentications;
+  for (int i = 0; i < taps; i++) {
+    cardCache.clear();
+    uint64_t iteration = timeCall(jukeboxLoopOnce);
+    clearTrace();
+    uint64_t tapNs = nowNs() - (uint64_t)(phase(rng) * iteration);
+    presentCard(&cards[i % cards.size()]);
+
+    uint64_t deadline = nowNs() + msToNs(2000);
+    while (!g_stageSeen[TAP_DISPATCH] && nowNs() < deadline) jukeboxLoopOnce();
+    if (g_stageSeen[TAP_DISPATCH] && g_stageSeen[TAP_DONE]) {
+      run.toDispatch.add(g_stageNs[TAP_DISPATCH] - tapNs);
+      run.readerBusy.add(g_stageNs[TAP_DONE] - g_stageNs[TAP_DETECT]);
+      run.dispatched++;
+    }
+    removeCard();
+    runFor(msToNs(500));
+  }
+  run.auths = rfidStats().authentications - authsBefore;
+  return run;
+}
+
+}  // namespace
+
+SIM_BENCHMARK(cardformat) {
+  const int kTaps = 500;
+  bootSketch();
+  printHeader("cardformat: 500 cold taps per card format, tap -> dispatch");
+
+  std::vector<Card> classic, ntag;
+  for (int n = 1; n <= 41; n++) {
+    classic.push_back(makeClassicCard(0xC0000000u + n, n));
+    ntag.push_back(makeNtagCard(0xD0000000u + n, n));
+  }
+
+  std::mt19937 rng(17);
+  FormatRun classicRun = tapCold(classic, kTaps, rng);
+  FormatRun ntagRun = tapCold(ntag, kTaps, rng);
+
+  printTableHeader();
+  printRow("Classic ASCII: tap -> dispatch", classicRun.toDispatch);
+  printRow("NTAG record: tap -> dispatch", ntagRun.toDispatch);
+  printRow("Classic ASCII: reader busy", classicRun.readerBusy);
+  printRow("NTAG record: reader busy", ntagRun.readerBusy);
+  printValue("Classic dispatched", classicRun.dispatched, "");
+  printValue("NTAG dispatched", ntagRun.dispatched, "");
+  printValue("Classic authentications", (double)classicRun.auths, "");
+  printValue("NTAG authentications", (double)ntagRun.auths, "");
+
+  // Every single-bit error in the record must be caught by the CRC
+  int flips = 0, rejected = 0;
+  for (int byteIndex = 0; byteIndex < CARD_RECORD_SIZE; byteIndex++) {
+    for (int bit = 0; bit < 8; bit++) {
+      Card card = makeNtagCard(0xE0000000u + flips, 5);
+      card.blocks[CARD_RECORD_PAGE / 4][byteIndex] ^= 1 << bit;
+      std::vector<Card> one = {card};
+      FormatRun run = tapCold(one, 1, rng);
+      flips++;
+      if (run.dispatched == 0) rejected++;
+    }
+  }
+  std::vector<Card> blank = {makeNtagCard(0xE1000000u, 0)};
+  FormatRun blankRun = tapCold(blank, 1, rng);
+  printValue("corrupted records rejected", rejected * 100.0 / flips, "%");
+  printValue("blank NTAG cards rejected", blankRun.dispatched == 0 ? 100.0 : 0.0, "%");
+  cardCache.clear();
+}
@@ -0,0 +1,284 @@
+/*
+   ESP32 RFID Jukebox - web command queue benchmark
+
+   The web server itself is not part of the native build, so a "request"
+   here is what its handlers do: push a command into webCommands. Compares
+   the time async_tcp used to spend executing a command with the cost of
+   queueing it, and measures how long a ticket waits for loop().
+
+   events: how soon a command result and a player state change reach the
+   /events stream, against the page's old /cmd + 500 ms + /response poll.
+
+   responses: two pages sending commands at random times and reading their
+   result 500 ms later, from the latest result (the old shared String) or
+   from the slot of their own ticket.
+
+   batch: "volume 20; h; n" as three requests against one /api/batch body,
+   and what a batch does to a nearly full queue.
+*/
+
+#include <Arduino.h>
+#include <random>
+#include "jukebox.h"
+#include "sim_bench.h"
+#include "web_batch.h"
+
+using namespace sim;
+
+// Run loop() until the given ticket has been executed
+static void waitForTicket(uint32_t ticket) {
+  uint64_t deadline = nowNs() + msToNs(5000);
+  while (webCommands.lastCompleted() < ticket && nowNs() < deadline) jukeboxLoopOnce();
+}
+
+SIM_BENCHMARK(webqueue) {
+  bootSketch();
+  printHeader("webqueue: 200 each of /play and /cmd?c=s, then 100 bursts of 24");
+
+  LatencyStats directPlay;
+  LatencyStats directStatus;
+  LatencyStats queued;
+  LatencyStats playWait;
+  LatencyStats statusWait;
+
+  CommandReply reply;
+  for (int i = 0; i < 200; i++) {
+    // What the handler used to do on async_tcp
+    uint64_t start = nowNs();
+    reply.clear();
+    runCommand({CMD_PLAY, 1 + i % 41}, reply, COMMAND_WEB);
+    directPlay.add(nowNs() - start);
+    runFor(msToNs(300));
+    start = nowNs();
+    reply.clear();
+    runCommand({CMD_STATUS, 0}, reply, COMMAND_WEB);
+    directStatus.add(nowNs() - start);
+    runFor(msToNs(50));
+  }
+
+  for (int i = 0; i < 200; i++) {
+    uint64_t start = nowNs();
+    uint32_t ticket = webCommands.push({CMD_PLAY, 1 + i % 41});
+    queued.add(nowNs() - start);
+    start = nowNs();
+    waitForTicket(ticket);
+    playWait.add(nowNs() - start);
+    runFor(msToNs(300));
+
+    ticket = webCommands.push({CMD_STATUS, 0});
+    start = nowNs();
+    waitForTicket(ticket);
+    statusWait.add(nowNs() - start);
+    runFor(msToNs(50));
+  }
+
+  // Bursts larger than the ring: the excess is rejected, not blocked on
+  uint32_t droppedBefore = webCommands.dropped();
+  for (int burst = 0; burst < 100; burst++) {
+    uint32_t last = 0;
+    for (int i = 0; i < 24; i++) {
+      uint32_t ticket = webCommands.push({CMD_VOLUME, 0});
+      if (ticket) last = ticket;
+    }
+    waitForTicket(last);
+    runFor(msToNs(20));
+  }
+
+  printTableHeader();
+  printRow("/play executed in handler", directPlay);
+  printRow("/cmd?c=s executed in handler", directStatus);
+  printRow("handler: push to queue", queued);
+  printRow("/play ticket -> executed", playWait);
+  printRow("/cmd?c=s ticket -> executed", statusWait);
+  printValue("max queue depth", (double)webCommands.maxDepth(), "");
+  printValue("dropped in bursts of 24", (double)(webCommands.dropped() - droppedBefore), "");
+}
+
+namespace {
+struct SeenEvent {
+  uint64_t ns;
+  uint32_t id;
+  bool state;
+};
+std::vector<SeenEvent> seenEvents;
+}  // namespace
+
+static void recordEvent(const char* event, const char*, uint32_t id) {
+  seenEvents.push_back({nowNs(), id, strcmp(event, "state") == 0});
+}
+
+// Run loop() until the sink has seen an event matching the test; returns
+// the time it was sent
+template <typename Match>
+static uint64_t waitForEvent(Match match) {
+  uint64_t deadline = nowNs() + msToNs(5000);
+  while (nowNs() < deadline) {
+    for (const SeenEvent& event : seenEvents) {
+      if (match(event)) return event.ns;
+    }
+    jukeboxLoopOnce();
+  }
+  return nowNs();
+}
+
+SIM_BENCHMARK(events) {
+  const uint64_t kPollDelayNs = msToNs(500);   // setTimeout() in the old page
+  bootSketch();
+  printHeader("events: /events push vs /cmd + 500 ms + /response, 200 commands");
+  playerEvents.setSink(recordEvent);
+  runFor(msToNs(200));                         // initial state for the "new client"
+
+  LatencyStats polled;
+  LatencyStats result;
+  LatencyStats playState;
+  LatencyStats buttonState;
+  for (int i = 0; i < 200; i++) {
+    seenEvents.clear();
+    uint64_t start = nowNs();
+    uint32_t ticket = webCommands.push({CMD_PLAY, 1 + i % 41});
+    result.add(waitForEvent([ticket](const SeenEvent& e) { return !e.state && e.id == ticket; }) - start);
+    playState.add(waitForEvent([](const SeenEvent& e) { return e.state; }) - start);
+    // The old page asked for /response 500 ms after /cmd answered, whatever happened
+    polled.add(kPollDelayNs);
+    runFor(msToNs(300));
+
+    seenEvents.clear();
+    start = nowNs();
+    setPin(PLAY_PAUSE_BUTTON, LOW);
+    buttonState.add(waitForEvent([](const SeenEvent& e) { return e.state; }) - start);
+    runFor(msToNs(80));
+    setPin(PLAY_PAUSE_BUTTON, HIGH);
+    runFor(msToNs(200));
+  }
+
+  // Ten volume steps within 50 ms coalesce into one or two state events
+  seenEvents.clear();
+  uint32_t coalescedBefore = playerEvents.coalesced();
+  for (int i = 0; i < 10; i++) {
+    typeSerial(i % 2 ? "+\n" : "-\n");
+    runFor(msToNs(5));
+  }
+  runFor(msToNs(300));
+  size_t volumeEvents = seenEvents.size();
+
+  printTableHeader();
+  printRow("polled: /cmd reply -> /response", polled);
+  printRow("push: /play -> result event", result);
+  printRow("push: /play -> state event", playState);
+  printRow("push: play/pause press -> state", buttonState);
+  printValue("HTTP requests per action, polled", 2, "");
+  printValue("HTTP requests per action, push", 1, "");
+  printValue("state events for 10 volume steps", (double)volumeEvents, "");
+  printValue("volume changes coalesced", (double)(playerEvents.coalesced() - coalescedBefore), "");
+  printValue("state events sent", (double)playerEvents.stateEvents(), "");
+  playerEvents.setSink(nullptr);
+}
+
+SIM_BENCHMARK(responses) {
+  bootSketch();
+  printHeader("responses: two pages, 500 commands each, read back 500 ms later");
+
+  const CommandId commands[] = {CMD_STATUS, CMD_SHUFFLE_INFO, CMD_VOLUME, CMD_VOLUME_UP, CMD_VOLUME_DOWN};
+  std::mt19937 rng(11);
+  std::uniform_int_distribution<int> gapMs(0, 700);
+  std::uniform_int_distribution<int> pick(0, sizeof(commands) / sizeof(commands[0]) - 1);
+  static char text[WebResponseRing::SLOT_SIZE + 1];
+
+  int sharedWrong = 0;
+  int ownMissing = 0;
+  uint64_t storeAllocs = 0;
+  for (int i = 0; i < 500; i++) {
+    // Page A sends, page B follows 0-700 ms later; each reads 500 ms after sending
+    CommandId commandA = commands[pick(rng)];
+    CommandId commandB = commands[pick(rng)];
+    int gap = gapMs(rng);
+    uint32_t ticketA = webCommands.push({commandA, 0});
+    uint32_t ticketB = 0;
+    uint32_t seenA = 0;
+    bool readA = false;
+    for (int ms = 0; ms <= gap + 500; ms++) {
+      if (ms == gap) ticketB = webCommands.push({commandB, 0});
+      if (ms == 500) {
+        seenA = webResponses.latest();
+        if (!webResponses.read(ticketA, text, sizeof(text))) ownMissing++;
+        readA = true;
+      }
+      runFor(msToNs(1));
+    }
+    uint32_t seenB = webResponses.latest();
+    if (readA && seenA != ticketA) sharedWrong++;
+    if (seenB != ticketB) sharedWrong++;
+    if (!webResponses.read(ticketB, text, sizeof(text))) ownMissing++;
+    runFor(msToNs(100));
+  }
+
+  // Storing a result copies into its slot, never allocating
+  std::string longest(WebResponseRing::SLOT_SIZE + 100, 'x');
+  uint64_t before = heapAllocations();
+  for (int i = 0; i < 1000; i++) {
+    webResponses.store(webCommands.accepted() + 1 + i, longest.c_str(), longest.size());
+  }
+  storeAllocs = heapAllocations() - before;
+
+  printValue("shared String: other page's result", sharedWrong / 10.0, "% of reads");
+  printValue("own slot: result not found", ownMissing / 10.0, "% of reads");
+  printValue("allocations per stored result", (double)storeAllocs / 1000, "");
+  printValue("slot memory", (double)sizeof(WebResponseRing), "bytes");
+  printValue("over-long results truncated", (double)webResponses.truncated(), "of 1000");
+}
+
+SIM_BENCHMARK(batch) {
+  bootSketch();
+  printHeader("batch: volume 20; h; n - three requests vs one batch, 200 times");
+
+  const char body[] = "volume 20\nh\nn\n";
+  WebCommand commands[WebCommandQueue::BATCH_MAX];
+  int errorLine = 0;
+  int count = parseWebBatch(body, strlen(body), commands, WebCommandQueue::BATCH_MAX, errorLine);
+
+  LatencyStats separate;
+  LatencyStats batch;
+  int batchInOnePass = 0;
+  int resultsFound = 0;
+  for (int i = 0; i < 200; i++) {
+    // One request per command, each sent when the previous one has run
+    uint64_t start = nowNs();
+    for (int c = 0; c < count; c++) {
+      waitForTicket(webCommands.push(commands[c].call));
+    }
+    separate.add(nowNs() - start);
+    runFor(msToNs(300));
+
+    // The whole batch in one request
+    start = nowNs();
+    uint32_t first = webCommands.pushBatch(commands, count);
+    waitForTicket(first + count - 1);
+    batch.add(nowNs() - start);
+    if (webBatchResults(first, count).indexOf("null") < 0) resultsFound++;
+    runFor(msToNs(300));
+
+    // A batch never waits for a second pass
+    first = webCommands.pushBatch(commands, count);
+    handleWebCommands();
+    if (webCommands.lastCompleted() == first + count - 1) batchInOnePass++;
+    runFor(msToNs(300));
+  }
+
+  // 12 commands waiting and a batch of 6: all of it is rejected
+  for (int i = 0; i < 12; i++) webCommands.push({CMD_SHUFFLE_INFO, 0});
+  WebCommand six[6];
+  for (WebCommand& c : six) c = {0, 0, {CMD_SHUFFLE_INFO, 0}};
+  uint32_t rejected = webCommands.pushBatch(six, 6);
+  uint32_t depthAfter = webCommands.depth();
+  runFor(msToNs(50));
+
+  printTableHeader();
+  printRow("3 requests: sent -> last run", separate);
+  printRow("batch: sent -> last run", batch);
+  printValue("HTTP requests, separate", 3, "");
+  printValue("HTTP requests, batch", 1, "");
+  printValue("batches run in one pass", (double)batchInOnePass, "of 200");
+  printValue("batches with every result", (double)resultsFound, "of 200");
+  printValue("batch of 6 into 12 queued: ticket", (double)rejected, "");
+  printValue("queue depth after it", (double)depthAfter, "");
+}
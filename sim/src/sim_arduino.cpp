@@ -0,0 +1,450 @@
+/*
+   ESP32 RFID Jukebox - host simulation of the Arduino core
+*/
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <new>
+#include <random>
+#include <stdlib.h>
+
+namespace {
+uint64_t g_heapAllocations = 0;
+size_t g_heapInUse = 0;
+size_t g_heapPeak = 0;
+const size_t kHeapHeader = 16;        // keeps the caller's block 16-byte aligned
+}  // namespace
+
+// Count every allocation and track bytes in use, so benchmarks can check
+// for zero-allocation paths and bounded peak heap
+void* operator new(size_t size) {
+  g_heapAllocations++;
+  uint8_t* p = (uint8_t*)malloc(size + kHeapHeader);
+  if (!p) throw std::bad_alloc();
+  *(size_t*)p = size;
+  g_heapInUse += size;
+  if (g_heapInUse > g_heapPeak) g_heapPeak = g_heapInUse;
+  return p + kHeapHeader;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept {
+  if (!p) return;
+  uint8_t* block = (uint8_t*)p - kHeapHeader;
+  g_heapInUse -= *(size_t*)block;
+  free(block);
+}
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+
+namespace sim {
+
+uint64_t heapAllocations() { return g_heapAllocations; }
+size_t heapInUse() { return g_heapInUse; }
+size_t heapPeak() { return g_heapPeak; }
+void resetHeapPeak() { g_heapPeak = g_heapInUse; }
+
+namespace {
+uint64_t g_nowNs = 0;
+uint64_t g_blockedNs = 0;
+int g_pins[40];
+bool g_pinsInit = false;
+void (*g_isr[40])() = {};
+void (*g_isrArg[40])(void*) = {};
+void* g_isrArgValue[40] = {};
+int g_isrMode[40] = {};
+uint32_t g_restarts = 0;
+std::mt19937 g_rng(1);
+
+void initPins() {
+  if (g_pinsInit) return;
+  for (int i = 0; i < 40; i++) g_pins[i] = HIGH;
+  g_pinsInit = true;
+}
+}  // namespace
+
+uint64_t nowNs() { return g_nowNs; }
+void advanceNs(uint64_t ns) { g_nowNs += ns; }
+void advanceTo(uint64_t ns) { if (ns > g_nowNs) g_nowNs = ns; }
+uint64_t blockedNs() { return g_blockedNs; }
+
+Uart& uart(int num) {
+  static Uart uarts[3];
+  return uarts[num];
+}
+
+void Uart::inject(const uint8_t* data, size_t len, uint64_t startNs) {
+  uint64_t t = std::max(startNs, rxLineFreeNs);
+  for (size_t i = 0; i < len; i++) {
+    t += byteNs();
+    rx.push_back(std::make_pair(t, data[i]));
+  }
+  rxLineFreeNs = t;
+}
+
+void Uart::inject(const std::string& text, uint64_t startNs) {
+  inject((const uint8_t*)text.data(), text.size(), startNs);
+}
+
+void setPin(uint8_t pin, int level) {
+  initPins();
+  if (pin >= 40) return;
+  int previous = g_pins[pin];
+  g_pins[pin] = level;
+  if (previous == level || (!g_isr[pin] && !g_isrArg[pin])) return;
+  int edge = level == HIGH ? RISING : FALLING;
+  if (g_isrMode[pin] != CHANGE && g_isrMode[pin] != edge) return;
+  if (g_isr[pin]) g_isr[pin]();
+  else g_isrArg[pin](g_isrArgValue[pin]);
+}
+
+void setInterrupt(uint8_t pin, void (*handler)(), int mode) {
+  if (pin >= 40) return;
+  g_isr[pin] = handler;
+  g_isrArg[pin] = nullptr;
+  g_isrMode[pin] = mode;
+}
+
+void setInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode) {
+  if (pin >= 40) return;
+  g_isr[pin] = nullptr;
+  g_isrArg[pin] = handler;
+  g_isrArgValue[pin] = arg;
+  g_isrMode[pin] = mode;
+}
+int pinLevel(uint8_t pin) { initPins(); return pin < 40 ? g_pins[pin] : LOW; }
+
+void typeSerial(const std::string& text) { uart(0).inject(text, g_nowNs); }
+uint32_t restartCount() { return g_restarts; }
+
+void seedRandom(unsigned long seed) { g_rng.seed(seed); }
+long nextRandom(long howsmall, long howbig) {
+  if (howsmall >= howbig) return howsmall;
+  std::uniform_int_distribution<long> dist(howsmall, howbig - 1);
+  return dist(g_rng);
+}
+
+void countRestart() { g_restarts++; }
+void addBlocked(uint64_t ns) { g_blockedNs += ns; }
+
+}  // namespace sim
+
+//*****************************************************************************
+// Timing, GPIO and random
+//*****************************************************************************
+unsigned long millis() { return (unsigned long)(sim::nowNs() / 1000000ULL); }
+unsigned long micros() { return (unsigned long)(sim::nowNs() / 1000ULL); }
+
+void delay(uint32_t ms) {
+  sim::advanceNs(sim::msToNs(ms));
+  sim::addBlocked(sim::msToNs(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  sim::advanceNs(sim::usToNs(us));
+  sim::addBlocked(sim::usToNs(us));
+}
+
+void yield() {}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (mode == INPUT_PULLUP) sim::setPin(pin, HIGH);
+}
+
+int digitalRead(uint8_t pin) {
+  sim::advanceNs(sim::kGpioReadNs);
+  return sim::pinLevel(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) { sim::setPin(pin, val); }
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode) { sim::setInterrupt(pin, handler, mode); }
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode) {
+  sim::setInterruptArg(pin, handler, arg, mode);
+}
+void detachInterrupt(uint8_t pin) { sim::setInterrupt(pin, nullptr, 0); }
+uint16_t analogRead(uint8_t pin) { (void)pin; return 0; }
+
+void randomSeed(unsigned long seed) { sim::seedRandom(seed); }
+long random(long howbig) { return sim::nextRandom(0, howbig); }
+long random(long howsmall, long howbig) { return sim::nextRandom(howsmall, howbig); }
+
+//*****************************************************************************
+// String
+//*****************************************************************************
+static std::string formatUnsigned(unsigned long long value, unsigned char base) {
+  if (base < 2) base = 10;
+  char buf[72];
+  char* p = buf + sizeof(buf) - 1;
+  *p = 0;
+  do {
+    unsigned digit = value % base;
+    *--p = (char)(digit < 10 ? '0' + digit : 'A' + digit - 10);
+    value /= base;
+  } while (value);
+  return p;
+}
+
+static std::string formatSigned(long long value, unsigned char base) {
+  if (value < 0 && base == 10) return "-" + formatUnsigned((unsigned long long)(-value), base);
+  return formatUnsigned((unsigned long long)value, base);
+}
+
+static std::string formatDouble(double value, unsigned char digits) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", digits, value);
+  return buf;
+}
+
+String::String(unsigned char value, unsigned char base) : s_(formatUnsigned(value, base)) {}
+String::String(int value, unsigned char base) : s_(formatSigned(value, base)) {}
+String::String(unsigned int value, unsigned char base) : s_(formatUnsigned(value, base)) {}
+String::String(long value, unsigned char base) : s_(formatSigned(value, base)) {}
+String::String(unsigned long value, unsigned char base) : s_(formatUnsigned(value, base)) {}
+String::String(float value, unsigned char decimalPlaces) : s_(formatDouble(value, decimalPlaces)) {}
+String::String(double value, unsigned char decimalPlaces) : s_(formatDouble(value, decimalPlaces)) {}
+
+bool String::equalsIgnoreCase(const String& rhs) const {
+  if (s_.size() != rhs.s_.size()) return false;
+  for (size_t i = 0; i < s_.size(); i++) {
+    if (tolower((unsigned char)s_[i]) != tolower((unsigned char)rhs.s_[i])) return false;
+  }
+  return true;
+}
+
+bool String::endsWith(const String& suffix) const {
+  return s_.size() >= suffix.s_.size() &&
+         s_.compare(s_.size() - suffix.s_.size(), suffix.s_.size(), suffix.s_) == 0;
+}
+
+void String::getBytes(unsigned char* buf, unsigned int bufsize, unsigned int index) const {
+  if (!bufsize || !buf) return;
+  if (index >= s_.size()) { buf[0] = 0; return; }
+  unsigned int n = std::min<unsigned int>(bufsize - 1, s_.size() - index);
+  memcpy(buf, s_.data() + index, n);
+  buf[n] = 0;
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+  size_t pos = s_.find(ch, fromIndex);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::indexOf(const String& str, unsigned int fromIndex) const {
+  size_t pos = s_.find(str.s_, fromIndex);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::lastIndexOf(char ch) const {
+  size_t pos = s_.rfind(ch);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int beginIndex) const {
+  return beginIndex >= s_.size() ? String() : String(s_.substr(beginIndex));
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if (beginIndex > endIndex) std::swap(beginIndex, endIndex);
+  if (beginIndex >= s_.size()) return String();
+  return String(s_.substr(beginIndex, endIndex - beginIndex));
+}
+
+void String::replace(const String& find, const String& replace) {
+  if (find.s_.empty()) return;
+  size_t pos = 0;
+  while ((pos = s_.find(find.s_, pos)) != std::string::npos) {
+    s_.replace(pos, find.s_.size(), replace.s_);
+    pos += replace.s_.size();
+  }
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index < s_.size()) s_.erase(index, count);
+}
+
+void String::toLowerCase() { for (auto& c : s_) c = (char)tolower((unsigned char)c); }
+void String::toUpperCase() { for (auto& c : s_) c = (char)toupper((unsigned char)c); }
+
+void String::trim() {
+  size_t begin = 0, end = s_.size();
+  while (begin < end && isspace((unsigned char)s_[begin])) begin++;
+  while (end > begin && isspace((unsigned char)s_[end - 1])) end--;
+  s_ = s_.substr(begin, end - begin);
+}
+
+String operator+(const String& lhs, const String& rhs) { String r(lhs); r += rhs; return r; }
+String operator+(const String& lhs, const char* rhs) { String r(lhs); r += rhs; return r; }
+String operator+(const char* lhs, const String& rhs) { String r(lhs); r += rhs; return r; }
+String operator+(const String& lhs, char rhs) { String r(lhs); r += rhs; return r; }
+String operator+(const String& lhs, int rhs) { String r(lhs); r += rhs; return r; }
+String operator+(const String& lhs, unsigned int rhs) { String r(lhs); r += rhs; return r; }
+String operator+(const String& lhs, long rhs) { String r(lhs); r += rhs; return r; }
+String operator+(const String& lhs, unsigned long rhs) { String r(lhs); r += rhs; return r; }
+
+//*****************************************************************************
+// Print / Stream
+//*****************************************************************************
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+size_t Print::printNumber(unsigned long long value, int base) {
+  return write(formatUnsigned(value, (unsigned char)base).c_str());
+}
+
+size_t Print::print(int value, int base) { return print((long long)value, base); }
+size_t Print::print(long value, int base) { return print((long long)value, base); }
+
+size_t Print::print(long long value, int base) {
+  if (base == DEC) return write(formatSigned(value, 10).c_str());
+  return printNumber((unsigned long long)(unsigned long)value, base);
+}
+
+size_t Print::print(double value, int digits) {
+  return write(formatDouble(value, (unsigned char)digits).c_str());
+}
+
+size_t Print::printf(const char* format, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (len < 0) return 0;
+  return write((const uint8_t*)buf, std::min<size_t>(len, sizeof(buf) - 1));
+}
+
+int Stream::timedRead() {
+  uint64_t deadline = sim::nowNs() + sim::msToNs(timeout_);
+  if (!waitForByte(deadline)) return -1;
+  return read();
+}
+
+size_t Stream::readBytes(uint8_t* buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = timedRead();
+    if (c < 0) break;
+    buffer[count++] = (uint8_t)c;
+  }
+  return count;
+}
+
+String Stream::readString() {
+  String ret;
+  int c;
+  while ((c = timedRead()) >= 0) ret += (char)c;
+  return ret;
+}
+
+String Stream::readStringUntil(char terminator) {
+  String ret;
+  int c;
+  while ((c = timedRead()) >= 0 && c != terminator) ret += (char)c;
+  return ret;
+}
+
+//*****************************************************************************
+// HardwareSerial
+//*****************************************************************************
+HardwareSerial Serial(0);
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin) {
+  (void)config; (void)rxPin; (void)txPin;
+  sim::uart(uartNum_).baud = baud;
+}
+
+int HardwareSerial::available() {
+  sim::Uart& u = sim::uart(uartNum_);
+  uint64_t now = sim::nowNs();
+  if (u.device) u.device->poll(now);
+  int n = 0;
+  for (const auto& entry : u.rx) {
+    if (entry.first > now) break;
+    n++;
+  }
+  return n;
+}
+
+int HardwareSerial::read() {
+  if (!available()) return -1;
+  sim::Uart& u = sim::uart(uartNum_);
+  uint8_t c = u.rx.front().second;
+  u.rx.pop_front();
+  u.rxBytes++;
+  return c;
+}
+
+int HardwareSerial::peek() {
+  if (!available()) return -1;
+  return sim::uart(uartNum_).rx.front().second;
+}
+
+bool HardwareSerial::waitForByte(uint64_t deadlineNs) {
+  sim::Uart& u = sim::uart(uartNum_);
+  while (!available()) {
+    // Jump straight to the next arrival, or give up at the deadline
+    uint64_t next = deadlineNs;
+    if (!u.rx.empty() && u.rx.front().first < next) next = u.rx.front().first;
+    if (sim::nowNs() >= deadlineNs) return false;
+    if (u.device && next > sim::nowNs() + sim::msToNs(1)) next = sim::nowNs() + sim::msToNs(1);
+    sim::advanceTo(next);
+  }
+  return true;
+}
+
+void HardwareSerial::flush() {
+  sim::advanceTo(sim::uart(uartNum_).txLineFreeNs);
+}
+
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+
+int HardwareSerial::availableForWrite() {
+  sim::Uart& u = sim::uart(uartNum_);
+  uint64_t now = sim::nowNs();
+  if (u.txLineFreeNs <= now) return u.txFifoSize;
+  uint64_t queued = (u.txLineFreeNs - now + u.byteNs() - 1) / u.byteNs();
+  return queued >= u.txFifoSize ? 0 : u.txFifoSize - queued;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  sim::Uart& u = sim::uart(uartNum_);
+  uint64_t byteNs = u.byteNs();
+  for (size_t i = 0; i < size; i++) {
+    uint64_t now = sim::nowNs();
+    if (u.txLineFreeNs < now) u.txLineFreeNs = now;
+    // Block while the FIFO already holds txFifoSize bytes
+    if (u.txLineFreeNs > now + byteNs * u.txFifoSize) {
+      uint64_t fifoDrainedNs = u.txLineFreeNs - byteNs * u.txFifoSize;
+      u.txBlockedNs += fifoDrainedNs - now;
+      sim::advanceTo(fifoDrainedNs);
+    }
+    u.txLineFreeNs += byteNs;
+    u.txBytes++;
+    if (u.device) {
+      u.device->onByte(buffer[i], u.txLineFreeNs);
+    } else if (u.echo) {
+      fputc(buffer[i], stdout);
+    }
+    if (!u.device) {
+      // Reserved once so the capture never shows up in allocation counts
+      if (u.captured.capacity() < 8193) u.captured.reserve(8193);
+      u.captured += (char)buffer[i];
+      if (u.captured.size() > 8192) u.captured.erase(0, 4096);
+    }
+  }
+  return size;
+}
+
+//*****************************************************************************
+// ESP
+//*****************************************************************************
+EspClass ESP;
+
+void EspClass::restart() { sim::countRestart(); }
+uint32_t EspClass::getFreeHeap() { return 200000; }
+uint32_t EspClass::getCycleCount() { return (uint32_t)(sim::nowNs() * 240ULL / 1000ULL); }
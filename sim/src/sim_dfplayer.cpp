@@ -0,0 +1,374 @@
+/*
+   ESP32 RFID Jukebox - simulated DFPlayer Mini
+
+   Two halves: the DFRobotDFPlayerMini library as the sketch sees it, and a
+   model of the module itself sitting on UART2. The module decodes frames,
+   keeps track position on the virtual clock, answers queries and ACKs, and
+   sends the unsolicited 0x3D "track finished" frame (twice, like the real
+   hardware does) when a track runs out.
+*/
+
+#include <DFRobotDFPlayerMini.h>
+#include <map>
+
+namespace sim {
+
+namespace {
+
+const int kDfplayerUart = 2;
+
+void buildFrame(uint8_t* frame, uint8_t command, uint16_t parameter, bool ack) {
+  frame[0] = 0x7E;
+  frame[1] = 0xFF;
+  frame[2] = 0x06;
+  frame[3] = command;
+  frame[4] = ack ? 1 : 0;
+  frame[5] = (uint8_t)(parameter >> 8);
+  frame[6] = (uint8_t)parameter;
+  uint16_t sum = 0;
+  for (int i = 1; i < 7; i++) sum += frame[i];
+  uint16_t checksum = (uint16_t)(0 - sum);
+  frame[7] = (uint8_t)(checksum >> 8);
+  frame[8] = (uint8_t)checksum;
+  frame[9] = 0xEF;
+}
+
+DfplayerModel g_model;
+
+class DfplayerDevice : public UartDevice {
+ public:
+  DfplayerDevice() { uart(kDfplayerUart).device = this; }
+
+  void onByte(uint8_t c, uint64_t arrivalNs) override {
+    if (index_ == 0 && c != 0x7E) return;
+    frame_[index_++] = c;
+    if (index_ < DFPLAYER_RECEIVED_LENGTH) return;
+    index_ = 0;
+    if (frame_[9] != 0xEF) return;
+    uint16_t sum = 0;
+    for (int i = 1; i < 7; i++) sum += frame_[i];
+    uint16_t checksum = (uint16_t)((frame_[7] << 8) | frame_[8]);
+    if ((uint16_t)(sum + checksum) != 0) return;
+
+    Pending p;
+    p.command = frame_[3];
+    p.ack = frame_[4] != 0;
+    p.parameter = (uint16_t)((frame_[5] << 8) | frame_[6]);
+    p.arrivalNs = arrivalNs;
+    pending_.insert(std::make_pair(arrivalNs + kDfplayerProcessNs, p));
+    g_model.received.push_back(DfplayerFrame{arrivalNs, p.command, p.parameter});
+  }
+
+  void poll(uint64_t nowNs) override {
+    DfplayerModel& m = g_model;
+    while (true) {
+      uint64_t nextCommand = pending_.empty() ? UINT64_MAX : pending_.begin()->first;
+      uint64_t nextEnd = m.state == 1 ? m.trackEndNs : UINT64_MAX;
+      uint64_t next = std::min(nextCommand, nextEnd);
+      if (next > nowNs) break;
+      if (nextEnd <= nextCommand) {
+        finishTrack(nextEnd);
+      } else {
+        Pending p = pending_.begin()->second;
+        pending_.erase(pending_.begin());
+        execute(p, nextCommand);
+      }
+    }
+  }
+
+  void reset() {
+    pending_.clear();
+    index_ = 0;
+  }
+
+ private:
+  struct Pending {
+    uint8_t command;
+    bool ack;
+    uint16_t parameter;
+    uint64_t arrivalNs;
+  };
+
+  void send(uint8_t command, uint16_t parameter, uint64_t atNs) {
+    uint8_t frame[DFPLAYER_SEND_LENGTH];
+    buildFrame(frame, command, parameter, false);
+    uart(kDfplayerUart).inject(frame, sizeof(frame), atNs);
+  }
+
+  void startTrack(uint16_t track, const Pending& p) {
+    DfplayerModel& m = g_model;
+    if (track < 1 || track > m.trackCount) {
+      send(0x40, FileIndexOut, p.arrivalNs + kDfplayerProcessNs);
+      return;
+    }
+    m.track = track;
+    m.state = 1;
+    m.audioStartNs = p.arrivalNs + kDfplayerAudioNs;
+    m.trackEndNs = m.audioStartNs + trackDurationNs(track);
+  }
+
+  void finishTrack(uint64_t atNs) {
+    DfplayerModel& m = g_model;
+    m.state = 0;
+    send(0x3D, m.track, atNs);
+    if (m.doubleFinish) send(0x3D, m.track, atNs);
+  }
+
+  void execute(const Pending& p, uint64_t atNs) {
+    DfplayerModel& m = g_model;
+    if (p.ack) send(0x41, 0, atNs);
+    switch (p.command) {
+      case 0x01: startTrack(m.track >= m.trackCount ? 1 : m.track + 1, p); break;
+      case 0x02: startTrack(m.track <= 1 ? m.trackCount : m.track - 1, p); break;
+      case 0x03: startTrack(p.parameter, p); break;
+      case 0x06: m.volume = (uint8_t)std::min<uint16_t>(p.parameter, 30); break;
+      case 0x0C:
+        m.state = 0;
+        send(0x3F, 0x02, atNs + msToNs(1500));   // SD card online
+        break;
+      case 0x0D:
+        if (m.state == 2) {
+          m.state = 1;
+          m.trackEndNs = atNs + m.remainingNs;
+        } else if (m.state == 0 && m.track > 0) {
+          startTrack(m.track, p);
+        }
+        break;
+      case 0x0E:
+        if (m.state == 1) {
+          m.state = 2;
+          m.remainingNs = m.trackEndNs > atNs ? m.trackEndNs - atNs : 0;
+        }
+        break;
+      case 0x0F: startTrack(p.parameter & 0xFF, p); break;
+      case 0x12: startTrack(p.parameter, p); break;
+      case 0x14: startTrack(p.parameter & 0x0FFF, p); break;
+      case 0x16: m.state = 0; break;
+      case 0x42: send(0x42, 0x0200 | m.state, atNs); break;
+      case 0x43: send(0x43, m.volume, atNs); break;
+      case 0x48: send(0x48, m.trackCount, atNs); break;
+      case 0x4C: send(0x4C, m.track, atNs); break;
+      default: break;
+    }
+  }
+
+  uint8_t frame_[DFPLAYER_RECEIVED_LENGTH];
+  uint8_t index_ = 0;
+  std::multimap<uint64_t, Pending> pending_;
+};
+
+DfplayerDevice g_device;
+
+}  // namespace
+
+DfplayerModel& dfplayer() {
+  g_device.poll(nowNs());
+  return g_model;
+}
+
+uint64_t trackDurationNs(uint16_t track) {
+  if (track < g_model.trackNs.size() && g_model.trackNs[track]) return g_model.trackNs[track];
+  return g_model.defaultTrackNs;
+}
+
+void resetHardware() {
+  g_device.reset();
+  uint16_t trackCount = g_model.trackCount;
+  uint64_t defaultTrackNs = g_model.defaultTrackNs;
+  std::vector<uint64_t> trackNs = g_model.trackNs;
+  g_model = DfplayerModel();
+  g_model.trackCount = trackCount;
+  g_model.defaultTrackNs = defaultTrackNs;
+  g_model.trackNs = trackNs;
+  for (int i = 0; i < 3; i++) {
+    Uart& u = uart(i);
+    u.rx.clear();
+    u.txLineFreeNs = u.rxLineFreeNs = nowNs();
+  }
+  removeCard();
+  for (uint8_t pin = 0; pin < 40; pin++) setPin(pin, 1);
+}
+
+}  // namespace sim
+
+//*****************************************************************************
+// DFRobotDFPlayerMini
+//*****************************************************************************
+bool DFRobotDFPlayerMini::begin(Stream& stream, bool isACK, bool doReset) {
+  _serial = &stream;
+  _sending[Stack_ACK] = isACK ? 0x01 : 0x00;
+  if (doReset) {
+    reset();
+    waitAvailable(2000);
+    delay(200);
+  } else {
+    _handleType = DFPlayerCardOnline;
+  }
+  return (readType() == DFPlayerCardOnline) || (readType() == DFPlayerUSBOnline) || !isACK;
+}
+
+void DFRobotDFPlayerMini::sendStack() {
+  if (_sending[Stack_ACK]) {
+    // Wait until the previous command has been acknowledged
+    while (_isSending) {
+      waitForBytes(_timeOutTimer, _timeOutDuration);
+      available();
+    }
+  }
+  _serial->write(_sending, DFPLAYER_SEND_LENGTH);
+  _timeOutTimer = millis();
+  _isSending = _sending[Stack_ACK];
+  if (!_sending[Stack_ACK]) {
+    delay(10);
+  }
+}
+
+void DFRobotDFPlayerMini::sendStack(uint8_t command, uint16_t argument) {
+  _sending[Stack_Command] = command;
+  _sending[Stack_Parameter] = (uint8_t)(argument >> 8);
+  _sending[Stack_Parameter + 1] = (uint8_t)argument;
+  uint16_t sum = 0;
+  for (int i = Stack_Version; i < Stack_CheckSum; i++) sum += _sending[i];
+  uint16_t checksum = (uint16_t)(0 - sum);
+  _sending[Stack_CheckSum] = (uint8_t)(checksum >> 8);
+  _sending[Stack_CheckSum + 1] = (uint8_t)checksum;
+  sendStack();
+}
+
+void DFRobotDFPlayerMini::sendStack(uint8_t command, uint8_t argumentHigh, uint8_t argumentLow) {
+  sendStack(command, (uint16_t)((argumentHigh << 8) | argumentLow));
+}
+
+int DFRobotDFPlayerMini::query(uint8_t command) {
+  sendStack(command);
+  if (waitAvailable()) {
+    if (readType() == DFPlayerFeedBack) return read();
+    return -1;
+  }
+  return -1;
+}
+
+void DFRobotDFPlayerMini::waitForBytes(unsigned long startMillis, unsigned long duration) {
+  // The library spins on available(); in virtual time we jump to the next byte
+  uint64_t deadline = sim::msToNs(startMillis + duration) + sim::msToNs(1);
+  _serial->waitForByteUntil(deadline);
+}
+
+bool DFRobotDFPlayerMini::waitAvailable(unsigned long duration) {
+  unsigned long timer = millis();
+  if (!duration) duration = _timeOutDuration;
+  while (!available()) {
+    if (millis() - timer > duration) return handleError(TimeOut);
+    waitForBytes(timer, duration);
+  }
+  return true;
+}
+
+bool DFRobotDFPlayerMini::available() {
+  while (_serial->available()) {
+    if (_receivedIndex == 0) {
+      _received[Stack_Header] = (uint8_t)_serial->read();
+      if (_received[Stack_Header] == 0x7E) _receivedIndex++;
+    } else {
+      _received[_receivedIndex] = (uint8_t)_serial->read();
+      switch (_receivedIndex) {
+        case Stack_Version:
+          if (_received[_receivedIndex] != 0xFF) return handleError(WrongStack);
+          break;
+        case Stack_Length:
+          if (_received[_receivedIndex] != 0x06) return handleError(WrongStack);
+          break;
+        case Stack_End:
+          if (_received[_receivedIndex] != 0xEF) return handleError(WrongStack);
+          if (!validateStack()) return handleError(WrongStack);
+          _receivedIndex = 0;
+          parseStack();
+          return _isAvailable;
+        default:
+          break;
+      }
+      _receivedIndex++;
+    }
+  }
+  if (_isSending && (millis() - _timeOutTimer >= _timeOutDuration)) return handleError(TimeOut);
+  return _isAvailable;
+}
+
+uint8_t DFRobotDFPlayerMini::readType() {
+  _isAvailable = false;
+  return _handleType;
+}
+
+uint16_t DFRobotDFPlayerMini::read() {
+  _isAvailable = false;
+  return _handleParameter;
+}
+
+bool DFRobotDFPlayerMini::handleMessage(uint8_t type, uint16_t parameter) {
+  _receivedIndex = 0;
+  _handleType = type;
+  _handleParameter = parameter;
+  _isAvailable = true;
+  return _isAvailable;
+}
+
+bool DFRobotDFPlayerMini::handleError(uint8_t type, uint16_t parameter) {
+  handleMessage(type, parameter);
+  _isSending = false;
+  return false;
+}
+
+bool DFRobotDFPlayerMini::validateStack() {
+  uint16_t sum = 0;
+  for (int i = Stack_Version; i < Stack_CheckSum; i++) sum += _received[i];
+  uint16_t checksum = (uint16_t)((_received[Stack_CheckSum] << 8) | _received[Stack_CheckSum + 1]);
+  return (uint16_t)(sum + checksum) == 0;
+}
+
+void DFRobotDFPlayerMini::parseStack() {
+  uint8_t handleCommand = _received[Stack_Command];
+  if (handleCommand == 0x41) {
+    _isSending = false;
+    return;
+  }
+  _handleCommand = handleCommand;
+  _handleParameter = (uint16_t)((_received[Stack_Parameter] << 8) | _received[Stack_Parameter + 1]);
+
+  switch (_handleCommand) {
+    case 0x3D: handleMessage(DFPlayerPlayFinished, _handleParameter); break;
+    case 0x3F:
+      if (_handleParameter & 0x01) handleMessage(DFPlayerUSBOnline, _handleParameter);
+      else if (_handleParameter & 0x02) handleMessage(DFPlayerCardOnline, _handleParameter);
+      else if (_handleParameter & 0x03) handleMessage(DFPlayerCardUSBOnline, _handleParameter);
+      break;
+    case 0x3A:
+      if (_handleParameter & 0x01) handleMessage(DFPlayerUSBInserted, _handleParameter);
+      else if (_handleParameter & 0x02) handleMessage(DFPlayerCardInserted, _handleParameter);
+      break;
+    case 0x3B:
+      if (_handleParameter & 0x01) handleMessage(DFPlayerUSBRemoved, _handleParameter);
+      else if (_handleParameter & 0x02) handleMessage(DFPlayerCardRemoved, _handleParameter);
+      break;
+    case 0x40: handleMessage(DFPlayerError, _handleParameter); break;
+    case 0x3C:
+    case 0x3E:
+    case 0x42:
+    case 0x43:
+    case 0x44:
+    case 0x45:
+    case 0x46:
+    case 0x47:
+    case 0x48:
+    case 0x49:
+    case 0x4B:
+    case 0x4C:
+    case 0x4D:
+    case 0x4E:
+    case 0x4F:
+      handleMessage(DFPlayerFeedBack, _handleParameter);
+      break;
+    default:
+      handleError(WrongStack);
+      break;
+  }
+}
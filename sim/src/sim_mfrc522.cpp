@@ -0,0 +1,283 @@
+/*
+   ESP32 RFID Jukebox - simulated RC522 reader and MIFARE cards
+*/
+
+#include <MFRC522.h>
+#include <random>
+#include "card_record.h"
+
+namespace sim {
+
+namespace {
+Card* g_card = nullptr;
+uint8_t g_irqPin = 255;
+RfidStats g_rfidStats;
+double g_authFailRate = 0.0;
+double g_readFailRate = 0.0;
+double g_writeFaultRate = 0.0;
+std::mt19937 g_faultRng(7);
+
+bool injectFault(double rate) {
+  if (rate <= 0.0) return false;
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  return dist(g_faultRng) < rate;
+}
+
+void spi(uint64_t ns, uint64_t transactions) {
+  advanceNs(ns);
+  g_rfidStats.spiTransactions += transactions;
+}
+
+bool isUltralight(const Card* card) { return card->sak == 0x00; }
+
+uint8_t* page(Card* card, uint8_t number) {
+  return &card->blocks[(number / 4) % 64][(number % 4) * 4];
+}
+}  // namespace
+
+Card makeClassicCard(uint32_t uidValue, long number) {
+  Card card;
+  card.uid = {(uint8_t)(uidValue >> 24), (uint8_t)(uidValue >> 16),
+              (uint8_t)(uidValue >> 8), (uint8_t)uidValue};
+  card.sak = 0x08;
+  char text[17];
+  int len = snprintf(text, sizeof(text), "%ld", number);
+  for (int i = 0; i < 16; i++) card.blocks[1][i] = i < len ? (uint8_t)text[i] : ' ';
+  return card;
+}
+
+Card makeNtagCard(uint32_t uidValue, long number) {
+  Card card;
+  card.uid = {0x04, (uint8_t)(uidValue >> 24), (uint8_t)(uidValue >> 16),
+              (uint8_t)(uidValue >> 8), (uint8_t)uidValue, 0x5C, 0x80};
+  card.sak = 0x00;
+  CardRecord record;
+  if (cardRecordFromNumber((int)number, record)) {
+    byte data[CARD_RECORD_SIZE];
+    encodeCardRecord(record, data);
+    memcpy(page(&card, CARD_RECORD_PAGE), data, 4);
+    memcpy(page(&card, CARD_RECORD_PAGE + 1), data + 4, 4);
+  }
+  return card;
+}
+
+void presentCard(Card* card) {
+  g_card = card;
+  if (g_card) g_card->halted = false;
+}
+
+void removeCard() { g_card = nullptr; }
+Card* cardInField() { return g_card; }
+RfidStats& rfidStats() { return g_rfidStats; }
+void wireRfidIrq(uint8_t pin) { g_irqPin = pin; }
+uint8_t rfidIrqPin() { return g_irqPin; }
+
+void setRfidFailureRate(double authFail, double readFail) {
+  g_authFailRate = authFail;
+  g_readFailRate = readFail;
+}
+
+void setRfidWriteFaultRate(double torn) { g_writeFaultRate = torn; }
+
+void chargeSpi(uint64_t ns, uint64_t transactions) { spi(ns, transactions); }
+
+}  // namespace sim
+
+//*****************************************************************************
+// MFRC522
+//*****************************************************************************
+MFRC522::MFRC522(byte chipSelectPin, byte resetPowerDownPin) {
+  (void)chipSelectPin;
+  (void)resetPowerDownPin;
+  memset(&uid, 0, sizeof(uid));
+}
+
+void MFRC522::PCD_Init() {
+  sim::chargeSpi(50 * sim::kRfidRegisterNs, 50);
+  comIEn_ = 0x80;
+  comIrq_ = 0;
+  command_ = PCD_Idle;
+  updateIrqLine();
+}
+void MFRC522::PCD_SetAntennaGain(byte mask) { (void)mask; sim::chargeSpi(2 * sim::kRfidRegisterNs, 2); }
+
+void MFRC522::PCD_WriteRegister(PCD_Register reg, byte value) {
+  sim::chargeSpi(sim::kRfidRegisterNs, 1);
+  switch (reg) {
+    case ComIEnReg:
+      comIEn_ = value;
+      break;
+    case ComIrqReg:
+      // Set1 (bit 7) sets the marked bits, otherwise they are cleared
+      if (value & 0x80) comIrq_ |= value & 0x7F;
+      else comIrq_ &= ~value;
+      break;
+    case FIFODataReg:
+      fifoByte_ = value;
+      break;
+    case CommandReg:
+      command_ = value & 0x0F;
+      break;
+    case BitFramingReg:
+      // StartSend of a REQA: a card in the field (not halted) answers ATQA
+      if ((value & 0x80) && command_ == PCD_Transceive && fifoByte_ == PICC_CMD_REQA) {
+        comIrq_ |= 0x40;                             // TxIRq
+        sim::Card* card = sim::cardInField();
+        if (card && !card->halted) comIrq_ |= 0x20;  // RxIRq
+      }
+      break;
+    default:
+      break;
+  }
+  updateIrqLine();
+}
+
+byte MFRC522::PCD_ReadRegister(PCD_Register reg) {
+  sim::chargeSpi(sim::kRfidRegisterNs, 1);
+  if (reg == VersionReg) return 0x92;
+  if (reg == ComIEnReg) return comIEn_;
+  if (reg == ComIrqReg) return comIrq_;
+  return 0;
+}
+
+void MFRC522::updateIrqLine() {
+  uint8_t pin = sim::rfidIrqPin();
+  if (pin == 255) return;
+  bool asserted = (comIrq_ & comIEn_ & 0x7F) != 0;
+  bool inverted = comIEn_ & 0x80;
+  sim::setPin(pin, asserted != inverted ? HIGH : LOW);
+}
+
+bool MFRC522::PICC_IsNewCardPresent() {
+  sim::rfidStats().polls++;
+  sim::Card* card = sim::cardInField();
+  if (!card || card->halted) {
+    sim::chargeSpi(sim::kRfidPollNoCardNs, 12);
+    return false;
+  }
+  sim::chargeSpi(sim::kRfidPollCardNs, 10);
+  return true;
+}
+
+bool MFRC522::PICC_ReadCardSerial() {
+  sim::Card* card = sim::cardInField();
+  sim::chargeSpi(sim::kRfidSelectNs, 30);
+  if (!card || card->halted) return false;
+  if (card->uid.size() > 4) sim::chargeSpi(sim::kRfidCascadeNs, 15);
+  uid.size = (byte)card->uid.size();
+  memcpy(uid.uidByte, card->uid.data(), uid.size);
+  uid.sak = card->sak;
+  selected_ = true;
+  authSector_ = -1;
+  return true;
+}
+
+MFRC522::StatusCode MFRC522::PICC_HaltA() {
+  sim::chargeSpi(sim::kRfidHaltNs, 10);
+  sim::Card* card = sim::cardInField();
+  if (card) card->halted = true;
+  selected_ = false;
+  return STATUS_OK;
+}
+
+void MFRC522::PCD_StopCrypto1() {
+  sim::chargeSpi(sim::kRfidRegisterNs, 1);
+  authSector_ = -1;
+}
+
+MFRC522::StatusCode MFRC522::PCD_Authenticate(byte command, byte blockAddr, MIFARE_Key* key, Uid* uidArg) {
+  (void)command; (void)uidArg;
+  sim::rfidStats().authentications++;
+  sim::chargeSpi(sim::kRfidAuthNs, 40);
+  sim::Card* card = sim::cardInField();
+  if (!card || !selected_) return STATUS_TIMEOUT;
+  for (int i = 0; i < 6; i++) {
+    if (key->keyByte[i] != 0xFF) return STATUS_TIMEOUT;
+  }
+  if (sim::injectFault(sim::g_authFailRate)) return STATUS_TIMEOUT;
+  authSector_ = blockAddr / 4;
+  return STATUS_OK;
+}
+
+MFRC522::StatusCode MFRC522::MIFARE_Read(byte blockAddr, byte* buffer, byte* bufferSize) {
+  sim::rfidStats().reads++;
+  sim::chargeSpi(sim::kRfidReadNs, 30);
+  if (!buffer || !bufferSize || *bufferSize < 18) return STATUS_NO_ROOM;
+  sim::Card* card = sim::cardInField();
+  if (!card || !selected_) return STATUS_TIMEOUT;
+  if (sim::injectFault(sim::g_readFailRate)) return STATUS_CRC_WRONG;
+  if (sim::isUltralight(card)) {
+    // READ: four pages from blockAddr, no authentication
+    for (int i = 0; i < 4; i++) memcpy(buffer + i * 4, sim::page(card, blockAddr + i), 4);
+    buffer[16] = buffer[17] = 0;
+    *bufferSize = 18;
+    return STATUS_OK;
+  }
+  if (authSector_ != blockAddr / 4) return STATUS_TIMEOUT;
+  memcpy(buffer, card->blocks[blockAddr % 64], 16);
+  buffer[16] = buffer[17] = 0;   // CRC_A bytes
+  *bufferSize = 18;
+  return STATUS_OK;
+}
+
+MFRC522::StatusCode MFRC522::MIFARE_Write(byte blockAddr, byte* buffer, byte bufferSize) {
+  sim::rfidStats().writes++;
+  sim::chargeSpi(sim::kRfidWriteNs, 60);
+  if (!buffer || bufferSize < 16) return STATUS_INVALID;
+  sim::Card* card = sim::cardInField();
+  if (!card || !selected_) return STATUS_TIMEOUT;
+  if (authSector_ != blockAddr / 4) return STATUS_TIMEOUT;
+  memcpy(card->blocks[blockAddr % 64], buffer, 16);
+  if (sim::injectFault(sim::g_writeFaultRate)) card->blocks[blockAddr % 64][0] ^= 0x01;
+  return STATUS_OK;
+}
+
+MFRC522::StatusCode MFRC522::MIFARE_Ultralight_Write(byte page, byte* buffer, byte bufferSize) {
+  sim::rfidStats().writes++;
+  sim::chargeSpi(sim::kRfidPageWriteNs, 30);
+  if (!buffer || bufferSize < 4) return STATUS_INVALID;
+  sim::Card* card = sim::cardInField();
+  if (!card || !selected_) return STATUS_TIMEOUT;
+  if (!sim::isUltralight(card)) return STATUS_MIFARE_NACK;
+  if (page < 4) return STATUS_MIFARE_NACK;          // UID, lock and CC pages
+  memcpy(sim::page(card, page), buffer, 4);
+  if (sim::injectFault(sim::g_writeFaultRate)) sim::page(card, page)[0] ^= 0x01;
+  return STATUS_OK;
+}
+
+MFRC522::PICC_Type MFRC522::PICC_GetType(byte sak) {
+  switch (sak & 0x7F) {
+    case 0x00: return PICC_TYPE_MIFARE_UL;
+    case 0x08: return PICC_TYPE_MIFARE_1K;
+    case 0x09: return PICC_TYPE_MIFARE_MINI;
+    case 0x18: return PICC_TYPE_MIFARE_4K;
+    case 0x20: return PICC_TYPE_ISO_14443_4;
+    default: return PICC_TYPE_UNKNOWN;
+  }
+}
+
+const char* MFRC522::PICC_GetTypeName(PICC_Type type) {
+  switch (type) {
+    case PICC_TYPE_MIFARE_UL: return "MIFARE Ultralight or Ultralight C";
+    case PICC_TYPE_MIFARE_1K: return "MIFARE 1KB";
+    case PICC_TYPE_MIFARE_MINI: return "MIFARE Mini, 320 bytes";
+    case PICC_TYPE_MIFARE_4K: return "MIFARE 4KB";
+    case PICC_TYPE_ISO_14443_4: return "PICC compliant with ISO/IEC 14443-4";
+    default: return "Unknown type";
+  }
+}
+
+const char* MFRC522::GetStatusCodeName(StatusCode code) {
+  switch (code) {
+    case STATUS_OK: return "Success.";
+    case STATUS_ERROR: return "Error in communication.";
+    case STATUS_COLLISION: return "Collission detected.";
+    case STATUS_TIMEOUT: return "Timeout in communication.";
+    case STATUS_NO_ROOM: return "A buffer is not big enough.";
+    case STATUS_INTERNAL_ERROR: return "Internal error in the code. Should not happen.";
+    case STATUS_INVALID: return "Invalid argument.";
+    case STATUS_CRC_WRONG: return "The CRC_A does not match.";
+    case STATUS_MIFARE_NACK: return "A MIFARE PICC responded with NAK.";
+    default: return "Unknown error";
+  }
+}
@@ -0,0 +1,205 @@
+/*
+   ESP32 RFID Jukebox - simulated SPI bus, WiFi station, SPIFFS and NVS
+*/
+
+#include <SPI.h>
+#include <WiFi.h>
+#include <SPIFFS.h>
+#include <Preferences.h>
+#include <map>
+#include "jukebox.h"
+
+SPIClass SPI;
+WiFiClass WiFi;
+SPIFFSFS SPIFFS;
+
+//*****************************************************************************
+// WiFi
+//*****************************************************************************
+String IPAddress::toString() const {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u", octets_[0], octets_[1], octets_[2], octets_[3]);
+  return String(buf);
+}
+
+bool WiFiClass::config(IPAddress, IPAddress, IPAddress, IPAddress, IPAddress) { return true; }
+bool WiFiClass::mode(wifi_mode_t) { return true; }
+wl_status_t WiFiClass::begin(const char*, const char*) { return WL_DISCONNECTED; }
+wl_status_t WiFiClass::status() { return WL_DISCONNECTED; }
+IPAddress WiFiClass::localIP() { return IPAddress(); }
+
+// web_server.cpp is not part of the native build
+void setupWebServer() {}
+
+//*****************************************************************************
+// SPIFFS
+//*****************************************************************************
+namespace sim {
+FlashStats& flashStats() {
+  static FlashStats stats;
+  return stats;
+}
+}  // namespace sim
+
+namespace fs {
+
+int File::available() {
+  if (!data_) return 0;
+  return pos_ < data_->size() ? (int)(data_->size() - pos_) : 0;
+}
+
+int File::read() {
+  if (!available()) return -1;
+  sim::advanceNs(sim::kFlashReadOpNs + sim::kFlashReadByteNs);
+  sim::flashStats().bytesRead++;
+  return (*data_)[pos_++];
+}
+
+int File::peek() {
+  if (!available()) return -1;
+  return (*data_)[pos_];
+}
+
+size_t File::read(uint8_t* buf, size_t size) {
+  size_t n = std::min<size_t>(size, available());
+  sim::advanceNs(sim::kFlashReadOpNs + n * sim::kFlashReadByteNs);
+  if (n) memcpy(buf, data_->data() + pos_, n);
+  pos_ += n;
+  sim::flashStats().bytesRead += n;
+  return n;
+}
+
+size_t File::write(const uint8_t* buf, size_t size) {
+  if (!data_ || !writable_) return 0;
+  if (pos_ + size > data_->size()) data_->resize(pos_ + size);
+  memcpy(data_->data() + pos_, buf, size);
+  sim::advanceNs(size * sim::kFlashWriteByteNs);
+  pos_ += size;
+  sim::flashStats().bytesWritten += size;
+  return size;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!data_) return false;
+  size_t target = pos;
+  if (mode == SeekCur) target = pos_ + pos;
+  else if (mode == SeekEnd) target = data_->size() + pos;
+  if (target > data_->size()) return false;
+  sim::advanceNs(sim::kFlashSeekNs);
+  pos_ = target;
+  return true;
+}
+
+File FS::open(const char* path, const char* mode) {
+  sim::flashStats().opens++;
+  sim::advanceNs(sim::kFlashOpenNs);
+  bool write = mode[0] == 'w' || mode[0] == 'a';
+  auto it = files_.find(path);
+  if (it == files_.end()) {
+    if (!write) return File();
+    it = files_.insert(std::make_pair(std::string(path), std::make_shared<std::vector<uint8_t>>())).first;
+  }
+  if (mode[0] == 'w') it->second->clear();
+  File file(path, it->second, write || mode[1] == '+');
+  if (mode[0] == 'a') file.seek(0, SeekEnd);
+  return file;
+}
+
+bool FS::rename(const char* from, const char* to) {
+  auto it = files_.find(from);
+  if (it == files_.end()) return false;
+  FileData data = it->second;
+  files_.erase(it);
+  files_[to] = data;
+  return true;
+}
+
+}  // namespace fs
+
+bool SPIFFSFS::begin(bool formatOnFail, const char*, uint8_t, const char*) {
+  (void)formatOnFail;
+  return true;
+}
+
+size_t SPIFFSFS::usedBytes() {
+  size_t used = 0;
+  for (const auto& file : files_) used += file.second->size();
+  return used;
+}
+
+//*****************************************************************************
+// NVS (Preferences)
+//*****************************************************************************
+namespace sim {
+NvsStats& nvsStats() {
+  static NvsStats stats;
+  return stats;
+}
+
+static std::map<std::string, std::vector<uint8_t>>& nvsKeys() {
+  static std::map<std::string, std::vector<uint8_t>> keys;
+  return keys;
+}
+
+void clearNvs() { nvsKeys().clear(); }
+}  // namespace sim
+
+bool Preferences::begin(const char* name, bool readOnly, const char*) {
+  namespace_ = name;
+  readOnly_ = readOnly;
+  open_ = true;
+  return true;
+}
+
+bool Preferences::clear() {
+  if (!open_ || readOnly_) return false;
+  auto& keys = sim::nvsKeys();
+  std::string prefix = namespace_ + "/";
+  for (auto it = keys.begin(); it != keys.end();) {
+    it = it->first.compare(0, prefix.size(), prefix) == 0 ? keys.erase(it) : std::next(it);
+  }
+  return true;
+}
+
+bool Preferences::remove(const char* name) {
+  if (!open_ || readOnly_) return false;
+  return sim::nvsKeys().erase(key(name)) > 0;
+}
+
+bool Preferences::isKey(const char* name) {
+  return open_ && sim::nvsKeys().count(key(name)) > 0;
+}
+
+size_t Preferences::putBytes(const char* name, const void* value, size_t length) {
+  if (!open_ || readOnly_) return 0;
+  std::vector<uint8_t> data((const uint8_t*)value, (const uint8_t*)value + length);
+  std::vector<uint8_t>& stored = sim::nvsKeys()[key(name)];
+  sim::advanceNs(sim::kNvsWriteOpNs);
+  // NVS compares before writing: the same value programs nothing
+  if (stored == data) {
+    sim::nvsStats().unchanged++;
+    return length;
+  }
+  // A blob is a header entry, its data entries and an index entry
+  uint64_t entries = 2 + (length + 31) / 32;
+  sim::advanceNs(entries * sim::kNvsEntryNs);
+  sim::nvsStats().writes++;
+  sim::nvsStats().entries += entries;
+  stored = data;
+  return length;
+}
+
+size_t Preferences::getBytes(const char* name, void* buffer, size_t maxLength) {
+  if (!open_) return 0;
+  auto it = sim::nvsKeys().find(key(name));
+  if (it == sim::nvsKeys().end() || it->second.size() > maxLength) return 0;
+  sim::nvsStats().reads++;
+  memcpy(buffer, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+size_t Preferences::getBytesLength(const char* name) {
+  if (!open_) return 0;
+  auto it = sim::nvsKeys().find(key(name));
+  return it == sim::nvsKeys().end() ? 0 : it->second.size();
+}
@@ -0,0 +1,140 @@
+/*
+   ESP32 RFID Jukebox - interrupt-driven buttons
+*/
+
+#include "button_input.h"
+#include "jukebox_tasks.h"
+
+void IRAM_ATTR ButtonInput::onEdge(void* arg) {
+  Button* button = (Button*)arg;
+  if (!button->edge) {
+    button->edgeUs = micros();
+    button->edge = true;
+  }
+  button->interrupts = button->interrupts + 1;
+  wakeTaskFromIsr(TASK_INPUT);
+}
+
+void ButtonInput::begin(InputEventQueue& events) {
+  events_ = &events;
+}
+
+bool ButtonInput::add(uint8_t pin, InputButton id, uint8_t gestures) {
+  if (count_ >= MAX_BUTTONS) return false;
+  Button& button = buttons_[count_++];
+  button = Button();
+  button.pin = pin;
+  button.id = id;
+  button.gestures = gestures;
+  pinMode(pin, INPUT_PULLUP);
+  button.pressed = digitalRead(pin) == LOW;
+  attachInterruptArg(digitalPinToInterrupt(pin), onEdge, &button, CHANGE);
+  return true;
+}
+
+void ButtonInput::update() {
+  uint32_t nowMs = millis();
+  for (uint8_t i = 0; i < count_; i++) {
+    Button& button = buttons_[i];
+
+    if (button.locked && nowMs - button.lockMs < DEBOUNCE_MS) {
+      // Contacts still settling: edges are bounce
+    } else if (button.edge || button.locked) {
+      // A first edge, or the lockout has ended: act on the level now
+      uint32_t edgeUs = button.edge ? button.edgeUs : micros();
+      button.edge = false;             // before the read: a later edge sets it again
+      button.locked = false;
+      bool pressed = digitalRead(button.pin) == LOW;
+      if (pressed != button.pressed) {
+        changed(button, pressed, edgeUs, nowMs);
+        button.locked = true;
+        button.lockMs = nowMs;
+      }
+    }
+
+    runTimers(button, nowMs);
+  }
+}
+
+void ButtonInput::changed(Button& button, bool pressed, uint32_t edgeUs, uint32_t nowMs) {
+  accepted_++;
+  button.pressed = pressed;
+
+  if (pressed) {
+    button.held = false;
+    button.doubled = false;
+    button.nextLongMs = nowMs + LONG_PRESS_MS;
+    button.pressUs = edgeUs;
+    if (!(button.gestures & DOUBLE)) {
+      emit(button, GESTURE_PRESS, edgeUs);
+    } else if (button.singlePending) {
+      button.singlePending = false;
+      button.doubled = true;
+      emit(button, GESTURE_DOUBLE, edgeUs);
+    }
+  } else if ((button.gestures & DOUBLE) && !button.doubled && !button.held) {
+    button.singlePending = true;
+    button.releaseMs = nowMs;
+  }
+}
+
+// Held, and a LONG (first or repeated) is still to come
+bool ButtonInput::longPending(const Button& button) {
+  if (!button.pressed || !(button.gestures & LONG)) return false;
+  return !button.held || (button.gestures & REPEAT);
+}
+
+void ButtonInput::runTimers(Button& button, uint32_t nowMs) {
+  if (longPending(button) && (int32_t)(nowMs - button.nextLongMs) >= 0) {
+    button.held = true;
+    button.nextLongMs += REPEAT_MS;
+    emit(button, GESTURE_LONG, micros());
+  }
+  if (button.singlePending && nowMs - button.releaseMs >= DOUBLE_PRESS_MS) {
+    button.singlePending = false;
+    emit(button, GESTURE_PRESS, button.pressUs);
+  }
+}
+
+void ButtonInput::emit(Button& button, ButtonGesture gesture, uint32_t sinceUs) {
+  gestures_[gesture]++;
+  if (events_) events_->push(INPUT_BUTTON, buttonEventValue(button.id, gesture), sinceUs);
+}
+
+uint32_t ButtonInput::nextTimeoutMs() const {
+  uint32_t nowMs = millis();
+  uint32_t next = 0;
+  for (uint8_t i = 0; i < count_; i++) {
+    const Button& button = buttons_[i];
+    uint32_t due = 0;
+    if (button.locked) {
+      due = button.lockMs + DEBOUNCE_MS;
+    } else if (longPending(button)) {
+      due = button.nextLongMs;
+    } else if (button.singlePending) {
+      due = button.releaseMs + DOUBLE_PRESS_MS;
+    } else {
+      continue;
+    }
+    int32_t wait = (int32_t)(due - nowMs);
+    uint32_t waitMs = wait > 1 ? wait : 1;
+    if (next == 0 || waitMs < next) next = waitMs;
+  }
+  return next;
+}
+
+void ButtonInput::recordLatency(uint32_t us) {
+  latencyCount_++;
+  latencySumUs_ += us;
+  if (us > maxLatencyUs_) maxLatencyUs_ = us;
+}
+
+uint32_t ButtonInput::edges() const {
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < count_; i++) total += buttons_[i].interrupts;
+  return total;
+}
+
+uint32_t ButtonInput::averageLatencyUs() const {
+  return latencyCount_ ? latencySumUs_ / latencyCount_ : 0;
+}
@@ -0,0 +1,247 @@
+/*
+   ESP32 RFID Jukebox - batch card programming
+*/
+
+#include "card_batch.h"
+
+CardBatch cardBatch;
+
+static const char* const RESULT_NAMES[] = {"written", "retry", "failed"};
+
+uint16_t CardBatchSpec::total() const {
+  uint16_t sum = 0;
+  for (uint8_t i = 0; i < count; i++) sum += ranges[i].last - ranges[i].first + 1;
+  return sum;
+}
+
+// Card number at text[i], advancing i; false if there is none or it is invalid
+static bool parseNumber(const char* text, size_t length, size_t& i, int16_t& number) {
+  bool negative = i < length && text[i] == '-';
+  if (negative) i++;
+  size_t start = i;
+  int32_t value = 0;
+  while (i < length && text[i] >= '0' && text[i] <= '9' && i - start < 5) {
+    value = value * 10 + (text[i] - '0');
+    i++;
+  }
+  if (i == start) return false;
+  if (negative) value = -value;
+  if (value == 0 || value < -7 || value > 32767) return false;
+  number = value;
+  return true;
+}
+
+bool CardBatch::parse(const char* text, size_t length, CardBatchSpec& spec) {
+  spec.count = 0;
+  size_t i = 0;
+  uint32_t total = 0;
+  while (i < length) {
+    while (i < length && (text[i] == ' ' || text[i] == ',')) i++;
+    if (i == length) break;
+
+    CardBatchSpec::Range range;
+    if (!parseNumber(text, length, i, range.first)) return false;
+    range.last = range.first;
+    if (i < length && text[i] == '-') {
+      i++;
+      if (!parseNumber(text, length, i, range.last) || range.last < range.first) return false;
+      // Folder cards and numbered cards don't share a range: 0 is no card
+      if (range.first < 0 && range.last > 0) return false;
+    }
+    if (i < length && text[i] != ' ' && text[i] != ',' && text[i] != '\r' && text[i] != '\n') return false;
+    if (spec.count == CardBatchSpec::MAX_RANGES) return false;
+    total += range.last - range.first + 1;
+    if (total > 0xFFFF) return false;
+    spec.ranges[spec.count++] = range;
+    while (i < length && (text[i] == '\r' || text[i] == '\n')) i++;
+  }
+  return spec.count > 0;
+}
+
+bool CardBatch::submit(const CardBatchSpec& spec) {
+  if (submittedWaiting_.load(std::memory_order_acquire)) return false;
+  submitted_ = spec;
+  submittedWaiting_.store(true, std::memory_order_release);
+  return true;
+}
+
+bool CardBatch::takeSubmitted(CardBatchSpec& spec) {
+  if (!submittedWaiting_.load(std::memory_order_acquire)) return false;
+  spec = submitted_;
+  submittedWaiting_.store(false, std::memory_order_release);
+  return true;
+}
+
+void CardBatch::start(const CardBatchSpec& spec) {
+  spec_ = spec;
+  range_ = 0;
+  offset_ = 0;
+  running_ = spec.count > 0;
+  pendingSize_ = 0;
+  attempts_ = 0;
+  total_ = spec.total();
+  written_ = 0;
+  failed_ = 0;
+  retries_ = 0;
+  firstMs_ = 0;
+  lastMs_ = 0;
+  for (Entry& entry : log_) entry.seq.store(0, std::memory_order_relaxed);
+  logged_.store(0, std::memory_order_release);
+}
+
+int CardBatch::nextNumber() const {
+  if (!running_) return 0;
+  return spec_.ranges[range_].first + offset_;
+}
+
+void CardBatch::advance() {
+  if (spec_.ranges[range_].first + offset_ < spec_.ranges[range_].last) {
+    offset_++;
+    return;
+  }
+  offset_ = 0;
+  if (++range_ == spec_.count) running_ = false;
+}
+
+bool CardBatch::sameUid(const MFRC522::Uid& uid, const uint8_t* other, uint8_t size) {
+  return uid.size == size && memcmp(uid.uidByte, other, size) == 0;
+}
+
+bool CardBatch::finished(const MFRC522::Uid& uid) const {
+  // The log holds every card written or flagged, up to the last LOG_SIZE;
+  // only the player task writes it, so no sequence check is needed here
+  uint32_t last = logged_.load(std::memory_order_relaxed);
+  uint32_t seq = last > LOG_SIZE ? last - LOG_SIZE + 1 : 1;
+  for (; seq <= last; seq++) {
+    const Entry& entry = log_[seq & (LOG_SIZE - 1)];
+    if (sameUid(uid, entry.uid, entry.uidSize)) return true;
+  }
+  return false;
+}
+
+CardBatchResult CardBatch::cardDone(const MFRC522::Uid& uid, bool ok, uint32_t ms) {
+  if (!sameUid(uid, pendingUid_, pendingSize_)) {
+    // A different card: the one being retried was taken away
+    pendingSize_ = uid.size;
+    memcpy(pendingUid_, uid.uidByte, uid.size);
+    attempts_ = 0;
+  }
+  attempts_++;
+
+  CardBatchResult result;
+  if (ok) {
+    result = CARD_BATCH_WRITTEN;
+    if (written_ == 0) firstMs_ = ms;
+    lastMs_ = ms;
+    written_++;
+  } else if (attempts_ < MAX_ATTEMPTS) {
+    retries_++;
+    return CARD_BATCH_RETRY;
+  } else {
+    result = CARD_BATCH_FAILED;
+    failed_++;
+  }
+
+  log(uid, attempts_, result, ms);
+  if (ok) advance();
+  pendingSize_ = 0;
+  attempts_ = 0;
+  return result;
+}
+
+void CardBatch::log(const MFRC522::Uid& uid, uint8_t attempts, CardBatchResult result, uint32_t ms) {
+  uint32_t seq = logged_.load(std::memory_order_relaxed) + 1;
+  Entry& entry = log_[seq & (LOG_SIZE - 1)];
+
+  entry.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  entry.ms = ms;
+  entry.number = nextNumber();
+  entry.attempts = attempts;
+  entry.result = result;
+  entry.uidSize = uid.size;
+  memcpy(entry.uid, uid.uidByte, uid.size);
+
+  entry.seq.store(seq, std::memory_order_release);
+  logged_.store(seq, std::memory_order_release);
+}
+
+float CardBatch::cardsPerMinute() const {
+  if (written_ < 2 || lastMs_ == firstMs_) return 0;
+  return (written_ - 1) * 60000.0f / (lastMs_ - firstMs_);
+}
+
+void CardBatch::printProgress(Print& out) const {
+  out.print("BATCH: ");
+  out.print(written_);
+  out.print("/");
+  out.print(total_);
+  out.print(" written, ");
+  out.print(failed_);
+  out.print(" cards flagged, ");
+  out.print(retries_);
+  out.print(" retries, ");
+  out.print(cardsPerMinute(), 1);
+  out.print(" cards/min");
+  if (running_) {
+    out.print(", next #");
+    out.print(nextNumber());
+  }
+  out.println();
+}
+
+void CardBatch::writeJson(Print& out) const {
+  out.print("{\"running\":");
+  out.print(running_ ? "true" : "false");
+  out.print(",\"total\":");
+  out.print(total_);
+  out.print(",\"written\":");
+  out.print(written_);
+  out.print(",\"failed\":");
+  out.print(failed_);
+  out.print(",\"retries\":");
+  out.print(retries_);
+  out.print(",\"next\":");
+  out.print(nextNumber());
+  out.print(",\"cardsPerMinute\":");
+  out.print(cardsPerMinute(), 1);
+  out.print(",\"cards\":[");
+
+  uint32_t next = logged_.load(std::memory_order_acquire) + 1;
+  uint32_t seq = next > LOG_SIZE ? next - LOG_SIZE : 1;
+  bool first = true;
+  for (; seq < next; seq++) {
+    const Entry& entry = log_[seq & (LOG_SIZE - 1)];
+    if (entry.seq.load(std::memory_order_acquire) != seq) continue;
+    Entry copy;
+    copy.ms = entry.ms;
+    copy.number = entry.number;
+    copy.attempts = entry.attempts;
+    copy.result = entry.result;
+    copy.uidSize = entry.uidSize < sizeof(copy.uid) ? entry.uidSize : sizeof(copy.uid);
+    memcpy(copy.uid, entry.uid, copy.uidSize);
+
+    // Overwritten while copying: skip it
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (entry.seq.load(std::memory_order_relaxed) != seq) continue;
+
+    if (!first) out.print(",");
+    first = false;
+    out.print("{\"number\":");
+    out.print(copy.number);
+    out.print(",\"uid\":\"");
+    for (uint8_t i = 0; i < copy.uidSize; i++) {
+      if (copy.uid[i] < 0x10) out.print("0");
+      out.print(copy.uid[i], HEX);
+    }
+    out.print("\",\"attempts\":");
+    out.print(copy.attempts);
+    out.print(",\"result\":\"");
+    out.print(RESULT_NAMES[copy.result < 3 ? copy.result : 2]);
+    out.print("\",\"ms\":");
+    out.print(copy.ms);
+    out.print("}");
+  }
+  out.print("]}");
+}
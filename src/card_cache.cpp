@@ -0,0 +1,141 @@
+/*
+   ESP32 RFID Jukebox - UID to card number cache
+*/
+
+#include "card_cache.h"
+
+static const uint8_t CACHE_MAGIC[4] = {'J', 'B', 'C', 0x01};
+
+bool CardCache::begin(fs::FS& fs, const char* path) {
+  fs_ = &fs;
+  path_ = path;
+  memset(table_, 0, sizeof(table_));
+  count_ = 0;
+
+  if (!fs.exists(path)) return true;
+  File file = fs.open(path, FILE_READ);
+  if (!file) return false;
+
+  uint8_t header[4];
+  bool damaged = file.read(header, sizeof(header)) != sizeof(header) ||
+                 memcmp(header, CACHE_MAGIC, sizeof(header)) != 0;
+  uint16_t records = 0;
+  while (!damaged && file.available() > 0) {
+    uint8_t record[13];
+    record[0] = (uint8_t)file.read();
+    uint8_t size = record[0];
+    if ((size != 4 && size != 7 && size != 10) ||
+        file.read(record + 1, size + 2) != (size_t)(size + 2)) {
+      damaged = true;
+      break;
+    }
+    int16_t number = (int16_t)(record[1 + size] | (record[2 + size] << 8));
+    if (!store(record + 1, size, number)) damaged = true;
+    records++;
+  }
+  file.close();
+
+  // Drop superseded and damaged records
+  if (damaged || records != count_) rewrite();
+  return true;
+}
+
+bool CardCache::lookup(const MFRC522::Uid& uid, int& number) {
+  Entry* entry = find(uid.uidByte, uid.size, false);
+  if (entry == nullptr) {
+    misses_++;
+    return false;
+  }
+  hits_++;
+  number = entry->number;
+  return true;
+}
+
+bool CardCache::insert(const MFRC522::Uid& uid, int number) {
+  if (uid.size == 0 || uid.size > sizeof(table_[0].uid)) return false;
+  if (number < INT16_MIN || number > INT16_MAX) return false;
+
+  Entry* existing = find(uid.uidByte, uid.size, false);
+  if (existing != nullptr && existing->number == number) return true;
+  if (!store(uid.uidByte, uid.size, (int16_t)number)) return false;
+  append(*find(uid.uidByte, uid.size, false));
+  return true;
+}
+
+void CardCache::clear() {
+  memset(table_, 0, sizeof(table_));
+  count_ = 0;
+  if (fs_ != nullptr) fs_->remove(path_);
+}
+
+float CardCache::hitRate() const {
+  uint32_t lookups = hits_ + misses_;
+  if (lookups == 0) return 0.0f;
+  return hits_ * 100.0f / lookups;
+}
+
+uint32_t CardCache::hash(const uint8_t* uid, uint8_t size) {
+  // FNV-1a
+  uint32_t h = 2166136261u;
+  for (uint8_t i = 0; i < size; i++) {
+    h ^= uid[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+CardCache::Entry* CardCache::find(const uint8_t* uid, uint8_t size, bool forInsert) {
+  // Linear probing; entries are never removed one by one, so an empty slot
+  // ends the probe sequence
+  uint32_t slot = hash(uid, size) & (CAPACITY - 1);
+  for (uint16_t probe = 0; probe < CAPACITY; probe++) {
+    Entry& entry = table_[slot];
+    if (entry.uidSize == 0) return forInsert ? &entry : nullptr;
+    if (entry.uidSize == size && memcmp(entry.uid, uid, size) == 0) return &entry;
+    slot = (slot + 1) & (CAPACITY - 1);
+  }
+  return nullptr;
+}
+
+bool CardCache::store(const uint8_t* uid, uint8_t size, int16_t number) {
+  Entry* entry = find(uid, size, true);
+  if (entry == nullptr) return false;
+  if (entry->uidSize == 0) {
+    if (count_ >= MAX_ENTRIES) return false;
+    entry->uidSize = size;
+    memcpy(entry->uid, uid, size);
+    count_++;
+  }
+  entry->number = number;
+  return true;
+}
+
+void CardCache::append(const Entry& entry) {
+  if (fs_ == nullptr) return;
+  bool fresh = !fs_->exists(path_);
+  File file = fs_->open(path_, FILE_APPEND);
+  if (!file) return;
+  if (fresh) file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  writeRecord(file, entry);
+  file.close();
+}
+
+void CardCache::rewrite() {
+  if (fs_ == nullptr) return;
+  File file = fs_->open(path_, FILE_WRITE);
+  if (!file) return;
+  file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  for (uint16_t i = 0; i < CAPACITY; i++) {
+    if (table_[i].uidSize != 0) writeRecord(file, table_[i]);
+  }
+  file.close();
+}
+
+void CardCache::writeRecord(File& file, const Entry& entry) {
+  uint8_t record[13];
+  record[0] = entry.uidSize;
+  memcpy(record + 1, entry.uid, entry.uidSize);
+  record[1 + entry.uidSize] = (uint8_t)entry.number;
+  record[2 + entry.uidSize] = (uint8_t)(entry.number >> 8);
+  file.write(record, entry.uidSize + 3);
+}
@@ -0,0 +1,88 @@
+/*
+   ESP32 RFID Jukebox - binary card record for NTAG/Ultralight cards
+*/
+
+#include "card_record.h"
+
+static const byte RECORD_MAGIC = 'J';
+static const byte RECORD_VERSION = 1;
+static const int SHUFFLE_CARD = -7;
+static const int FOLDER_CARDS = 6;
+
+bool cardRecordFromNumber(int number, CardRecord& record) {
+  if (number > 0 && number <= 0xFFFF) {
+    record = {CARD_ACTION_TRACK, (uint16_t)number};
+  } else if (number < 0 && number >= -FOLDER_CARDS) {
+    record = {CARD_ACTION_FOLDER, (uint16_t)-number};
+  } else if (number == SHUFFLE_CARD) {
+    record = {CARD_ACTION_SHUFFLE, 0};
+  } else {
+    return false;
+  }
+  return true;
+}
+
+int cardNumber(const CardRecord& record) {
+  switch (record.action) {
+    case CARD_ACTION_FOLDER:  return -(int)record.number;
+    case CARD_ACTION_SHUFFLE: return SHUFFLE_CARD;
+    default:                  return record.number;
+  }
+}
+
+uint16_t cardRecordCrc(const byte* data, uint8_t length) {
+  // CRC-16/CCITT-FALSE: poly 0x1021, init 0xFFFF
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+void encodeCardRecord(const CardRecord& record, byte* out) {
+  out[0] = RECORD_MAGIC;
+  out[1] = RECORD_VERSION;
+  out[2] = record.action;
+  out[3] = 0;
+  out[4] = record.number & 0xFF;
+  out[5] = record.number >> 8;
+  uint16_t crc = cardRecordCrc(out, 6);
+  out[6] = crc & 0xFF;
+  out[7] = crc >> 8;
+}
+
+bool decodeCardRecord(const byte* data, CardRecord& record) {
+  if (data[0] != RECORD_MAGIC || data[1] != RECORD_VERSION) return false;
+  if (data[2] >= CARD_ACTION_COUNT) return false;
+  uint16_t crc = data[6] | (uint16_t)data[7] << 8;
+  if (crc != cardRecordCrc(data, 6)) return false;
+  record.action = (CardAction)data[2];
+  record.number = data[4] | (uint16_t)data[5] << 8;
+  return true;
+}
+
+bool usesCardRecord(MFRC522::PICC_Type type) {
+  return type == MFRC522::PICC_TYPE_MIFARE_UL;     // Ultralight, NTAG21x
+}
+
+MFRC522::StatusCode readCardRecord(MFRC522& reader, CardRecord& record) {
+  // READ returns pages 4-7 (16 bytes) plus CRC_A; no authentication
+  byte buffer[18];
+  byte size = sizeof(buffer);
+  MFRC522::StatusCode status = reader.MIFARE_Read(CARD_RECORD_PAGE, buffer, &size);
+  if (status != MFRC522::STATUS_OK) return status;
+  return decodeCardRecord(buffer, record) ? MFRC522::STATUS_OK : MFRC522::STATUS_CRC_WRONG;
+}
+
+MFRC522::StatusCode writeCardRecord(MFRC522& reader, const CardRecord& record) {
+  byte data[CARD_RECORD_SIZE];
+  encodeCardRecord(record, data);
+  for (uint8_t page = 0; page < CARD_RECORD_SIZE / 4; page++) {
+    MFRC522::StatusCode status = reader.MIFARE_Ultralight_Write(CARD_RECORD_PAGE + page, data + page * 4, 4);
+    if (status != MFRC522::STATUS_OK) return status;
+  }
+  return MFRC522::STATUS_OK;
+}
@@ -0,0 +1,515 @@
+/*
+   ESP32 RFID Jukebox - console and web commands
+*/
+
+#include "commands.h"
+#include "jukebox.h"
+#include "song_catalog.h"
+
+typedef void (*CommandHandler)(int32_t argument, Print& out, CommandSource source);
+
+struct CommandSpec {
+  const char* name;
+  char key;            // one-key alias, 0 for none
+  bool number;         // takes a number
+  CommandHandler handler;
+};
+
+//*****************************************************************************
+// Command handlers
+//*****************************************************************************
+
+static void statusCommand(int32_t, Print& out, CommandSource source) {
+  out.print("DFPlayer state: ");
+  out.print(playerScheduler.state());
+  if (customShuffleMode) {
+    out.print(" (Shuffle: ON, Track ");
+    out.print(shuffleIndex);
+    out.print("/");
+    out.print(shuffleSize);
+    out.print(")");
+  }
+  out.println();
+  if (source == COMMAND_WEB) {
+    // A web result has to fit one response slot; the counters below are
+    // served by /api/metrics and the task table by /api/tasks
+    out.print("Play queue: ");
+    out.print(playQueue.size());
+    out.print(" queued, card queue mode ");
+    out.println(cardQueueMode ? "ON" : "OFF");
+    out.print("Tasks: ");
+    out.println(jukeboxTasksRunning() ? "running" : "single loop");
+    out.println("Counters: see /api/metrics and /api/tasks");
+    return;
+  }
+  out.print("DFPlayer events: ");
+  out.print(playerScheduler.framesReceived());
+  out.print(" frames received, ");
+  out.print(playerScheduler.finishEvents());
+  out.print(" tracks finished, ");
+  out.print(playerScheduler.receiveErrors());
+  out.println(" receive errors");
+  out.print("Play queue: ");
+  out.print(playQueue.size());
+  out.print(" queued, card queue mode ");
+  out.print(cardQueueMode ? "ON" : "OFF");
+  out.print(", ");
+  out.print(playerScheduler.advances());
+  out.print(" track advances (");
+  out.print(playerScheduler.armedAdvances());
+  out.print(" armed), gap ");
+  out.print(playerScheduler.lastAdvanceMs());
+  out.print(" ms (max ");
+  out.print(playerScheduler.maxAdvanceMs());
+  out.println(" ms)");
+  out.print("Card cache: ");
+  out.print(cardCache.size());
+  out.print(" cards, ");
+  out.print(cardCache.hits());
+  out.print(" hits, ");
+  out.print(cardCache.misses());
+  out.print(" misses (");
+  out.print(cardCache.hitRate(), 1);
+  out.println("% hit rate)");
+  out.println(rfidDetectReport());
+  out.println(buttonReport());
+  out.print("Scheduler: ");
+  out.print(playerScheduler.framesSent());
+  out.print(" frames sent, ");
+  out.print(playerScheduler.pending());
+  out.print(" pending, ");
+  out.print(playerScheduler.transitionLoopRate(), 0);
+  out.println(" loops/s during track changes");
+  out.print("Web queue: ");
+  out.print(webCommands.depth());
+  out.print(" queued (max ");
+  out.print(webCommands.maxDepth());
+  out.print("), ");
+  out.print(webCommands.accepted());
+  out.print(" accepted, ");
+  out.print(webCommands.dropped());
+  out.println(" dropped");
+  out.print("Web responses: ");
+  out.print(webResponses.stored());
+  out.print(" stored, ");
+  out.print(webResponses.truncated());
+  out.print(" truncated, ");
+  out.print(webResponses.expired());
+  out.println(" read after expiry");
+  out.print("Events: ");
+  out.print(playerEvents.stateEvents());
+  out.print(" state, ");
+  out.print(playerEvents.resultEvents());
+  out.print(" results, ");
+  out.print(playerEvents.coalesced());
+  out.println(" changes coalesced");
+  out.print("Tasks: ");
+  out.print(jukeboxTasksRunning() ? "running" : "single loop");
+  out.print(", input events ");
+  out.print(inputEvents.pushed());
+  out.print(" queued, ");
+  out.print(inputEvents.dropped());
+  out.print(" dropped, max wait ");
+  out.print(inputEvents.maxLatencyUs());
+  out.print(" us");
+  for (uint8_t i = 0; i < JUKEBOX_TASK_COUNT; i++) {
+    out.print("\n  ");
+    out.print(taskReportLine((JukeboxTask)i));
+  }
+  out.println();
+}
+
+static void volumeCommand(int32_t, Print& out, CommandSource) {
+  out.print("VOLUME: Current volume: ");
+  out.println(currentVolume);
+}
+
+static void setVolumeCommand(int32_t level, Print& out, CommandSource) {
+  if (level < MIN_VOLUME || level > MAX_VOLUME) {
+    out.print("ERROR: Invalid volume. Must be ");
+    out.print(MIN_VOLUME);
+    out.print("-");
+    out.print(MAX_VOLUME);
+    out.println(".");
+    return;
+  }
+  currentVolume = level;
+  playerScheduler.volume(currentVolume);
+  out.print("VOLUME: Volume set to ");
+  out.println(currentVolume);
+}
+
+static void volumeUpCommand(int32_t, Print& out, CommandSource) {
+  if (currentVolume < MAX_VOLUME) {
+    currentVolume++;
+    playerScheduler.volume(currentVolume);
+    out.print("VOLUME: Volume up: ");
+    out.println(currentVolume);
+  } else {
+    out.print("VOLUME: Volume already at maximum (");
+    out.print(MAX_VOLUME);
+    out.println(")");
+  }
+}
+
+static void volumeDownCommand(int32_t, Print& out, CommandSource) {
+  if (currentVolume > MIN_VOLUME) {
+    currentVolume--;
+    playerScheduler.volume(currentVolume);
+    out.print("VOLUME: Volume down: ");
+    out.println(currentVolume);
+  } else {
+    out.print("VOLUME: Volume already at minimum (");
+    out.print(MIN_VOLUME);
+    out.println(")");
+  }
+}
+
+static void listCommand(int32_t, Print& out, CommandSource source) {
+  if (source == COMMAND_WEB) {
+    // The list itself is streamed by /api/songs, a reply with every song
+    // would need the buffer to grow with the catalog
+    out.print("LIST: ");
+    out.print(songCount());
+    out.println(" songs - see /api/songs?offset=0&limit=100");
+    return;
+  }
+  out.println(F("\n=== Song List ==="));
+  for (int i = 1; i <= songCount(); i++) {
+    out.print("Track ");
+    if (i < 10) out.print("0");
+    out.print(i);
+    out.print(": ");
+    printSongInfo(out, i);
+    out.println();
+  }
+  out.println(F("===================\n"));
+}
+
+static void stopCommand(int32_t, Print& out, CommandSource) {
+  playerScheduler.stop();
+  isPlaying = false;
+  currentSong = 0;
+  // Exit shuffle mode when manually stopping
+  if (customShuffleMode) {
+    customShuffleMode = false;
+    out.println("STOP: Exiting shuffle mode - Current song stopped");
+  } else {
+    out.println("STOP: Current song stopped");
+  }
+}
+
+static void shuffleCommand(int32_t, Print& out, CommandSource) {
+  startCustomShuffle();
+  out.println("SHUFFLE: Custom shuffle mode activated - True random playback");
+}
+
+static void shuffleInfoCommand(int32_t, Print& out, CommandSource) {
+  if (!customShuffleMode) {
+    out.println("SHUFFLE: Inactive - Normal playback mode");
+    return;
+  }
+  out.print("SHUFFLE: Active - Track ");
+  out.print(shuffleIndex);
+  out.print(" of ");
+  out.print(shuffleSize);
+  out.print(", cycle ");
+  out.print(shuffleOrder.cycle());
+  out.print(", seed ");
+  out.print(shuffleOrder.seed());
+  out.print(" (Current: #");
+  out.print(currentSong);
+  out.print(" - ");
+  printSongInfo(out, currentSong);
+  out.println(")");
+}
+
+static void playPauseCommand(int32_t, Print& out, CommandSource) {
+  if (isPlaying) {
+    playerScheduler.pause();
+    isPlaying = false;
+    out.println("PAUSE: Playback paused");
+  } else {
+    playerScheduler.start();
+    isPlaying = true;
+    out.println("PLAY: Playback resumed");
+  }
+}
+
+static void nextCommand(int32_t, Print& out, CommandSource) {
+  if (playQueue.size() > 0) {
+    playQueuedTrack();
+    out.print("NEXT: Next queued track #");
+    out.print(currentSong);
+    out.print(" - ");
+    printSongInfo(out, currentSong);
+    out.println();
+  } else if (customShuffleMode) {
+    playNextShuffleTrack();
+    out.println("NEXT: Next shuffle track");
+  } else {
+    playerScheduler.next();
+    if (currentSong > 0) currentSong++;
+    out.println("NEXT: Next track");
+  }
+}
+
+static void previousCommand(int32_t, Print& out, CommandSource) {
+  playerScheduler.previous();
+  if (currentSong > 1) currentSong--;
+  out.println("PREVIOUS: Previous track");
+}
+
+static bool validTrack(int32_t track, Print& out) {
+  if (track >= 1 && track <= songCount()) return true;
+  out.print("ERROR: Invalid song number. Must be 1-");
+  out.print(songCount());
+  out.println(".");
+  return false;
+}
+
+static void playCommand(int32_t track, Print& out, CommandSource) {
+  if (!validTrack(track, out)) return;
+  // Exit shuffle mode when playing a specific song
+  customShuffleMode = false;
+  playerScheduler.playTrack(track);
+  currentSong = track;
+  isPlaying = true;
+  out.print("PLAY: Playing track #");
+  out.print(track);
+  out.print(" - ");
+  printSongInfo(out, track);
+  out.println();
+}
+
+static void queueCommand(int32_t, Print& out, CommandSource) {
+  printPlayQueue(out);
+}
+
+static void addToQueueCommand(int32_t track, Print& out, CommandSource) {
+  if (!validTrack(track, out)) return;
+  if (!enqueueTrack(track)) {
+    out.print("ERROR: Play queue full (");
+    out.print(PlayQueue::CAPACITY);
+    out.println(" tracks)");
+    return;
+  }
+  out.print("QUEUE: Added track #");
+  out.print(track);
+  out.print(" - ");
+  printSongInfo(out, track);
+  out.print(" (");
+  out.print(playQueue.size());
+  out.println(" queued)");
+}
+
+static void cardQueueModeCommand(int32_t, Print& out, CommandSource) {
+  cardQueueMode = !cardQueueMode;
+  out.println(cardQueueMode ? "QUEUE: Card queue mode ON - cards tapped while playing are queued"
+                            : "QUEUE: Card queue mode OFF - cards play immediately");
+}
+
+static void clearQueueCommand(int32_t, Print& out, CommandSource) {
+  playQueue.clear();
+  out.println("QUEUE: Play queue cleared");
+}
+
+static void detectModeCommand(int32_t, Print& out, CommandSource) {
+  out.println(switchRfidDetectMode());
+}
+
+static void forgetCardsCommand(int32_t, Print& out, CommandSource) {
+  // Forget known cards, e.g. after reprogramming cards elsewhere
+  lockReader();
+  cardCache.clear();
+  unlockReader();
+  out.println("CACHE: Card cache cleared - cards are read in full again");
+}
+
+static void programCommand(int32_t, Print& out, CommandSource source) {
+  if (!enterProgrammerMode()) {
+    out.println("Already in programming mode");
+    return;
+  }
+  out.println(F("PROGRAM: === PROGRAMMING MODE ACTIVATED ==="));
+  if (source == COMMAND_WEB) {
+    out.println(F("Note: Programming mode works best with Serial Monitor."));
+    out.println(F("Use Serial Monitor for: 'auto', 'manual', 'read', or 'jukebox'"));
+  } else {
+    out.println(F("Write 'auto' for Automatic mode, 'manual' for Manual mode, or 'read' to read cards"));
+    out.println(F("Type 'jukebox' to return to jukebox mode"));
+  }
+}
+
+static void jukeboxCommand(int32_t, Print& out, CommandSource) {
+  if (!enterJukeboxMode()) {
+    out.println("Already in jukebox mode");
+    return;
+  }
+  out.println(F("JUKEBOX: === JUKEBOX MODE ACTIVATED ==="));
+  out.println(F("Place an RFID card on the reader to play a song"));
+}
+
+static void resetCommand(int32_t, Print& out, CommandSource) {
+  out.println("RESET: Manual reset command received - ESP32 will restart");
+  playerStateStore.flush();
+  delay(100);  // let the message out
+  ESP.restart();
+}
+
+static void helpCommand(int32_t, Print& out, CommandSource) {
+  printCommandHelp(out);
+}
+
+// In CommandId order
+static const CommandSpec COMMANDS[COMMAND_COUNT] = {
+  {"status",      's', false, statusCommand},
+  {"volume",      'v', false, volumeCommand},
+  {"volume",      0,   true,  setVolumeCommand},
+  {"up",          '+', false, volumeUpCommand},
+  {"down",        '-', false, volumeDownCommand},
+  {"list",        'l', false, listCommand},
+  {"stop",        'x', false, stopCommand},
+  {"shuffle",     'h', false, shuffleCommand},
+  {"shuffleinfo", 'z', false, shuffleInfoCommand},
+  {"toggle",      't', false, playPauseCommand},
+  {"next",        'n', false, nextCommand},
+  {"previous",    'b', false, previousCommand},
+  {"play",        0,   true,  playCommand},
+  {"queue",       'q', false, queueCommand},
+  {"queue",       0,   true,  addToQueueCommand},
+  {"cardqueue",   'u', false, cardQueueModeCommand},
+  {"clear",       'c', false, clearQueueCommand},
+  {"detect",      'i', false, detectModeCommand},
+  {"forget",      'k', false, forgetCardsCommand},
+  {"program",     'p', false, programCommand},
+  {"jukebox",     0,   false, jukeboxCommand},
+  {"reset",       'r', false, resetCommand},
+  {"help",        '?', false, helpCommand},
+};
+
+//*****************************************************************************
+// Line reader, parser and dispatch
+//*****************************************************************************
+
+bool CommandLine::feed(char c) {
+  tooLong_ = false;
+  if (complete_) {
+    complete_ = false;
+    length_ = 0;
+  }
+  if (c == '\r' || c == '\n') {
+    if (overflow_) {
+      overflow_ = false;
+      length_ = 0;
+      tooLong_ = true;
+      dropped_++;
+      return false;
+    }
+    if (length_ == 0) return false;    // blank line, or the LF of a CRLF
+    line_[length_] = '\0';
+    complete_ = true;
+    return true;
+  }
+  if (c == '\b' || c == 0x7F) {        // backspace from a terminal
+    if (length_ > 0) length_--;
+    return false;
+  }
+  if (length_ == MAX_LENGTH) {
+    overflow_ = true;
+    return false;
+  }
+  line_[length_++] = c;
+  return false;
+}
+
+size_t CommandReply::write(uint8_t c) {
+  if (c == '\r') return 1;
+  if (length_ >= SIZE) return 0;
+  text_[length_++] = c;
+  text_[length_] = '\0';
+  return 1;
+}
+
+// Case-insensitive match of a whole word against a command name
+static bool sameWord(const char* word, size_t length, const char* name) {
+  for (size_t i = 0; i < length; i++) {
+    if (name[i] == '\0' || tolower((unsigned char)word[i]) != name[i]) return false;
+  }
+  return name[length] == '\0';
+}
+
+bool parseCommand(const char* text, size_t length, CommandCall& call) {
+  // Trim spaces, tabs and line ends
+  while (length > 0 && isspace((unsigned char)text[0])) {
+    text++;
+    length--;
+  }
+  while (length > 0 && isspace((unsigned char)text[length - 1])) length--;
+  if (length == 0) return false;
+
+  // Word, then an optional decimal number of at most 5 digits
+  size_t word = 0;
+  while (word < length && text[word] != ' ') word++;
+  size_t i = word;
+  while (i < length && text[i] == ' ') i++;
+  bool hasNumber = i < length;
+  int32_t number = 0;
+  if (hasNumber) {
+    if (length - i > 5) return false;
+    for (; i < length; i++) {
+      if (text[i] < '0' || text[i] > '9') return false;
+      number = number * 10 + (text[i] - '0');
+    }
+  }
+
+  for (uint8_t id = 0; id < COMMAND_COUNT; id++) {
+    const CommandSpec& spec = COMMANDS[id];
+    if (spec.number != hasNumber) continue;
+    bool match = word == 1 ? spec.key != 0 && text[0] == spec.key : sameWord(text, word, spec.name);
+    if (match) {
+      call.id = (CommandId)id;
+      call.argument = number;
+      return true;
+    }
+  }
+  return false;
+}
+
+void runCommand(const CommandCall& call, Print& out, CommandSource source) {
+  if (call.id < COMMAND_COUNT) COMMANDS[call.id].handler(call.argument, out, source);
+}
+
+bool dispatchCommand(const char* line, Print& out, CommandSource source) {
+  CommandCall call;
+  if (!parseCommand(line, strlen(line), call)) {
+    out.print("Unknown command: ");
+    out.println(line);
+    printCommandHelp(out);
+    return false;
+  }
+  runCommand(call, out, source);
+  return true;
+}
+
+String commandText(const CommandCall& call) {
+  if (call.id >= COMMAND_COUNT) return "?";
+  const CommandSpec& spec = COMMANDS[call.id];
+  if (!spec.number) return spec.name;
+  return String(spec.name) + " " + String(call.argument);
+}
+
+void printCommandHelp(Print& out) {
+  out.print("Commands: ");
+  for (uint8_t id = 0; id < COMMAND_COUNT; id++) {
+    const CommandSpec& spec = COMMANDS[id];
+    if (id > 0) out.print(", ");
+    if (spec.key) {
+      out.print(spec.key);
+      out.print('=');
+    }
+    out.print(spec.name);
+    if (spec.number) out.print(" N");
+  }
+  out.println();
+}
@@ -0,0 +1,188 @@
+/*
+   ESP32 RFID Jukebox - non-blocking DFPlayer command scheduler
+*/
+
+#include "dfplayer_scheduler.h"
+#include "loop_metrics.h"
+
+void DFPlayerScheduler::begin(Stream& serial) {
+  serial_ = &serial;
+  head_ = 0;
+  count_ = 0;
+  rxLength_ = 0;
+  lastUpdateTime_ = millis();
+}
+
+bool DFPlayerScheduler::send(uint8_t command, uint16_t parameter, unsigned long gapMs) {
+  if (count_ >= QUEUE_SIZE) {
+    dropped_++;
+    return false;
+  }
+  Command& slot = queue_[(head_ + count_) % QUEUE_SIZE];
+  slot.command = command;
+  slot.parameter = parameter;
+  slot.gapMs = gapMs;
+  count_++;
+  return true;
+}
+
+void DFPlayerScheduler::playTrack(uint16_t track) {
+  // A new track makes any queued transition and unhandled finish pointless
+  dropped_ += count_;
+  count_ = 0;
+  finishPending_ = false;
+  armedStarted_ = 0;
+  trackChanges_++;
+  send(0x16);                                 // stop
+  send(0x03, track, STOP_SETTLE_MS);          // play
+}
+
+void DFPlayerScheduler::playLargeFolder(uint8_t folder, uint16_t file) {
+  send(0x14, (((uint16_t)folder) << 12) | file);
+}
+
+void DFPlayerScheduler::update() {
+  unsigned long now = millis();
+
+  // Loop iterations sustained while a transition is in flight
+  if (count_ > 0) {
+    busyIterations_++;
+    busyMillis_ += now - lastUpdateTime_;
+  }
+  lastUpdateTime_ = now;
+
+  if (serial_ == nullptr) return;
+  receive();
+  if (count_ == 0) return;
+
+  const Command& cmd = queue_[head_];
+  unsigned long gap = cmd.gapMs > FRAME_GAP_MS ? cmd.gapMs : FRAME_GAP_MS;
+  if (sentAny_ && now - lastFrameTime_ < gap) return;
+
+  writeFrame(cmd.command, cmd.parameter);
+  head_ = (head_ + 1) % QUEUE_SIZE;
+  count_--;
+}
+
+void DFPlayerScheduler::writeFrame(uint8_t command, uint16_t parameter) {
+  METRIC_TIMER(METRIC_DFPLAYER_TX);
+  // 7E FF 06 CMD ACK PH PL CSH CSL EF, no ACK requested
+  uint8_t frame[10] = {0x7E, 0xFF, 0x06, command, 0x00,
+                       (uint8_t)(parameter >> 8), (uint8_t)parameter, 0, 0, 0xEF};
+  uint16_t sum = 0;
+  for (int i = 1; i < 7; i++) sum += frame[i];
+  uint16_t checksum = (uint16_t)(0 - sum);
+  frame[7] = (uint8_t)(checksum >> 8);
+  frame[8] = (uint8_t)checksum;
+
+  serial_->write(frame, sizeof(frame));
+  lastFrameTime_ = millis();
+  sentAny_ = true;
+  framesSent_++;
+
+  // First track command after a finish: how long the module sat idle. Much
+  // later it is a new start by the user, not the next track.
+  if (advancing_ && (command == 0x03 || command == 0x01 || command == 0x14)) {
+    advancing_ = false;
+    unsigned long gap = lastFrameTime_ - finishTime_;
+    if (gap < ADVANCE_WINDOW_MS) {
+      lastAdvanceMs_ = gap;
+      if (gap > maxAdvanceMs_) maxAdvanceMs_ = gap;
+      advances_++;
+    }
+  }
+
+  switch (command) {
+    case 0x03: state_ = PLAYING; playingTrack_ = parameter; break;
+    case 0x01:
+    case 0x02:
+    case 0x14: state_ = PLAYING; playingTrack_ = 0; break;
+    case 0x0D: state_ = PLAYING; break;
+    case 0x0E: state_ = PAUSED; break;
+    case 0x16: state_ = STOPPED; break;
+  }
+}
+
+void DFPlayerScheduler::receive() {
+  METRIC_TIMER(METRIC_DFPLAYER_RX);
+  // Whatever has arrived, never waiting for more: 7E FF 06 CMD ACK PH PL CSH CSL EF
+  while (serial_->available() > 0) {
+    uint8_t b = (uint8_t)serial_->read();
+    if (rxLength_ == 0 && b != 0x7E) continue;          // hunt for a start byte
+    if (rxLength_ == 1 && b != 0xFF) {                  // not a frame, resync
+      rxLength_ = (b == 0x7E) ? 1 : 0;
+      receiveErrors_++;
+      continue;
+    }
+    rxFrame_[rxLength_++] = b;
+    if (rxLength_ < sizeof(rxFrame_)) continue;
+
+    rxLength_ = 0;
+    uint16_t sum = 0;
+    for (int i = 1; i < 7; i++) sum += rxFrame_[i];
+    uint16_t checksum = ((uint16_t)rxFrame_[7] << 8) | rxFrame_[8];
+    if (rxFrame_[2] != 0x06 || rxFrame_[9] != 0xEF || (uint16_t)(sum + checksum) != 0) {
+      receiveErrors_++;
+      continue;
+    }
+    framesReceived_++;
+    handleFrame(rxFrame_[3], ((uint16_t)rxFrame_[5] << 8) | rxFrame_[6]);
+  }
+}
+
+void DFPlayerScheduler::handleFrame(uint8_t command, uint16_t parameter) {
+  switch (command) {
+    case 0x3C:    // U-disk track finished
+    case 0x3D:    // TF card track finished
+    case 0x3E: {  // flash track finished
+      unsigned long now = millis();
+      bool repeat = parameter == finishedTrack_ && now - lastFinishTime_ < FINISH_REPEAT_MS;
+      finishedTrack_ = parameter;
+      lastFinishTime_ = now;
+      if (repeat) break;
+      // Stale if a new track is already on its way or playing
+      if (busy() || state_ != PLAYING) break;
+      if (playingTrack_ != 0 && parameter != playingTrack_) break;
+      state_ = STOPPED;
+      finishPending_ = true;
+      finishEvents_++;
+      advancing_ = true;
+      finishTime_ = now;
+
+      // Armed: play the next track now, the queue is empty (not busy)
+      if (armedTrack_ != 0 && (!sentAny_ || now - lastFrameTime_ >= FRAME_GAP_MS)) {
+        armedStarted_ = armedTrack_;
+        armedTrack_ = 0;
+        trackChanges_++;
+        armedAdvances_++;
+        writeFrame(0x03, armedStarted_);
+      }
+      break;
+    }
+    case 0x3B:    // card removed
+      state_ = STOPPED;
+      break;
+    case 0x40:    // error
+      lastError_ = parameter;
+      break;
+  }
+}
+
+bool DFPlayerScheduler::takeTrackFinished(uint16_t& track) {
+  if (!finishPending_) return false;
+  finishPending_ = false;
+  track = finishedTrack_;
+  return true;
+}
+
+bool DFPlayerScheduler::takeArmedStart(uint16_t& track) {
+  if (armedStarted_ == 0) return false;
+  track = armedStarted_;
+  armedStarted_ = 0;
+  return true;
+}
+
+float DFPlayerScheduler::transitionLoopRate() const {
+  if (busyMillis_ == 0) return 0.0f;
+  return busyIterations_ * 1000.0f / busyMillis_;
+}
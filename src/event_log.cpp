@@ -0,0 +1,205 @@
+/*
+   ESP32 RFID Jukebox - deferred event log
+*/
+
+#include "event_log.h"
+#include <MFRC522.h>
+
+EventLog eventLog;
+
+// Text of each message. %d prints the next argument (a, then b, then c),
+// %t the song info of a, %u the UID packed by writeUid(), %s the MFRC522
+// status name of a.
+static const char* const MESSAGES[LOG_MESSAGE_COUNT] = {
+  "LOG: %d messages lost",
+  "CARD: Card detected, UID%u",
+  "CARD: Cached number %d",
+  "CARD: Number %d",
+  "CARD: Authentication failed: %s",
+  "CARD: Reading failed: %s",
+  "CARD: No number found on card",
+  "CARD: No valid card record",
+  "CARD: Invalid card number %d",
+  "PLAY: Playing from folder %d (volume %d)",
+  "PLAY: Playing track #%d - %t (volume %d)",
+  "PLAY: Track #%d finished",
+  "PAUSE: Paused",
+  "PLAY: Playing",
+  "NEXT: Next track",
+  "PREVIOUS: Previous track",
+  "SHUFFLE: Created new shuffle order (seed %d)",
+  "SHUFFLE: Completed all tracks, starting cycle %d",
+  "SHUFFLE: Custom shuffle mode activated - True random playback",
+  "SHUFFLE: Playing track #%d (%d/%d) - %t",
+  "SHUFFLE: Song finished, playing next track",
+  "SHUFFLE: Exiting shuffle mode - Playing specific track",
+  "QUEUE: Added track #%d - %t (%d queued)",
+  "QUEUE: Play queue full, track not added",
+  "QUEUE: Playing track #%d - %t (%d left)",
+  "QUEUE: Card queue mode ON - cards tapped while playing are queued",
+  "QUEUE: Card queue mode OFF - cards play immediately",
+  "BUTTON: Hold the reset button to restart",
+};
+
+static const char LEVEL_NAMES[] = "EWID";
+
+// Print into a fixed line buffer, cutting off what does not fit
+class LinePrint : public Print {
+ public:
+  LinePrint(char* line, size_t size) : line_(line), size_(size) {}
+  size_t write(uint8_t c) override {
+    if (length_ + 1 >= size_) return 0;
+    line_[length_++] = c;
+    line_[length_] = '\0';
+    return 1;
+  }
+  using Print::write;
+  size_t length() const { return length_; }
+
+ private:
+  char* line_;
+  size_t size_;
+  size_t length_ = 0;
+};
+
+void EventLog::write(uint8_t level, LogMessage message, int32_t a, int32_t b, int16_t c) {
+  uint32_t seq = next_.fetch_add(1, std::memory_order_relaxed);
+  Record& record = records_[seq & (CAPACITY - 1)];
+
+  record.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  record.ms = millis();
+  record.message = message;
+  record.level = level;
+  record.a = a;
+  record.b = b;
+  record.c = c;
+
+  record.seq.store(seq, std::memory_order_release);
+}
+
+void EventLog::writeUid(uint8_t level, LogMessage message, const byte* uid, uint8_t size) {
+  // First 8 bytes, big-endian in a and b; c keeps the full size
+  uint32_t words[2] = {0, 0};
+  for (uint8_t i = 0; i < size && i < 8; i++) {
+    words[i / 4] |= (uint32_t)uid[i] << (24 - 8 * (i % 4));
+  }
+  write(level, message, (int32_t)words[0], (int32_t)words[1], size);
+}
+
+bool EventLog::read(uint32_t seq, Record& copy) const {
+  const Record& record = records_[seq & (CAPACITY - 1)];
+  if (record.seq.load(std::memory_order_acquire) != seq) return false;
+
+  copy.ms = record.ms;
+  copy.message = record.message;
+  copy.level = record.level;
+  copy.a = record.a;
+  copy.b = record.b;
+  copy.c = record.c;
+
+  // Overwritten while copying: the fields may be half of a newer record
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (record.seq.load(std::memory_order_relaxed) != seq) return false;
+  copy.seq.store(seq, std::memory_order_relaxed);
+  return copy.message < LOG_MESSAGE_COUNT;
+}
+
+size_t EventLog::format(const Record& record, char* line, size_t size, SongCatalogReader& songs) {
+  LinePrint out(line, size);
+  const int32_t args[3] = {record.a, record.b, record.c};
+  uint8_t next = 0;
+
+  for (const char* p = MESSAGES[record.message]; *p; p++) {
+    if (p[0] != '%' || !p[1]) {
+      out.print(*p);
+      continue;
+    }
+    switch (*++p) {
+      case 'd':
+        out.print((long)(next < 3 ? args[next++] : 0));
+        break;
+      case 't':
+        songs.print(out, record.a);
+        break;
+      case 's':
+        out.print(MFRC522::GetStatusCodeName((MFRC522::StatusCode)record.a));
+        break;
+      case 'u':
+        for (uint8_t i = 0; i < record.c && i < 8; i++) {
+          uint8_t value = (uint32_t)args[i / 4] >> (24 - 8 * (i % 4));
+          out.print(value < 0x10 ? " 0" : " ");
+          out.print(value, HEX);
+        }
+        break;
+      default:
+        out.print(*p);
+        break;
+    }
+  }
+  return out.length();
+}
+
+uint16_t EventLog::drain(Print& out, size_t budget) {
+  uint16_t printed = 0;
+  char line[MAX_LINE];
+
+  for (;;) {
+    uint32_t next = next_.load(std::memory_order_acquire);
+    if (next - drainNext_ > CAPACITY) {
+      // Lapped: the oldest records were overwritten before we got to them
+      uint32_t oldest = next - CAPACITY;
+      dropped_ += oldest - drainNext_;
+      droppedUnreported_ += oldest - drainNext_;
+      drainNext_ = oldest;
+    }
+
+    Record record;
+    if (droppedUnreported_ > 0) {
+      record.message = LOG_DROPPED;
+      record.level = LOG_LEVEL_WARN;
+      record.a = droppedUnreported_;
+    } else if (drainNext_ == next || !read(drainNext_, record)) {
+      break;                       // all printed, or the next one is still being written
+    }
+
+    size_t length = format(record, line, sizeof(line), drainSongs_);
+    if (length + 2 > budget) break;
+    out.write((const uint8_t*)line, length);
+    out.println();
+    budget -= length + 2;
+    printed++;
+
+    if (record.message == LOG_DROPPED) {
+      droppedUnreported_ = 0;
+    } else {
+      drainNext_++;
+      drained_++;
+    }
+  }
+  return printed;
+}
+
+uint32_t EventLog::printSince(Print& out, uint32_t since) const {
+  uint32_t next = next_.load(std::memory_order_acquire);
+  uint32_t oldest = next > CAPACITY ? next - CAPACITY : 1;
+  if (since < oldest) since = oldest;
+
+  char line[MAX_LINE];
+  SongCatalogReader songs;                     // opened by the first %t record
+  for (; since < next; since++) {
+    Record record;
+    if (!read(since, record)) continue;        // overwritten meanwhile
+    format(record, line, sizeof(line), songs);
+    out.print(since);
+    out.print(' ');
+    out.print(record.ms);
+    out.print(' ');
+    out.print(LEVEL_NAMES[record.level & 3]);
+    out.print(' ');
+    out.print(line);
+    out.print('\n');
+  }
+  return next;
+}
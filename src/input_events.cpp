@@ -0,0 +1,76 @@
+/*
+   ESP32 RFID Jukebox - input events
+*/
+
+#include "input_events.h"
+
+#ifdef JUKEBOX_NATIVE
+
+void InputEventQueue::begin() {
+  head_ = 0;
+  count_ = 0;
+}
+
+bool InputEventQueue::push(InputEventType type, int32_t value, uint32_t sinceUs) {
+  if (count_ >= CAPACITY) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  ring_[(head_ + count_) % CAPACITY] = {type, value, sinceUs};
+  count_++;
+  pushed_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool InputEventQueue::pop(InputEvent& event) {
+  if (count_ == 0) return false;
+  event = ring_[head_];
+  head_ = (head_ + 1) % CAPACITY;
+  count_--;
+  uint32_t latency = (uint32_t)micros() - event.queuedUs;
+  if (latency > maxLatencyUs_) maxLatencyUs_ = latency;
+  return true;
+}
+
+void InputEventQueue::wait(uint32_t) {
+  // Single-threaded: nothing can arrive while we wait
+}
+
+void InputEventQueue::clear() {
+  head_ = 0;
+  count_ = 0;
+}
+
+#else
+
+void InputEventQueue::begin() {
+  if (!queue_) queue_ = xQueueCreate(CAPACITY, sizeof(InputEvent));
+}
+
+bool InputEventQueue::push(InputEventType type, int32_t value, uint32_t sinceUs) {
+  InputEvent event = {type, value, sinceUs};
+  if (!queue_ || xQueueSend(queue_, &event, 0) != pdTRUE) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  pushed_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool InputEventQueue::pop(InputEvent& event) {
+  if (!queue_ || xQueueReceive(queue_, &event, 0) != pdTRUE) return false;
+  uint32_t latency = (uint32_t)micros() - event.queuedUs;
+  if (latency > maxLatencyUs_) maxLatencyUs_ = latency;
+  return true;
+}
+
+void InputEventQueue::wait(uint32_t waitMs) {
+  InputEvent event;
+  if (queue_) xQueuePeek(queue_, &event, pdMS_TO_TICKS(waitMs));
+}
+
+void InputEventQueue::clear() {
+  if (queue_) xQueueReset(queue_);
+}
+
+#endif
@@ -0,0 +1,181 @@
+/*
+   ESP32 RFID Jukebox - subsystem tasks
+*/
+
+#include "jukebox_tasks.h"
+#include "jukebox.h"
+
+static const JukeboxTaskConfig configs[JUKEBOX_TASK_COUNT] = {
+  // name      core prio stack period
+  {"input",    1,   4,   3072, 100},
+  {"player",   1,   3,   8192, 2},
+  {"rfid",     1,   2,   6144, 10},
+  {"network",  0,   1,   4096, 100},
+  {"log",      0,   1,   3072, 10},
+};
+
+static TaskStats stats[JUKEBOX_TASK_COUNT];
+
+void TaskStats::end() {
+  uint32_t now = micros();
+  uint32_t busy = now - startUs_;
+  windowBusyUs_ += busy;
+  runs_++;
+  if (busy > maxUs_) maxUs_ = busy;
+
+  uint32_t window = now - windowStartUs_;
+  if (window >= WINDOW_US) {
+    load_ = 100.0f * windowBusyUs_ / window;
+    windowStartUs_ = now;
+    windowBusyUs_ = 0;
+  }
+}
+
+static void runStep(JukeboxTask task) {
+  stats[task].begin();
+  switch (task) {
+    case TASK_INPUT:   inputStep();   break;
+    case TASK_PLAYER:  playerStep();  break;
+    case TASK_RFID:    rfidStep();    break;
+    case TASK_NETWORK: networkStep(); break;
+    case TASK_LOG:     logStep();     break;
+    default: break;
+  }
+  stats[task].end();
+}
+
+void runJukeboxStepsOnce() {
+  runStep(TASK_NETWORK);
+  runStep(TASK_INPUT);
+  runStep(TASK_RFID);
+  runStep(TASK_PLAYER);
+  runStep(TASK_LOG);
+}
+
+const JukeboxTaskConfig& taskConfig(JukeboxTask task) {
+  return configs[task];
+}
+
+const TaskStats& taskStats(JukeboxTask task) {
+  return stats[task];
+}
+
+#ifdef JUKEBOX_NATIVE
+
+bool startJukeboxTasks() { return false; }
+bool jukeboxTasksRunning() { return false; }
+void retireLoopTask() {}
+void wakeTaskFromIsr(JukeboxTask) {}
+void lockReader() {}
+void unlockReader() {}
+uint32_t taskStackFree(JukeboxTask) { return 0; }
+
+#else
+
+#include <freertos/semphr.h>
+
+static TaskHandle_t handles[JUKEBOX_TASK_COUNT];
+static SemaphoreHandle_t readerMutex = nullptr;
+static bool tasksRunning = false;
+
+static void subsystemTask(void* parameter) {
+  JukeboxTask task = (JukeboxTask)(uintptr_t)parameter;
+  TickType_t period = pdMS_TO_TICKS(configs[task].periodMs);
+  TickType_t wake = xTaskGetTickCount();
+  for (;;) {
+    runStep(task);
+    if (task == TASK_INPUT) {
+      // Wakes on a button edge, or when a debounce or gesture timer is due
+      uint32_t timeoutMs = buttonInput.nextTimeoutMs();
+      TickType_t ticks = timeoutMs ? pdMS_TO_TICKS(timeoutMs) : period;
+      ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+    } else if (task == TASK_PLAYER) {
+      inputEvents.wait(configs[task].periodMs);  // wakes early on a press or a tap
+    } else if (task == TASK_RFID) {
+      ulTaskNotifyTake(pdTRUE, period);          // wakes early on the RC522 IRQ
+    } else {
+      vTaskDelayUntil(&wake, period);
+    }
+  }
+}
+
+bool startJukeboxTasks() {
+  if (!readerMutex) readerMutex = xSemaphoreCreateMutex();
+  if (!readerMutex) return false;
+
+  for (uint8_t i = 0; i < JUKEBOX_TASK_COUNT; i++) {
+    const JukeboxTaskConfig& config = configs[i];
+    if (xTaskCreatePinnedToCore(subsystemTask, config.name, config.stackBytes,
+                                (void*)(uintptr_t)i, config.priority, &handles[i],
+                                config.core) != pdPASS) {
+      Serial.print(F("TASKS: Could not start "));
+      Serial.print(config.name);
+      Serial.println(F(" task - running everything from loop()"));
+      while (i > 0) vTaskDelete(handles[--i]);
+      return false;
+    }
+  }
+  tasksRunning = true;
+  return true;
+}
+
+bool jukeboxTasksRunning() {
+  return tasksRunning;
+}
+
+void retireLoopTask() {
+  vTaskDelete(NULL);
+}
+
+void IRAM_ATTR wakeTaskFromIsr(JukeboxTask task) {
+  if (!tasksRunning) return;
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(handles[task], &woken);
+  if (woken) portYIELD_FROM_ISR();
+}
+
+void lockReader() {
+  if (readerMutex) xSemaphoreTake(readerMutex, portMAX_DELAY);
+}
+
+void unlockReader() {
+  if (readerMutex) xSemaphoreGive(readerMutex);
+}
+
+uint32_t taskStackFree(JukeboxTask task) {
+  // ESP-IDF counts stack in bytes
+  return tasksRunning ? uxTaskGetStackHighWaterMark(handles[task]) : 0;
+}
+
+#endif
+
+String taskReportLine(JukeboxTask task) {
+  const JukeboxTaskConfig& config = configs[task];
+  const TaskStats& s = stats[task];
+  String line = String(config.name) + " core " + String(config.core) + " prio " + String(config.priority);
+  line += ": " + String(s.load(), 1) + "% CPU, max " + String(s.maxUs()) + " us";
+  uint32_t stackFree = taskStackFree(task);
+  if (stackFree > 0) {
+    line += ", " + String(stackFree) + " of " + String(config.stackBytes) + " B stack free";
+  }
+  return line;
+}
+
+String taskReportJson() {
+  String json = "{\"tasks\":[";
+  for (uint8_t i = 0; i < JUKEBOX_TASK_COUNT; i++) {
+    const JukeboxTaskConfig& config = configs[i];
+    const TaskStats& s = stats[i];
+    if (i > 0) json += ",";
+    json += "{\"name\":\"" + String(config.name) + "\",\"core\":" + String(config.core);
+    json += ",\"priority\":" + String(config.priority) + ",\"stack\":" + String(config.stackBytes);
+    json += ",\"stackFree\":" + String(taskStackFree((JukeboxTask)i));
+    json += ",\"cpu\":" + String(s.load(), 1) + ",\"maxUs\":" + String(s.maxUs());
+    json += ",\"runs\":" + String(s.runs()) + "}";
+  }
+  json += "],\"running\":" + String(jukeboxTasksRunning() ? "true" : "false");
+  json += ",\"inputEvents\":{\"pushed\":" + String(inputEvents.pushed());
+  json += ",\"dropped\":" + String(inputEvents.dropped());
+  json += ",\"maxLatencyUs\":" + String(inputEvents.maxLatencyUs()) + "}}";
+  return json;
+}
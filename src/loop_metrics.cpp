@@ -0,0 +1,211 @@
+/*
+   ESP32 RFID Jukebox - step timing histograms for /api/metrics
+*/
+
+#include "loop_metrics.h"
+#include "event_log.h"
+#include "jukebox.h"
+
+const uint32_t StepHistogram::BOUNDS_US[BUCKETS] = {
+  10, 50, 100, 500, 1000, 5000, 10000, 50000, 100000, 500000
+};
+
+// Bucket bounds as Prometheus le labels, in seconds
+static const char* const BOUND_LABELS[StepHistogram::BUCKETS] = {
+  "0.00001", "0.00005", "0.0001", "0.0005", "0.001", "0.005", "0.01", "0.05", "0.1", "0.5"
+};
+
+static const char* const STEP_NAMES[METRIC_STEP_COUNT] = {
+  "buttons", "rfid", "serial", "autoprogression", "wifi", "dfplayer_tx", "dfplayer_rx"
+};
+
+static StepHistogram histograms[METRIC_STEP_COUNT];
+
+// Player passes
+static const uint32_t RATE_WINDOW_US = 1000000;
+static StepHistogram gaps;
+static uint32_t passes = 0;
+static uint32_t lastPassUs = 0;
+static uint32_t maxStallUs = 0;
+static uint32_t windowStartUs = 0;
+static uint32_t windowPasses = 0;
+static float passRate = 0;
+
+void StepHistogram::record(uint32_t us) {
+  uint8_t i = 0;
+  while (i < BUCKETS && us > BOUNDS_US[i]) i++;
+  if (i < BUCKETS) buckets_[i]++;
+  count_++;
+  sumUs_ += us;
+  if (us > maxUs_) maxUs_ = us;
+}
+
+void recordStep(MetricStep step, uint32_t cycles) {
+  histograms[step].record(cycles / ESP.getCpuFreqMHz());
+}
+
+const StepHistogram& stepHistogram(MetricStep step) {
+  return histograms[step];
+}
+
+void countLoopPass() {
+  uint32_t now = micros();
+  if (passes > 0) {
+    uint32_t gap = now - lastPassUs;
+    gaps.record(gap);
+    if (gap > maxStallUs) maxStallUs = gap;
+  }
+  lastPassUs = now;
+  passes++;
+
+  windowPasses++;
+  if (now - windowStartUs >= RATE_WINDOW_US) {
+    passRate = windowPasses * 1000000.0f / (now - windowStartUs);
+    windowStartUs = now;
+    windowPasses = 0;
+  }
+}
+
+float loopFrequency() {
+  return passRate;
+}
+
+uint32_t maxLoopStallUs() {
+  return maxStallUs;
+}
+
+const StepHistogram& loopGapHistogram() {
+  return gaps;
+}
+
+static void writeHeader(Print& out, const char* name, const char* type, const char* help) {
+  out.print("# HELP ");
+  out.print(name);
+  out.print(' ');
+  out.print(help);
+  out.print("\n# TYPE ");
+  out.print(name);
+  out.print(' ');
+  out.print(type);
+  out.print('\n');
+}
+
+// A metric without labels; the caller prints the value and the newline
+static void writeSingle(Print& out, const char* name, const char* type, const char* help) {
+  writeHeader(out, name, type, help);
+  out.print(name);
+  out.print(' ');
+}
+
+// name_bucket{step="rfid",le="0.001"} 12 ... name_sum, name_count; step may be null
+static void writeSeriesStart(Print& out, const char* name, const char* suffix, const char* step, const char* le) {
+  out.print(name);
+  out.print(suffix);
+  if (!step && !le) {
+    out.print(' ');
+    return;
+  }
+  out.print('{');
+  if (step) {
+    out.print("step=\"");
+    out.print(step);
+    out.print('"');
+    if (le) out.print(',');
+  }
+  if (le) {
+    out.print("le=\"");
+    out.print(le);
+    out.print('"');
+  }
+  out.print("} ");
+}
+
+static void writeHistogram(Print& out, const char* name, const char* step, const StepHistogram& h) {
+  uint32_t count = h.count();      // read once: a sample may land while we print
+  uint32_t cumulative = 0;
+  for (uint8_t i = 0; i < StepHistogram::BUCKETS; i++) {
+    cumulative += h.bucket(i);
+    writeSeriesStart(out, name, "_bucket", step, BOUND_LABELS[i]);
+    out.print(cumulative < count ? cumulative : count);
+    out.print('\n');
+  }
+  writeSeriesStart(out, name, "_bucket", step, "+Inf");
+  out.print(count);
+  out.print('\n');
+  writeSeriesStart(out, name, "_sum", step, nullptr);
+  out.print(h.sumUs() / 1e6, 6);
+  out.print('\n');
+  writeSeriesStart(out, name, "_count", step, nullptr);
+  out.print(count);
+  out.print('\n');
+}
+
+static void writeCounter(Print& out, const char* name, const char* help, uint32_t value) {
+  writeSingle(out, name, "counter", help);
+  out.print(value);
+  out.print('\n');
+}
+
+// The counters the serial 's' command prints, kept out of the web reply
+static void writeCounters(Print& out) {
+  writeCounter(out, "jukebox_dfplayer_frames_received_total", "DFPlayer frames received", playerScheduler.framesReceived());
+  writeCounter(out, "jukebox_dfplayer_frames_sent_total", "DFPlayer frames sent", playerScheduler.framesSent());
+  writeCounter(out, "jukebox_dfplayer_receive_errors_total", "DFPlayer frames that failed to parse", playerScheduler.receiveErrors());
+  writeCounter(out, "jukebox_tracks_finished_total", "Track finished events", playerScheduler.finishEvents());
+  writeCounter(out, "jukebox_track_advances_total", "Automatic track advances", playerScheduler.advances());
+  writeCounter(out, "jukebox_track_advances_armed_total", "Track advances sent by the armed start", playerScheduler.armedAdvances());
+  writeCounter(out, "jukebox_card_cache_hits_total", "Card UID lookups found in the cache", cardCache.hits());
+  writeCounter(out, "jukebox_card_cache_misses_total", "Card UID lookups that had to read the card", cardCache.misses());
+  writeCounter(out, "jukebox_web_commands_accepted_total", "Web commands queued", webCommands.accepted());
+  writeCounter(out, "jukebox_web_commands_dropped_total", "Web commands rejected with a full queue", webCommands.dropped());
+  writeCounter(out, "jukebox_web_responses_stored_total", "Web command results stored", webResponses.stored());
+  writeCounter(out, "jukebox_web_responses_truncated_total", "Web command results cut off at the slot size", webResponses.truncated());
+  writeCounter(out, "jukebox_web_responses_expired_total", "Web command results read after their slot was reused", webResponses.expired());
+  writeCounter(out, "jukebox_state_events_total", "State events sent to web pages", playerEvents.stateEvents());
+  writeCounter(out, "jukebox_result_events_total", "Result events sent to web pages", playerEvents.resultEvents());
+  writeCounter(out, "jukebox_input_events_total", "Input events queued for the player task", inputEvents.pushed());
+  writeCounter(out, "jukebox_input_events_dropped_total", "Input events dropped with a full queue", inputEvents.dropped());
+  writeCounter(out, "jukebox_console_lines_dropped_total", "Console lines dropped for being too long", serialLine.dropped());
+}
+
+void writeMetrics(Print& out) {
+  writeHeader(out, "jukebox_step_duration_seconds", "histogram", "Time per call of each jukebox step");
+  for (uint8_t step = 0; step < METRIC_STEP_COUNT; step++) {
+    writeHistogram(out, "jukebox_step_duration_seconds", STEP_NAMES[step], histograms[step]);
+  }
+
+  writeHeader(out, "jukebox_step_max_seconds", "gauge", "Longest single call of each jukebox step");
+  for (uint8_t step = 0; step < METRIC_STEP_COUNT; step++) {
+    out.print("jukebox_step_max_seconds{step=\"");
+    out.print(STEP_NAMES[step]);
+    out.print("\"} ");
+    out.print(histograms[step].maxUs() / 1e6, 6);
+    out.print('\n');
+  }
+
+  writeHeader(out, "jukebox_loop_gap_seconds", "histogram", "Time between two player task passes");
+  writeHistogram(out, "jukebox_loop_gap_seconds", nullptr, gaps);
+
+  writeSingle(out, "jukebox_loop_passes_total", "counter", "Player task passes");
+  out.print(passes);
+  out.print('\n');
+  writeSingle(out, "jukebox_loop_frequency_hz", "gauge", "Player task passes per second, last second");
+  out.print(passRate, 1);
+  out.print('\n');
+  writeSingle(out, "jukebox_loop_stall_max_seconds", "gauge", "Longest gap between two player task passes");
+  out.print(maxStallUs / 1e6, 6);
+  out.print('\n');
+  writeSingle(out, "jukebox_free_heap_bytes", "gauge", "Free heap");
+  out.print(ESP.getFreeHeap());
+  out.print('\n');
+  writeSingle(out, "jukebox_log_records_total", "counter", "Event log records written");
+  out.print(eventLog.written());
+  out.print('\n');
+  writeSingle(out, "jukebox_log_lost_total", "counter", "Event log records overwritten before they were printed");
+  out.print(eventLog.dropped());
+  out.print('\n');
+  writeSingle(out, "jukebox_uptime_seconds", "gauge", "Time since boot");
+  out.print(millis() / 1000);
+  out.print('\n');
+  writeCounters(out);
+}
@@ -18,7 +18,7 @@
    SCK                    GPIO 18      SPI clock
    MOSI                   GPIO 23      SPI data input
    MISO                   GPIO 19      SPI master-in-slave-out
-   IRQ                    Don't connect Interrupt pin
+   IRQ                    GPIO 4       Card detect interrupt (optional)
    GND                    GND          Ground
    RST                    GPIO 21      Reset pin
    3.3V                   3.3V         Power supply (2.5-3.3V)
@@ -54,23 +54,15 @@
 #include <HardwareSerial.h>
 #include <DFRobotDFPlayerMini.h>
 #include <WiFi.h>
-#include <ESPAsyncWebServer.h>
 #include <SPIFFS.h>
-
-// ESP32 Pin definitions for RC522 (same as RFID programmer)
-#define RST_PIN         21          // Reset pin
-#define SS_PIN          5           // SDA (SS) pin
-
-// ESP32 Pin definitions for buttons (using safe GPIO pins)
-#define RESET_BUTTON    32          // Reset button (safe pin)
-#define PREV_BUTTON     33          // Previous track button (safe pin)
-#define NEXT_BUTTON     25          // Next track button (safe pin)
-#define PLAY_PAUSE_BUTTON 26        // Play/pause button (safe pin)
-#define SHUFFLE_BUTTON  27          // Shuffle button (safe pin)
-
-// Volume control constants
-#define MAX_VOLUME      30          // Maximum volume
-#define MIN_VOLUME      0           // Minimum volume
+#include "jukebox.h"
+#include "tap_trace.h"
+#include "dfplayer_scheduler.h"
+#include "web_command_queue.h"
+#include "card_cache.h"
+#include "song_catalog.h"
+#include "web_assets.h"
+#include "card_batch.h"
 
 // WiFi credentials for web interface
 // TODO: Replace with your actual WiFi credentials
@@ -82,47 +74,39 @@ HardwareSerial dfPlayerSerial(2);   // Use Serial2 (GPIO16=RX, GPIO17=TX)
 
 // Create instances
 MFRC522 mfrc522(SS_PIN, RST_PIN);       // Create MFRC522 instance
+RfidDetector rfidDetector;              // Card detection: IRQ line or polling
 DFRobotDFPlayerMini myDFPlayer;         // Create DFPlayer instance
+DFPlayerScheduler playerScheduler;      // Non-blocking playback commands
 
-// Web server for WiFi commands
-AsyncWebServer server(80);              // Web server on port 80
-
-// WiFi command response buffer
-String wifiResponse = "";               // Buffer for web interface responses
-
-// Auto-progression function
-void checkAutoProgression();
+// Web commands and their results
+WebCommandQueue webCommands;            // Web handlers -> loop() commands
+WebResponseRing webResponses;           // Result of each ticket, read by /response
+PlayerEvents playerEvents;              // Results and state pushed to /events
+CardCache cardCache;                    // UID -> card number of known cards
+InputEventQueue inputEvents;            // Buttons and cards -> player task
 
 // Custom shuffle functions
-void createShufflePlaylist();
-void playNextShuffleTrack();
-void startCustomShuffle();
+void newShuffleOrder();
+void startNextShuffleCycle();
 
 // Function prototypes
-void handleButtons();
-void handleRFID();
-void handleSerialCommands();
-void performSystemCheck();
-void playCardNumber(int number);
-String getSongInfo(int trackNumber);
 boolean TimePeriodIsOver(unsigned long &startOfPeriod, unsigned long TimePeriod);
 
 // WiFi functions
-void setupWiFi();
-void handleWiFiConnection();
 bool wifiSetupComplete = false;
 
-// WiFi web interface functions
-void setupWebServer();
-void handleWebCommand(char command);
-String processCommand(char command);
-String processJukeboxCommand();
-
 // RFID Programming functions
 void programmerMode();
+void programmerInput(const char* line);
 void autoModus();
 void manualModus();
+void manualWrite();
+void batchModus();
 void readModus();
+void haltProgrammerCard();
+void releaseProgrammerCard();
+bool writeCardNumber(MFRC522::PICC_Type piccType, int number);
+bool verifyCardNumber(MFRC522::PICC_Type piccType, int number);
 
 // Player state variables
 boolean isPlaying = false;
@@ -133,9 +117,12 @@ int currentSong = 0;
 
 // System mode variables
 bool jukeboxMode = true;            // true = jukebox, false = programmer
-String programmerModeType = "";     // "auto", "manual", "read"
-int programmerCurrentNumber = 1;    // For auto programming mode
-bool programmerAutoReady = false;   // Flag for auto mode ready state
+ProgrammerState programmerState = PROGRAM_IDLE;  // Programming mode step, see programmerMode()
+int programmerCurrentNumber = 1;    // Next number in auto mode, typed number in manual mode
+MFRC522::PICC_Type programmerCardType;        // Card waiting for its number (manual mode)
+unsigned long programmerCardTime = 0;         // When that card was selected
+unsigned long programmerNumberTimeout = 30000;  // Manual mode: wait for a number (30 seconds)
+CommandLine serialLine;             // Console input, a line at a time
 
 // Timing variables
 unsigned long myBlinktimer;
@@ -155,23 +142,23 @@ unsigned long wifiStartTime = 0;      // WiFi connection start time
 unsigned long wifiTimeout = 10000;    // WiFi connection timeout (10 seconds)
 bool wifiSetupStarted = false;         // Track if WiFi setup has started
 
-// Button state variables
-bool previousNextButtonState = HIGH;
-bool previousPrevButtonState = HIGH;
-bool previousPlayPauseButtonState = HIGH;
-bool previousShuffleButtonState = HIGH;
+// Buttons
+ButtonInput buttonInput;                   // Interrupt-driven buttons, debounce and gestures
+
+// RFID re-read hold-off
+unsigned long lastCardReadTime = 0;        // Last card read
+unsigned long cardReadHoldoff = 250;       // Pause polling after a read
 
 // Custom shuffle variables
 bool customShuffleMode = false;        // Track if custom shuffle is active
-int shufflePlaylist[41];               // Array to hold shuffled track numbers
+ShuffleOrder shuffleOrder;             // Computed shuffle order, no per-track storage
 int shuffleIndex = 0;                  // Current position in shuffle playlist
-int shuffleSize = 41;                  // Number of tracks in shuffle
+int shuffleSize = 0;                   // Number of tracks in shuffle (catalog size)
 
-// Auto-progression tracking for shuffle mode
-unsigned long lastStateCheck = 0;      // Timer for checking DFPlayer state
-unsigned long stateCheckInterval = 500; // Check state every second
-uint8_t previousDFPlayerState = 0;     // Track previous state to handle delayed state updates
-bool waitingForStateUpdate = false;    // Flag to handle the delayed state issue
+// Play queue
+PlayQueue playQueue;                   // Tracks to play after the current one
+bool cardQueueMode = false;            // Song cards join the queue while playing
+bool armedFromQueue = false;           // Armed track is the queue head (else shuffle)
 
 //*****************************************************************************
 void setup() {
@@ -183,13 +170,32 @@ void setup() {
   
   Serial.println(F("\n=== ESP32 RFID Jukebox Starting ==="));
   Serial.println(F("Step 1: Serial initialized"));
+  inputEvents.begin();
   
   // Initialize SPIFFS for web interface files
   if (!SPIFFS.begin(true)) {
     Serial.println(F("ERROR: SPIFFS mount failed"));
   } else {
     Serial.println(F("Step 2: SPIFFS initialized"));
+    cardCache.begin(SPIFFS);
+    Serial.print(F("CACHE: "));
+    Serial.print(cardCache.size());
+    Serial.println(F(" known cards loaded"));
+    beginSongCatalog(SPIFFS);
+    Serial.print(F("WEB: "));
+    if (beginWebAssets(SPIFFS)) {
+      Serial.print(webAssetCount());
+      Serial.println(F(" compressed UI files"));
+    } else {
+      Serial.println(F("no asset index, serving /index.html uncompressed"));
+    }
   }
+
+  // Track count comes from the song catalog
+  shuffleSize = songCount();
+  Serial.print(F("CATALOG: "));
+  Serial.print(shuffleSize);
+  Serial.println(songCatalogFromFile() ? F(" songs (SPIFFS catalog)") : F(" songs (built-in)"));
   
   // Initialize SPI first
   SPI.begin();                              // Init SPI bus
@@ -199,14 +205,19 @@ void setup() {
   // Initialize RFID
   mfrc522.PCD_Init();                       // Init MFRC522 card
   mfrc522.PCD_SetAntennaGain(mfrc522.RxGain_max);
+  rfidDetector.begin(mfrc522, RFID_IRQ_PIN, RFID_DETECT_MODE);
   Serial.println(F("Step 4: RFID initialized"));
+  Serial.print(F("RFID: Card detection by "));
+  Serial.print(RfidDetector::modeName(rfidDetector.mode()));
+  Serial.println(rfidDetector.irqWorks() ? F("") : F(" (no signal on the IRQ pin)"));
   
-  // Initialize button pins with internal pull-up resistors
-  pinMode(PLAY_PAUSE_BUTTON, INPUT_PULLUP);
-  pinMode(SHUFFLE_BUTTON, INPUT_PULLUP);
-  pinMode(PREV_BUTTON, INPUT_PULLUP);
-  pinMode(NEXT_BUTTON, INPUT_PULLUP);
-  pinMode(RESET_BUTTON, INPUT_PULLUP);
+  // Button pins with internal pull-up resistors and edge interrupts
+  buttonInput.begin(inputEvents);
+  buttonInput.add(PLAY_PAUSE_BUTTON, BUTTON_PLAY_PAUSE);
+  buttonInput.add(SHUFFLE_BUTTON, BUTTON_SHUFFLE, ButtonInput::DOUBLE);  // double: card queue mode
+  buttonInput.add(PREV_BUTTON, BUTTON_PREVIOUS, ButtonInput::LONG | ButtonInput::REPEAT);  // hold: skip back
+  buttonInput.add(NEXT_BUTTON, BUTTON_NEXT, ButtonInput::LONG | ButtonInput::REPEAT);      // hold: fast skip
+  buttonInput.add(RESET_BUTTON, BUTTON_RESET, ButtonInput::LONG);        // hold: restart
   Serial.println(F("Step 5: Buttons initialized"));
 
   // Initialize DFPlayer (this might be the problem)
@@ -228,6 +239,12 @@ void setup() {
     Serial.print(F("VOLUME: Volume set to: "));
     Serial.println(currentVolume);
   }
+  playerScheduler.begin(dfPlayerSerial);
+
+  // Volume, track and shuffle position from before the restart
+  if (!resumePlayerState()) {
+    Serial.println(F("RESUME: No saved player state"));
+  }
   
   // Start WiFi connection in non-blocking mode
   Serial.println(F("Step 7: Starting WiFi connection (non-blocking)..."));
@@ -245,93 +262,179 @@ void setup() {
   Serial.println(F("\nPROGRAMMING: Type 'program' to enter card programming mode"));
   Serial.println(F("COMMANDS: l=song list, v=volume, +=vol up, -=vol down, s=status"));
   Serial.println(F("WEB: Web Interface will be available at http://192.168.1.251/ once WiFi connects"));
+
+  // Hand the subsystems over to their own tasks
+  if (startJukeboxTasks()) {
+    Serial.println(F("TASKS: input, player, rfid (core 1), network and log (core 0) running"));
+  }
 }
 
 //*****************************************************************************
 void loop() {
-  // Handle WiFi connection in background
-  if (!wifiSetupComplete) {
-    handleWiFiConnection();
+  // The subsystem tasks do the work; without them, run their steps in turn
+  if (jukeboxTasksRunning()) {
+    retireLoopTask();
+  } else {
+    runJukeboxStepsOnce();
   }
+}
+
+//*****************************************************************************
+// Subsystem steps - one run of each task (see jukebox_tasks.h)
+//*****************************************************************************
+
+void inputStep() {
+  if (jukeboxMode) handleButtons();
+}
+
+void rfidStep() {
+  // Programmer mode has the reader to itself
+  lockReader();
+  if (jukeboxMode) handleRFID();
+  unlockReader();
+}
+
+void playerStep() {
+  countLoopPass();
+
+  // Send any DFPlayer commands that are due
+  playerScheduler.update();
+
+  // Book an armed track the update just started, before a command in this
+  // pass can stop or replace it
+  announceArmedTrack();
+
+  // Execute commands queued by the web server
+  handleWebCommands();
+
+  // Console input, in either mode
+  handleSerialCommands();
   
   if (jukeboxMode) {
     // Jukebox mode - normal operation
-    handleButtons();
-    handleRFID();
-    handleSerialCommands();
+    handleInputEvents();
     checkAutoProgression();  // Check for automatic song progression
     // performSystemCheck();
   } else {
-    // Programming mode - RFID card programming
+    // Programming mode - RFID card programming. Presses and taps are not
+    // acted on here; left queued they would wake the player task at once
+    // on every wait() and replay when jukebox mode comes back.
+    inputEvents.clear();
+    lockReader();
     programmerMode();
+    unlockReader();
   }
+
+  // Push player state changes to connected web pages
+  playerEvents.update();
+
+  // Save volume, track and shuffle position once they settle
+  playerStateStore.update();
+}
+
+void networkStep() {
+  // Handle WiFi connection in background
+  if (!wifiSetupComplete) {
+    handleWiFiConnection();
+  }
+}
+
+void logStep() {
+  // Only what the TX FIFO takes right now, so the log never waits on the UART
+  eventLog.drain(Serial, Serial.availableForWrite());
 }
 
 //*****************************************************************************
+// Debounce button edges and turn them into input events (see button_input.h)
 void handleButtons() {
-  // Read current button states
-  bool currentNextButtonState = digitalRead(NEXT_BUTTON);
-  bool currentPrevButtonState = digitalRead(PREV_BUTTON);
-  bool currentPlayPauseButtonState = digitalRead(PLAY_PAUSE_BUTTON);
-  bool currentShuffleButtonState = digitalRead(SHUFFLE_BUTTON);
-  bool currentResetButtonState = digitalRead(RESET_BUTTON);
-
-  // Check for falling edge on play/pause button
-  if (currentPlayPauseButtonState == LOW && previousPlayPauseButtonState == HIGH) {
-    if (isPlaying) {
-      myDFPlayer.pause();
-      isPlaying = false;
-      Serial.println("PAUSE: Paused");
+  METRIC_TIMER(METRIC_BUTTONS);
+  buttonInput.update();
+}
+
+//*****************************************************************************
+// Button presses and card reads, on the player task
+void handleInputEvents() {
+  InputEvent event;
+  while (inputEvents.pop(event)) {
+    if (event.type == INPUT_BUTTON) {
+      handleButtonPress(eventButton(event.value), eventGesture(event.value));
+      buttonInput.recordLatency(micros() - event.queuedUs);
     } else {
-      myDFPlayer.start();
-      isPlaying = true;
-      Serial.println("PLAY: Playing");
+      playCardNumber(event.value);
     }
-    delay(50); // Debounce delay
   }
+}
 
-  // Check for falling edge on shuffle button
-  if (currentShuffleButtonState == LOW && previousShuffleButtonState == HIGH) {
-    startCustomShuffle();
-    delay(50); // Debounce delay
-  }
+void handleButtonPress(InputButton button, ButtonGesture gesture) {
+  switch (button) {
+    case BUTTON_PLAY_PAUSE:
+      if (isPlaying) {
+        playerScheduler.pause();
+        isPlaying = false;
+        LOG_INFO(LOG_PLAY_PAUSED);
+      } else {
+        playerScheduler.start();
+        isPlaying = true;
+        LOG_INFO(LOG_PLAY_RESUMED);
+      }
+      break;
 
-  // Check for falling edge on next button
-  if (currentNextButtonState == LOW && previousNextButtonState == HIGH) {
-    if (customShuffleMode) {
-      playNextShuffleTrack();
-    } else {
-      myDFPlayer.next();
-      currentSong = currentSong + 1;
-      Serial.println("NEXT: Next track");
-    }
-    delay(50); // Debounce delay
-  }
+    case BUTTON_SHUFFLE:
+      if (gesture == GESTURE_DOUBLE) {
+        cardQueueMode = !cardQueueMode;
+        LOG_INFO(cardQueueMode ? LOG_QUEUE_MODE_ON : LOG_QUEUE_MODE_OFF);
+      } else {
+        startCustomShuffle();
+      }
+      break;
 
-  // Check for falling edge on prev button
-  if (currentPrevButtonState == LOW && previousPrevButtonState == HIGH) {
-    myDFPlayer.previous();
-    currentSong = currentSong - 1;
-    Serial.println("PREVIOUS: Previous track");
-    delay(50); // Debounce delay
-  }
+    case BUTTON_NEXT:
+      if (playQueue.size() > 0) {
+        playQueuedTrack();
+      } else if (customShuffleMode) {
+        playNextShuffleTrack();
+      } else {
+        playerScheduler.next();
+        currentSong = currentSong + 1;
+        LOG_INFO(LOG_PLAY_NEXT);
+      }
+      break;
 
-  // Check for reset button
-  if (currentResetButtonState == LOW) {
-    Serial.println("Reset button pressed - Restarting ESP32...");
-    delay(1000);
-    ESP.restart(); // ESP32 restart function
-  }
+    case BUTTON_PREVIOUS:
+      playerScheduler.previous();
+      currentSong = currentSong - 1;
+      LOG_INFO(LOG_PLAY_PREVIOUS);
+      break;
 
-  // Update previous button states
-  previousNextButtonState = currentNextButtonState;
-  previousPrevButtonState = currentPrevButtonState;
-  previousPlayPauseButtonState = currentPlayPauseButtonState;
-  previousShuffleButtonState = currentShuffleButtonState;
+    case BUTTON_RESET:
+      if (gesture == GESTURE_LONG) {
+        Serial.println("Reset button held - Restarting ESP32...");
+        playerStateStore.flush();
+        delay(100);  // let the message out
+        ESP.restart();
+      } else {
+        LOG_INFO(LOG_BUTTON_HOLD_RESET);
+      }
+      break;
+  }
 }
 
 //*****************************************************************************
 void handleRFID() {
+  METRIC_TIMER(METRIC_RFID);
+  // Hold off re-reading right after a card was handled
+  if (millis() - lastCardReadTime < cardReadHoldoff) return;
+
+  // Check if a new card is present on the sensor/reader (polled or by IRQ)
+  if (rfidDetector.cardPresent()) {
+    TAP_TRACE(TAP_DETECT);
+    readDetectedCard();
+    rfidDetector.cardDone();  // drop interrupts raised while the card was read
+  }
+}
+
+// Select and read the card handleRFID() detected
+void readDetectedCard() {
   // Prepare key - all keys are set to FFFFFFFFFFFFh at chip delivery from the factory
   MFRC522::MIFARE_Key key;
   for (byte i = 0; i < 6; i++) key.keyByte[i] = 0xFF;
@@ -341,78 +444,138 @@ void handleRFID() {
   byte len;
   MFRC522::StatusCode status;
 
-  // Check if a new card is present on the sensor/reader
-  if (mfrc522.PICC_IsNewCardPresent()) {
-    // Select one of the cards
-    if (!mfrc522.PICC_ReadCardSerial()) {
-      return;
-    }
-    
-    Serial.println(F("\nCARD: **Card Detected**"));
-    
-    // Dump some details about the card
-    Serial.print(F("Card UID: "));
-    for (byte i = 0; i < mfrc522.uid.size; i++) {
-      Serial.print(mfrc522.uid.uidByte[i] < 0x10 ? " 0" : " ");
-      Serial.print(mfrc522.uid.uidByte[i], HEX);
-    }
-    Serial.println();
+  // Select one of the cards
+  if (!mfrc522.PICC_ReadCardSerial()) {
+    return;
+  }
+  TAP_TRACE(TAP_SELECT);
+  
+  LOG_INFO_UID(LOG_CARD_DETECTED, mfrc522.uid);
 
-    //-------------------------------------------
-    // Read the number stored on the card
-    Serial.print(F("Reading number: "));
+  // Known card - the UID alone identifies it, skip auth and block read
+  int cachedNumber;
+  if (cardCache.lookup(mfrc522.uid, cachedNumber)) {
+    LOG_DEBUG(LOG_CARD_CACHED, cachedNumber);
+    inputEvents.push(INPUT_CARD, cachedNumber);  // played by the player task
 
-    byte buffer2[18];
-    block = 1;
-    len = 18;
+    lastCardReadTime = millis(); // Prevent rapid re-reading without blocking
+    mfrc522.PICC_HaltA();
+    TAP_TRACE(TAP_DONE);
+    return;
+  }
 
-    // Authenticate using key A
-    status = mfrc522.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, 1, &key, &(mfrc522.uid));
-    if (status != MFRC522::STATUS_OK) {
-      Serial.print(F("Authentication failed: "));
-      Serial.println(mfrc522.GetStatusCodeName(status));
-      return;
-    }
+  //-------------------------------------------
+  // Read the number stored on the card
+  if (usesCardRecord(mfrc522.PICC_GetType(mfrc522.uid.sak))) {
+    readRecordCard();
+    return;
+  }
 
-    // Read the block
-    status = mfrc522.MIFARE_Read(block, buffer2, &len);
-    if (status != MFRC522::STATUS_OK) {
-      Serial.print(F("Reading failed: "));
-      Serial.println(mfrc522.GetStatusCodeName(status));
-      return;
-    }
+  byte buffer2[18];
+  block = 1;
+  len = 18;
 
-    // Convert buffer to string
-    String number = "";
-    for (uint8_t i = 0; i < 16; i++) {
-      if (buffer2[i] != ' ' && buffer2[i] != 0) {
-        number += (char)buffer2[i];
-      }
-    }
-    number.trim();
-    
-    if (number.length() == 0) {
-      Serial.println("No number found on card");
-      mfrc522.PICC_HaltA();
-      mfrc522.PCD_StopCrypto1();
-      return;
-    }
-    
-    Serial.print(number);
-    Serial.print(" -> ");
+  // Authenticate using key A
+  status = mfrc522.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, 1, &key, &(mfrc522.uid));
+  if (status != MFRC522::STATUS_OK) {
+    LOG_WARN(LOG_CARD_AUTH_FAILED, status);
+    return;
+  }
+  TAP_TRACE(TAP_AUTH);
 
-    // Handle playlist cards (negative numbers) and regular song cards
-    playCardNumber(number.toInt());
+  // Read the block
+  status = mfrc522.MIFARE_Read(block, buffer2, &len);
+  if (status != MFRC522::STATUS_OK) {
+    LOG_WARN(LOG_CARD_READ_FAILED, status);
+    return;
+  }
+  TAP_TRACE(TAP_READ);
 
-    Serial.println("**End Reading**");
-    delay(250); // Delay to prevent rapid re-reading
+  // Convert buffer to string
+  String number = "";
+  for (uint8_t i = 0; i < 16; i++) {
+    if (buffer2[i] != ' ' && buffer2[i] != 0) {
+      number += (char)buffer2[i];
+    }
+  }
+  number.trim();
+  TAP_TRACE(TAP_PARSE);
+  
+  if (number.length() == 0) {
+    LOG_WARN(LOG_CARD_EMPTY);
     mfrc522.PICC_HaltA();
     mfrc522.PCD_StopCrypto1();
+    return;
+  }
+  
+  LOG_DEBUG(LOG_CARD_NUMBER, number.toInt());
+
+  // Playlist cards (negative numbers) and song cards are played by the player task
+  inputEvents.push(INPUT_CARD, number.toInt());
+  cardCache.insert(mfrc522.uid, number.toInt());  // after the push: keeps the flash write off the tap latency
+
+  lastCardReadTime = millis(); // Prevent rapid re-reading without blocking
+  mfrc522.PICC_HaltA();
+  mfrc522.PCD_StopCrypto1();
+  TAP_TRACE(TAP_DONE);
+}
+
+// NTAG/Ultralight: one READ without authentication, binary record
+void readRecordCard() {
+  CardRecord record;
+  MFRC522::StatusCode status = readCardRecord(mfrc522, record);
+  TAP_TRACE(TAP_READ);
+  if (status != MFRC522::STATUS_OK) {
+    if (status == MFRC522::STATUS_CRC_WRONG) {
+      LOG_WARN(LOG_CARD_NO_RECORD);
+    } else {
+      LOG_WARN(LOG_CARD_READ_FAILED, status);
+    }
+    mfrc522.PICC_HaltA();
+    return;
   }
+  int number = cardNumber(record);
+  TAP_TRACE(TAP_PARSE);
+
+  LOG_DEBUG(LOG_CARD_NUMBER, number);
+  inputEvents.push(INPUT_CARD, number);
+  cardCache.insert(mfrc522.uid, number);
+
+  lastCardReadTime = millis(); // Prevent rapid re-reading without blocking
+  mfrc522.PICC_HaltA();
+  TAP_TRACE(TAP_DONE);
+}
+
+// Toggle card detection between the IRQ line and polling
+String switchRfidDetectMode() {
+  RfidDetectMode next = rfidDetector.mode() == RFID_DETECT_IRQ ? RFID_DETECT_POLL : RFID_DETECT_IRQ;
+  lockReader();
+  bool switched = rfidDetector.setMode(next);
+  unlockReader();
+  if (!switched) return "RFID: IRQ detection unavailable - no signal on the IRQ pin, still polling";
+  return "RFID: Card detection by " + String(RfidDetector::modeName(next));
+}
+
+// "RFID: IRQ detection, 400 SPI/s, 0.4% CPU, 3 interrupts"
+String rfidDetectReport() {
+  String line = "RFID: " + String(RfidDetector::modeName(rfidDetector.mode())) + " detection, ";
+  line += String(rfidDetector.spiPerSecond(), 0) + " SPI/s, " + String(rfidDetector.cpuPercent(), 1) + "% CPU";
+  if (rfidDetector.mode() == RFID_DETECT_IRQ) line += ", " + String(rfidDetector.interrupts()) + " interrupts";
+  return line;
+}
+
+// "Buttons: 12 presses, 4 long, 1 double; 57 edges, 17 accepted; edge -> action avg 310 us, max 2100 us"
+String buttonReport() {
+  String line = "Buttons: " + String(buttonInput.gestures(GESTURE_PRESS)) + " presses, ";
+  line += String(buttonInput.gestures(GESTURE_LONG)) + " long, " + String(buttonInput.gestures(GESTURE_DOUBLE)) + " double; ";
+  line += String(buttonInput.edges()) + " edges, " + String(buttonInput.accepted()) + " accepted; edge -> action avg ";
+  line += String(buttonInput.averageLatencyUs()) + " us, max " + String(buttonInput.maxLatencyUs()) + " us";
+  return line;
 }
 
 //*****************************************************************************
 void playCardNumber(int number) {
+  TAP_TRACE(TAP_DISPATCH);
   // Handle special playlist cards (negative numbers)
   if (number >= -7 && number <= -1) {
     int folderNumber = abs(number);
@@ -422,202 +585,53 @@ void playCardNumber(int number) {
       startCustomShuffle();
     } else {
       // Play from specific folder
-      myDFPlayer.playLargeFolder(folderNumber, 1);
-      Serial.print("Playing from folder ");
-      Serial.println(folderNumber);
+      playerScheduler.playLargeFolder(folderNumber, 1);
+      TAP_TRACE(TAP_UART);
       isPlaying = true;
+      LOG_INFO(LOG_PLAY_FOLDER, folderNumber, currentVolume);
     }
-    
-    Serial.print(F("Volume: "));
-    Serial.println(currentVolume);
+  }
+  else if (number > 0 && cardQueueMode && isPlaying) {
+    // Card queue mode - line the song up instead of interrupting
+    enqueueTrack(number);
   }
   else if (number > 0) {
     // Regular song card - play specific track number
     // Exit shuffle mode when playing a specific song
     if (customShuffleMode) {
       customShuffleMode = false;
-      waitingForStateUpdate = false;  // Reset auto-progression tracking
-      Serial.println("SHUFFLE: Exiting shuffle mode - Playing specific track");
+      LOG_INFO(LOG_SHUFFLE_EXIT);
     }
     
-    myDFPlayer.stop();
-    delay(100);
-    myDFPlayer.play(number);
+    playerScheduler.playTrack(number);
+    TAP_TRACE(TAP_UART);
     currentSong = number;
     isPlaying = true;
-    
-    Serial.print("PLAY: Playing track #");
-    Serial.println(number);
-    Serial.print("TRACK: ");
-    Serial.println(getSongInfo(number));
-    Serial.print(F("Volume: "));
-    Serial.println(currentVolume);
+    LOG_INFO(LOG_PLAY_TRACK, number, currentVolume);
   }
   else {
-    Serial.println("Invalid card number");
+    LOG_WARN(LOG_CARD_INVALID, number);
   }
 }
 
 //*****************************************************************************
 void handleSerialCommands() {
-  if (Serial.available() > 0) {
-    char command = Serial.read();
-
-    switch (command) {
-      case 's':
-        // Check player state
-        {
-          uint8_t state = myDFPlayer.readState();
-          Serial.print("DFPlayer state: ");
-          Serial.print(state);
-          if (customShuffleMode) {
-            Serial.print(" (Shuffle: ON, Auto-check: ");
-            Serial.print(waitingForStateUpdate ? "WAITING" : "READY");
-            Serial.print(", Previous: ");
-            Serial.print(previousDFPlayerState);
-            Serial.print(")");
-          }
-          Serial.println();
-        }
-        break;
-        
-      case 'r':
-        // Manual reset command
-        Serial.println("Manual reset command received");
-        ESP.restart();
-        break;
-        
-      case 'v':
-        // Volume info
-        Serial.print("Current volume: ");
-        Serial.println(currentVolume);
-        break;
-        
-      case '+':
-        // Volume up
-        if (currentVolume < MAX_VOLUME) {
-          currentVolume++;
-          myDFPlayer.volume(currentVolume);
-          Serial.print("VOLUME: Volume up: ");
-          Serial.println(currentVolume);
-        } else {
-          Serial.print("VOLUME: Volume already at maximum (");
-          Serial.print(MAX_VOLUME);
-          Serial.println(")");
-        }
-        break;
-        
-      case '-':
-        // Volume down
-        if (currentVolume > MIN_VOLUME) {
-          currentVolume--;
-          myDFPlayer.volume(currentVolume);
-          Serial.print("VOLUME: Volume down: ");
-          Serial.println(currentVolume);
-        } else {
-          Serial.print("VOLUME: Volume already at minimum (");
-          Serial.print(MIN_VOLUME);
-          Serial.println(")");
-        }
-        break;
-        
-      case 'l':
-        // List all songs
-        Serial.println(F("\n=== Song List ==="));
-        for (int i = 1; i <= 41; i++) {
-          Serial.print("Track ");
-          if (i < 10) Serial.print("0");
-          Serial.print(i);
-          Serial.print(": ");
-          Serial.println(getSongInfo(i));
-        }
-        Serial.println(F("===================\n"));
-        break;
-        
-      case 'x':
-        // Stop current song
-        myDFPlayer.stop();
-        isPlaying = false;
-        currentSong = 0;
-        // Exit shuffle mode when manually stopping
-        if (customShuffleMode) {
-          customShuffleMode = false;
-          waitingForStateUpdate = false;
-          Serial.println("STOP: Exiting shuffle mode");
-        }
-        Serial.println("STOP: Current song stopped");
-        break;
-        
-      case 'h':
-        // Shuffle mode
-        startCustomShuffle();
-        break;
-        
-      case 't':
-        // Toggle play/pause
-        if (isPlaying) {
-          myDFPlayer.pause();
-          isPlaying = false;
-          Serial.println("PAUSE: Playback paused");
-        } else {
-          myDFPlayer.start();
-          isPlaying = true;
-          Serial.println("PLAY: Playback resumed");
-        }
-        break;
-        
-      case 'n':
-        // Next track
-        if (customShuffleMode) {
-          playNextShuffleTrack();
-        } else {
-          myDFPlayer.next();
-          if (currentSong > 0) currentSong++;
-          Serial.println("NEXT: Next track");
-        }
-        break;
-        
-      case 'b':
-        // Previous track
-        myDFPlayer.previous();
-        if (currentSong > 1) currentSong--;
-        Serial.println("PREVIOUS: Previous track");
-        break;
-        
-      case 'z':
-        // Shuffle status
-        if (customShuffleMode) {
-          Serial.print("SHUFFLE: Active - Track ");
-          Serial.print(shuffleIndex);
-          Serial.print(" of ");
-          Serial.print(shuffleSize);
-          Serial.print(" (Current: #");
-          Serial.print(currentSong);
-          Serial.print(" - ");
-          Serial.print(getSongInfo(currentSong));
-          Serial.println(")");
-        } else {
-          Serial.println("SHUFFLE: Inactive - Normal playback mode");
-        }
-        break;
-        
-      case 'p':
-        // Enter programming mode
-        if (jukeboxMode) {
-          jukeboxMode = false;
-          programmerModeType = "";
-          programmerAutoReady = false;
-          Serial.println(F("\n=== PROGRAMMING MODE ACTIVATED ==="));
-          Serial.println(F("Write 'auto' for Automatic mode, 'manual' for Manual mode, or 'read' to read cards"));
-          Serial.println(F("Type 'jukebox' to return to jukebox mode"));
-        }
-        break;
-        
-      default:
-        if (jukeboxMode) {
-          Serial.println("Commands: s=state, r=reset, v=volume, +=vol up, -=vol down, l=list songs, p=program mode, x=stop, h=shuffle, z=shuffle status, t=play/pause, n=next, b=previous");
-        }
-        break;
+  METRIC_TIMER(METRIC_SERIAL);
+  // Only what has arrived; a line is handled once its end is in
+  int available = Serial.available();
+  while (available-- > 0) {
+    if (!serialLine.feed(Serial.read())) {
+      if (serialLine.tooLong()) {
+        Serial.print("ERROR: Line too long (max ");
+        Serial.print(CommandLine::MAX_LENGTH);
+        Serial.println(" characters), ignored");
+      }
+      continue;
+    }
+    if (jukeboxMode) {
+      dispatchCommand(serialLine.text(), Serial, COMMAND_SERIAL);
+    } else {
+      programmerInput(serialLine.text());
     }
   }
 }
@@ -652,6 +666,7 @@ void performSystemCheck() {
 
       if (state == 255) {
         Serial.println("Recovery failed - Restarting ESP32...");
+        playerStateStore.flush();
         delay(1000);
         ESP.restart();
       }
@@ -663,17 +678,23 @@ void performSystemCheck() {
 // RFID Programming Mode Functions
 //*****************************************************************************
 
-void programmerMode() {
-  if (Serial.available()) {
-    String input = Serial.readStringUntil('\n');
-    input.trim();
-
-    // Handle auto mode setup
-    if (programmerModeType == "auto" && !programmerAutoReady) {
-      int startingNumber = input.toInt();
-      if (startingNumber > 0 || input == "0") {
-        programmerCurrentNumber = startingNumber;
-        programmerAutoReady = true;
+// A line typed on the console in programming mode. Only changes the
+// state; the reader work happens in programmerMode().
+void programmerInput(const char* line) {
+  String input = line;
+  input.trim();
+
+  if (input == "jukebox") {
+    runCommand({CMD_JUKEBOX, 0}, Serial, COMMAND_SERIAL);
+    return;
+  }
+
+  switch (programmerState) {
+    case PROGRAM_AUTO_START:
+      // Handle auto mode setup
+      if (input.toInt() > 0 || input == "0") {
+        programmerCurrentNumber = input.toInt();
+        programmerState = PROGRAM_AUTO;
         Serial.println("Auto mode ready! Starting number: " + String(programmerCurrentNumber));
         Serial.println(F("Place the card on the reader and hold it there to write song number data to the card"));
         Serial.println(F("(Type 'jukebox' to return to jukebox mode)"));
@@ -681,48 +702,205 @@ void programmerMode() {
         Serial.println("Please enter a valid number (0 or greater):");
       }
       return;
-    }
 
-    // Handle mode changes
-    if (input == "auto" || input == "manual" || input == "read") {
-      programmerModeType = input;
-      programmerAutoReady = false;
-      
-      Serial.println("Device is now in " + programmerModeType + " programming mode");
-      
-      if (programmerModeType == "auto") {
-        Serial.println(F("Please enter the starting number:"));
-      } else if (programmerModeType == "read") {
-        Serial.println(F("Place the card on the reader to read its number"));
+    case PROGRAM_MANUAL_NUMBER:
+      // The number for the card on the reader
+      if (input.toInt() > 0 || input == "0") {
+        programmerCurrentNumber = input.toInt();
+        programmerState = PROGRAM_MANUAL_WRITE;
       } else {
-        Serial.println(F("Place the card on the reader and hold it there to write song number data to the card"));
+        Serial.println(F("Type any number and hit send/enter (or type 'jukebox' to return):"));
       }
-    } else if (input == "jukebox") {
-      // Return to jukebox mode
-      jukeboxMode = true;
-      programmerModeType = "";
-      programmerAutoReady = false;
-      Serial.println(F("\n=== JUKEBOX MODE ACTIVATED ==="));
-      Serial.println(F("Place an RFID card on the reader to play a song"));
-    } else if (programmerModeType != "auto" && programmerModeType != "manual" && programmerModeType != "read") {
-      Serial.println("Programming commands: 'auto', 'manual', 'read', or 'jukebox'");
+      return;
+
+    case PROGRAM_MANUAL_WRITE:
+      return;      // still writing the previous number
+
+    default:
+      break;
+  }
+
+  // Handle mode changes
+  if (input.startsWith("batch")) {
+    CardBatchSpec spec;
+    if (input == "batch") {
+      cardBatch.printProgress(Serial);
+    } else if (CardBatch::parse(input.c_str() + 5, input.length() - 5, spec)) {
+      startCardBatch(spec);
+    } else {
+      Serial.println(F("Batch numbers like 'batch 1-41' or 'batch 1,5,9-12'"));
     }
+    return;
+  }
+  if (input == "auto") {
+    cardBatch.stop();
+    releaseProgrammerCard();
+    programmerState = PROGRAM_AUTO_START;
+    Serial.println("Device is now in auto programming mode");
+    Serial.println(F("Please enter the starting number:"));
+  } else if (input == "manual") {
+    cardBatch.stop();
+    releaseProgrammerCard();
+    programmerState = PROGRAM_MANUAL;
+    Serial.println("Device is now in manual programming mode");
+    Serial.println(F("Place the card on the reader and hold it there to write song number data to the card"));
+  } else if (input == "read") {
+    cardBatch.stop();
+    releaseProgrammerCard();
+    programmerState = PROGRAM_READ;
+    Serial.println("Device is now in read programming mode");
+    Serial.println(F("Place the card on the reader to read its number"));
+  } else if (programmerState == PROGRAM_IDLE || programmerState == PROGRAM_BATCH) {
+    Serial.println("Programming commands: 'auto', 'manual', 'read', 'batch 1-41', or 'jukebox'");
   }
+}
 
-  // Execute the current programming mode functions
-  if (programmerModeType == "auto" && programmerAutoReady) {
-    autoModus();
-  } else if (programmerModeType == "manual") {
-    manualModus();
-  } else if (programmerModeType == "read") {
-    readModus();
+// One step of programming mode per player pass. Each state does at most
+// one card's worth of reader work and returns, so the web, WiFi and the
+// console keep running while cards are programmed.
+void programmerMode() {
+  switch (programmerState) {
+    case PROGRAM_AUTO:
+      autoModus();
+      break;
+    case PROGRAM_MANUAL:
+      manualModus();
+      break;
+    case PROGRAM_MANUAL_NUMBER:
+      // The card stays selected until its number arrives; no reader
+      // traffic meanwhile, a REQA would send it back to idle
+      if (millis() - programmerCardTime >= programmerNumberTimeout) {
+        Serial.println("Timeout - no number entered");
+        haltProgrammerCard();
+      }
+      break;
+    case PROGRAM_MANUAL_WRITE:
+      manualWrite();
+      break;
+    case PROGRAM_BATCH:
+      batchModus();
+      break;
+    case PROGRAM_READ:
+      readModus();
+      break;
+    default:
+      break;
   }
 }
 
-void autoModus() {
+// Manual mode: halt the card waiting for its number, wait for the next one.
+// The caller holds the reader (programmerMode() runs under lockReader()).
+void haltProgrammerCard() {
+  if (programmerState != PROGRAM_MANUAL_NUMBER && programmerState != PROGRAM_MANUAL_WRITE) return;
+  mfrc522.PICC_HaltA();
+  mfrc522.PCD_StopCrypto1();
+  programmerState = PROGRAM_MANUAL;
+}
+
+// The same from the console and commands, which don't hold the reader
+void releaseProgrammerCard() {
+  lockReader();
+  haltProgrammerCard();
+  unlockReader();
+}
+
+// False if already in programming mode
+bool enterProgrammerMode() {
+  if (!jukeboxMode) return false;
+  jukeboxMode = false;
+  programmerState = PROGRAM_IDLE;
+  return true;
+}
+
+// Run a batch programming job, from the console or POST /api/program
+void startCardBatch(const CardBatchSpec& spec) {
+  if (!enterProgrammerMode()) releaseProgrammerCard();
+  cardBatch.start(spec);
+  programmerState = PROGRAM_BATCH;
+  Serial.print("BATCH: Programming ");
+  Serial.print(cardBatch.total());
+  Serial.print(" cards, starting with #");
+  Serial.println(cardBatch.nextNumber());
+  Serial.println(F("Place the cards on the reader one at a time (type 'batch' for progress)"));
+}
+
+// False if already in jukebox mode
+bool enterJukeboxMode() {
+  if (jukeboxMode) return false;
+  releaseProgrammerCard();
+  cardBatch.stop();
+  jukeboxMode = true;
+  programmerState = PROGRAM_IDLE;
+  return true;
+}
+
+// Block 1 of a MIFARE Classic card: ASCII digits, space padded
+static void classicCardBlock(int number, byte* block) {
+  char digits[12];
+  byte len = snprintf(digits, sizeof(digits), "%d", number);
+  for (byte i = 0; i < 16; i++) block[i] = i < len ? digits[i] : ' ';
+}
+
+// Write a number to the selected card: a binary record on NTAG/Ultralight,
+// ASCII digits in block 1 on MIFARE Classic
+bool writeCardNumber(MFRC522::PICC_Type piccType, int number) {
+  MFRC522::StatusCode status;
+
+  if (usesCardRecord(piccType)) {
+    CardRecord record;
+    if (!cardRecordFromNumber(number, record)) {
+      Serial.println("Number " + String(number) + " cannot be stored on this card");
+      return false;
+    }
+    status = writeCardRecord(mfrc522, record);
+    if (status != MFRC522::STATUS_OK) {
+      Serial.print(F("Write failed: "));
+      Serial.println(mfrc522.GetStatusCodeName(status));
+      return false;
+    }
+    return true;
+  }
+
   MFRC522::MIFARE_Key key;
   for (byte i = 0; i < 6; i++) key.keyByte[i] = 0xFF;
 
+  byte buffer[16];
+  byte block = 1;
+  classicCardBlock(number, buffer);
+
+  status = mfrc522.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, block, &key, &(mfrc522.uid));
+  if (status != MFRC522::STATUS_OK) {
+    Serial.print(F("Authentication failed: "));
+    Serial.println(mfrc522.GetStatusCodeName(status));
+    return false;
+  }
+
+  status = mfrc522.MIFARE_Write(block, buffer, 16);
+  if (status != MFRC522::STATUS_OK) {
+    Serial.print(F("Write failed: "));
+    Serial.println(mfrc522.GetStatusCodeName(status));
+    return false;
+  }
+  return true;
+}
+
+// Read back what writeCardNumber() just wrote. On MIFARE Classic the
+// write's authentication still holds, so this is a single block read.
+bool verifyCardNumber(MFRC522::PICC_Type piccType, int number) {
+  if (usesCardRecord(piccType)) {
+    CardRecord record;
+    return readCardRecord(mfrc522, record) == MFRC522::STATUS_OK && cardNumber(record) == number;
+  }
+
+  byte expected[16];
+  byte buffer[18];
+  byte size = sizeof(buffer);
+  classicCardBlock(number, expected);
+  if (mfrc522.MIFARE_Read(1, buffer, &size) != MFRC522::STATUS_OK) return false;
+  return memcmp(buffer, expected, 16) == 0;
+}
+
+void autoModus() {
   if (mfrc522.PICC_IsNewCardPresent()) {
     if (!mfrc522.PICC_ReadCardSerial()) {
       return;
@@ -738,30 +916,13 @@ void autoModus() {
     MFRC522::PICC_Type piccType = mfrc522.PICC_GetType(mfrc522.uid.sak);
     Serial.println(mfrc522.PICC_GetTypeName(piccType));
 
-    byte buffer[16];
-    MFRC522::StatusCode status;
-    byte block = 1;
-    byte len;
-
-    len = sprintf((char*)buffer, "%d", programmerCurrentNumber);
-    for (byte i = len; i < 16; i++) buffer[i] = ' ';
-
-    status = mfrc522.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, block, &key, &(mfrc522.uid));
-    if (status != MFRC522::STATUS_OK) {
-      Serial.print(F("Authentication failed: "));
-      Serial.println(mfrc522.GetStatusCodeName(status));
-      return;
-    }
-
-    status = mfrc522.MIFARE_Write(block, buffer, 16);
-    if (status != MFRC522::STATUS_OK) {
-      Serial.print(F("Write failed: "));
-      Serial.println(mfrc522.GetStatusCodeName(status));
+    if (!writeCardNumber(piccType, programmerCurrentNumber)) {
       return;
     }
 
     mfrc522.PICC_HaltA();
     mfrc522.PCD_StopCrypto1();
+    cardCache.insert(mfrc522.uid, programmerCurrentNumber);
 
     programmerCurrentNumber++;
     Serial.println("SUCCESS: Card written successfully! Number: " + String(programmerCurrentNumber - 1) + " (" + getSongInfo(programmerCurrentNumber - 1) + ")");
@@ -771,9 +932,6 @@ void autoModus() {
 }
 
 void manualModus() {
-  MFRC522::MIFARE_Key key;
-  for (byte i = 0; i < 6; i++) key.keyByte[i] = 0xFF;
-
   if (!mfrc522.PICC_IsNewCardPresent()) {
     return;
   }
@@ -788,73 +946,83 @@ void manualModus() {
     Serial.print(mfrc522.uid.uidByte[i], HEX);
   }
   Serial.print(F(" PICC type: "));
-  MFRC522::PICC_Type piccType = mfrc522.PICC_GetType(mfrc522.uid.sak);
-  Serial.println(mfrc522.PICC_GetTypeName(piccType));
+  programmerCardType = mfrc522.PICC_GetType(mfrc522.uid.sak);
+  Serial.println(mfrc522.PICC_GetTypeName(programmerCardType));
 
   Serial.println(F("Type any number and hit send/enter (or type 'jukebox' to return):"));
-  
-  String userInput = "";
-  unsigned long startTime = millis();
-  const unsigned long timeout = 30000;
-  
-  while (userInput == "" && (millis() - startTime) < timeout) {
-    if (Serial.available()) {
-      userInput = Serial.readStringUntil('\n');
-      userInput.trim();
-      break;
-    }
-    delay(10);
+  programmerCardTime = millis();
+  programmerState = PROGRAM_MANUAL_NUMBER;
+}
+
+// Manual mode: the number has arrived, write it to the waiting card
+void manualWrite() {
+  bool written = writeCardNumber(programmerCardType, programmerCurrentNumber);
+  if (written) {
+    cardCache.insert(mfrc522.uid, programmerCurrentNumber);
+    Serial.println("SUCCESS: Card written successfully with: " + String(programmerCurrentNumber) + " (" + getSongInfo(programmerCurrentNumber) + ")");
+    Serial.println("Put a new card on the reader to write another number");
   }
-  
-  if (userInput == "jukebox") {
-    jukeboxMode = true;
-    programmerModeType = "";
-    Serial.println("Returning to jukebox mode");
-    mfrc522.PICC_HaltA();
-    mfrc522.PCD_StopCrypto1();
+
+  mfrc522.PICC_HaltA();
+  mfrc522.PCD_StopCrypto1();
+  programmerState = PROGRAM_MANUAL;
+}
+
+// Batch mode: each card placed gets the job's next number, and counts as
+// written only once it reads back
+void batchModus() {
+  if (!mfrc522.PICC_IsNewCardPresent() || !mfrc522.PICC_ReadCardSerial()) {
     return;
   }
-  
-  if (userInput == "") {
-    Serial.println("Timeout - no number entered");
+
+  if (cardBatch.finished(mfrc522.uid)) {
+    // Done already and put back, or the halt was missed
     mfrc522.PICC_HaltA();
-    mfrc522.PCD_StopCrypto1();
     return;
   }
 
-  byte buffer[16];
-  byte block = 1;
-  MFRC522::StatusCode status;
-  
-  for (int i = 0; i < 16; i++) buffer[i] = ' ';
-  int copyLength = (userInput.length() + 1 < 16) ? userInput.length() + 1 : 16;
-  userInput.toCharArray((char*)buffer, copyLength);
+  MFRC522::PICC_Type piccType = mfrc522.PICC_GetType(mfrc522.uid.sak);
+  int number = cardBatch.nextNumber();
+  bool ok = writeCardNumber(piccType, number) && verifyCardNumber(piccType, number);
+  CardBatchResult result = cardBatch.cardDone(mfrc522.uid, ok, millis());
+  mfrc522.PCD_StopCrypto1();
 
-  status = mfrc522.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, block, &key, &(mfrc522.uid));
-  if (status != MFRC522::STATUS_OK) {
-    Serial.print(F("Authentication failed: "));
-    Serial.println(mfrc522.GetStatusCodeName(status));
-    return;
+  switch (result) {
+    case CARD_BATCH_WRITTEN:
+      mfrc522.PICC_HaltA();
+      cardCache.insert(mfrc522.uid, number);
+      Serial.print("BATCH: Card ");
+      Serial.print(cardBatch.written());
+      Serial.print("/");
+      Serial.print(cardBatch.total());
+      Serial.print(" written and verified: #");
+      Serial.print(number);
+      Serial.print(" (");
+      printSongInfo(Serial, number);
+      Serial.println(")");
+      break;
+    case CARD_BATCH_RETRY:
+      // Not halted: the next pass selects it again
+      Serial.println("BATCH: #" + String(number) + " did not verify, retrying");
+      break;
+    case CARD_BATCH_FAILED:
+      mfrc522.PICC_HaltA();
+      Serial.print("BATCH: Bad card flagged after ");
+      Serial.print(CardBatch::MAX_ATTEMPTS);
+      Serial.print(" attempts - set it aside, #");
+      Serial.print(number);
+      Serial.println(" goes to the next card");
+      break;
   }
 
-  status = mfrc522.MIFARE_Write(block, buffer, 16);
-  if (status != MFRC522::STATUS_OK) {
-    Serial.print(F("Write failed: "));
-    Serial.println(mfrc522.GetStatusCodeName(status));
-    return;
+  if (!cardBatch.running()) {
+    cardBatch.printProgress(Serial);
+    Serial.println(F("BATCH: Done"));
+    programmerState = PROGRAM_IDLE;
   }
-
-  Serial.println("SUCCESS: Card written successfully with: " + userInput + " (" + getSongInfo(userInput.toInt()) + ")");
-  Serial.println("Put a new card on the reader to write another number");
-
-  mfrc522.PICC_HaltA();
-  mfrc522.PCD_StopCrypto1();
 }
 
 void readModus() {
-  MFRC522::MIFARE_Key key;
-  for (byte i = 0; i < 6; i++) key.keyByte[i] = 0xFF;
-
   if (!mfrc522.PICC_IsNewCardPresent()) {
     return;
   }
@@ -873,6 +1041,29 @@ void readModus() {
   MFRC522::PICC_Type piccType = mfrc522.PICC_GetType(mfrc522.uid.sak);
   Serial.println(mfrc522.PICC_GetTypeName(piccType));
 
+  if (usesCardRecord(piccType)) {
+    CardRecord record;
+    MFRC522::StatusCode status = readCardRecord(mfrc522, record);
+    if (status == MFRC522::STATUS_OK) {
+      Serial.print(F("Number stored on card: "));
+      Serial.print(cardNumber(record));
+      Serial.print(" (");
+      printSongInfo(Serial, cardNumber(record));
+      Serial.println(")");
+    } else if (status == MFRC522::STATUS_CRC_WRONG) {
+      Serial.println("No valid card record - card is empty or not programmed for the jukebox");
+    } else {
+      Serial.print(F("Reading failed: "));
+      Serial.println(mfrc522.GetStatusCodeName(status));
+    }
+    Serial.println("Place another card to read, or type 'jukebox' to return");
+    mfrc522.PICC_HaltA();
+    return;
+  }
+
+  MFRC522::MIFARE_Key key;
+  for (byte i = 0; i < 6; i++) key.keyByte[i] = 0xFF;
+
   byte buffer[18];
   byte block = 1;
   byte size = sizeof(buffer);
@@ -902,7 +1093,7 @@ void readModus() {
     if (cardData.length() > 0) {
       Serial.print(cardData);
       Serial.print(" (");
-      Serial.print(getSongInfo(cardData.toInt()));
+      printSongInfo(Serial, cardData.toInt());
       Serial.println(")");
     } else {
       Serial.println("No number found or card is empty");
@@ -916,52 +1107,17 @@ void readModus() {
 }
 
 //*****************************************************************************
-// Get song title and artist information
+// Get song title and artist information as a String, for building web
+// responses. Serial output uses printSongInfo() and allocates nothing.
 String getSongInfo(int trackNumber) {
-  switch (trackNumber) {
-    case 1: return "Did Jesus Have a Baby Sister - Dory Previn";
-    case 2: return "That's All Right - Elvis Presley";
-    case 3: return "Hey Joe - Jimi Hendrix";
-    case 4: return "Delia's Gone - Johnny Cash";
-    case 5: return "In Da Club - 50 Cent";
-    case 6: return "Keep the Customer Satisfied - Simon & Garfunkel";
-    case 7: return "Thrift Shop - Macklemore & Ryan Lewis";
-    case 8: return "Old Man - Neil Young";
-    case 9: return "Never Going Back Again - Fleetwood Mac";
-    case 10: return "Norwegian Wood (This Bird Has Flown) - The Beatles";
-    case 11: return "Chain Gang - Sam Cooke";
-    case 12: return "Yakety Yak - The Coasters";
-    case 13: return "I've Been Everywhere - Johnny Cash";
-    case 14: return "Thunderstruck - AC/DC";
-    case 15: return "Duurt Te Lang - Davina Michelle";
-    case 16: return "Alles Gaat Voorbij - Doe Maar";
-    case 17: return "The Painter - William Ben";
-    case 18: return "Think - Aretha Franklin";
-    case 19: return "Scotland the Brave - Auld Town Band & Pipes";
-    case 20: return "Single Ladies - Beyoncé";
-    case 21: return "Grandma's Hands - Bill Withers";
-    case 22: return "Without Me - Eminem";
-    case 23: return "Spraakwater - Extince";
-    case 24: return "King of the World - First Aid Kit";
-    case 25: return "Komodovaraan - Yentl en De Boer";
-    case 26: return "Look What They've Done To My Song, Ma - Melanie";
-    case 27: return "The Man Who Sold The World - Nirvana";
-    case 28: return "Rotterdam - Pokey LaFarge";
-    case 29: return "'t Roeie Klied - Rowwen Heze";
-    case 30: return "You Never Can Tell - Chuck Berry";
-    case 31: return "Sit Still, Look Pretty - Daya";
-    case 32: return "Gangsta's Paradise - Coolio ft. L.V.";
-    case 33: return "Me And Bobby McGee - Janis Joplin";
-    case 34: return "Big River - Johnny Cash";
-    case 35: return "Non, Non, Rien N'a Changé - Les Poppys";
-    case 36: return "Over in the Glory Land - The Broken Circle Breakdown";
-    case 37: return "Hell's Comin' With Me - Poor Man's Poison";
-    case 38: return "A far l'amore comincia tu - Raffaella Carrà";
-    case 39: return "Auto, Vliegtuug - Rowwen Hèze";
-    case 40: return "Stuck In The Middle With You - Stealers Wheel";
-    case 41: return "Lonely Boy - The Black Keys";
-    default: return "Unknown Track #" + String(trackNumber);
-  }
+  SongInfo song;
+  if (!lookupSong(trackNumber, song)) return "Unknown Track #" + String(trackNumber);
+  String info;
+  info.reserve(song.titleLength + 3 + song.artistLength);
+  info += song.title;
+  info += " - ";
+  info += song.artist;
+  return info;
 }
 
 //*****************************************************************************
@@ -1008,6 +1164,7 @@ void setupWiFi() {
 }
 
 void handleWiFiConnection() {
+  METRIC_TIMER(METRIC_WIFI);
   if (!wifiSetupStarted) return;
   
   unsigned long currentTime = millis();
@@ -1050,328 +1207,219 @@ void handleWiFiConnection() {
 // WiFi Web Interface Functions
 //*****************************************************************************
 
-void setupWebServer() {
-  if (WiFi.status() != WL_CONNECTED) {
-    Serial.println(F("WARNING: Cannot setup Web Server - WiFi not connected"));
-    return;
-  }
-  
-  // Main web page - serve from SPIFFS
-  server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
-    if (SPIFFS.exists("/index.html")) {
-      request->send(SPIFFS, "/index.html", "text/html");
-    } else {
-      request->send(404, "text/plain", "Web interface not found. Please upload SPIFFS filesystem.");
-    }
-  });
-  
-  // Command endpoint
-  server.on("/cmd", HTTP_GET, [](AsyncWebServerRequest *request){
-    if (request->hasParam("c")) {
-      String command = request->getParam("c")->value();
-      if (command.length() >= 1) {
-        // Handle 'jukebox' command specially
-        if (command == "jukebox") {
-          wifiResponse = processJukeboxCommand();
-        } else {
-          char cmd = command.charAt(0);
-          wifiResponse = processCommand(cmd);
-        }
-        request->send(200, "text/plain", "Command processed");
-      } else {
-        request->send(400, "text/plain", "Invalid command");
-      }
-    } else {
-      request->send(400, "text/plain", "Missing command parameter");
-    }
-  });
-  
-  // Play song endpoint
-  server.on("/play", HTTP_GET, [](AsyncWebServerRequest *request){
-    if (request->hasParam("song")) {
-      String songParam = request->getParam("song")->value();
-      int songNumber = songParam.toInt();
-      if (songNumber >= 1 && songNumber <= 41) {
-        // Exit shuffle mode when playing a specific song
-        if (customShuffleMode) {
-          customShuffleMode = false;
-          waitingForStateUpdate = false;  // Reset auto-progression tracking
-        }
-        
-        // Stop current song and play new one
-        myDFPlayer.stop();
-        delay(100);
-        myDFPlayer.play(songNumber);
-        currentSong = songNumber;
-        isPlaying = true;
-        
-        wifiResponse = "PLAY: Playing track #" + String(songNumber) + " - " + getSongInfo(songNumber);
-        request->send(200, "text/plain", "Song " + String(songNumber) + " started");
-      } else {
-        wifiResponse = "ERROR: Invalid song number. Must be 1-41.";
-        request->send(400, "text/plain", "Invalid song number");
-      }
-    } else {
-      wifiResponse = "ERROR: Missing song parameter";
-      request->send(400, "text/plain", "Missing song parameter");
-    }
-  });
-  
-  // Response endpoint
-  server.on("/response", HTTP_GET, [](AsyncWebServerRequest *request){
-    request->send(200, "text/plain", wifiResponse);
-  });
-  
-  // API endpoint for programmatic access
-  server.on("/api/command", HTTP_GET, [](AsyncWebServerRequest *request){
-    if (request->hasParam("cmd")) {
-      String command = request->getParam("cmd")->value();
-      if (command.length() == 1) {
-        char cmd = command.charAt(0);
-        String response = processCommand(cmd);
-        request->send(200, "application/json", 
-          "{\"command\":\"" + command + "\",\"response\":\"" + response + "\"}");
-      } else {
-        request->send(400, "application/json", 
-          "{\"error\":\"Command must be a single character\"}");
-      }
-    } else {
-      request->send(400, "application/json", 
-        "{\"error\":\"Missing cmd parameter\"}");
-    }
-  });
-  
-  server.begin();
-  Serial.println(F("SUCCESS: Web Server Ready"));
-  Serial.print(F("WEB: Web Interface: http://"));
-  Serial.print(WiFi.localIP());
-  Serial.println(F("/"));
-}
-
-String processCommand(char command) {
-  wifiResponse = ""; // Clear previous response
-  
-  switch (command) {
-    case 's':
-      {
-        uint8_t state = myDFPlayer.readState();
-        wifiResponse = "DFPlayer state: " + String(state);
-        if (customShuffleMode) {
-          wifiResponse += " (Shuffle: ON, Auto-check: ";
-          wifiResponse += waitingForStateUpdate ? "WAITING" : "READY";
-          wifiResponse += ", Previous: " + String(previousDFPlayerState) + ")";
-        }
-      }
-      break;
-      
-    case 'r':
-      wifiResponse = "Manual reset command received - ESP32 will restart";
-      delay(1000);
-      ESP.restart();
-      break;
-      
-    case 'l':
-      wifiResponse = "=== Song List ===\n";
-      for (int i = 1; i <= 41; i++) {
-        wifiResponse += "Track ";
-        if (i < 10) wifiResponse += "0";
-        wifiResponse += String(i) + ": " + getSongInfo(i) + "\n";
-      }
-      wifiResponse += "===================";
-      break;
-      
-    case 'x':
-      // Stop current song
-      myDFPlayer.stop();
-      isPlaying = false;
-      currentSong = 0;
-      // Exit shuffle mode when manually stopping
-      if (customShuffleMode) {
-        customShuffleMode = false;
-        waitingForStateUpdate = false;
-        wifiResponse = "STOP: Exiting shuffle mode - Current song stopped";
-      } else {
-        wifiResponse = "STOP: Current song stopped";
-      }
-      break;
-      
-    case 'h':
-      // Shuffle mode
-      startCustomShuffle();
-      wifiResponse = "SHUFFLE: Custom shuffle mode activated - True random playback";
-      break;
-      
-    case 't':
-      // Toggle play/pause
-      if (isPlaying) {
-        myDFPlayer.pause();
-        isPlaying = false;
-        wifiResponse = "PAUSE: Playback paused";
-      } else {
-        myDFPlayer.start();
-        isPlaying = true;
-        wifiResponse = "PLAY: Playback resumed";
-      }
-      break;
-      
-    case 'n':
-      // Next track
-      if (customShuffleMode) {
-        playNextShuffleTrack();
-        wifiResponse = "NEXT: Next shuffle track";
-      } else {
-        myDFPlayer.next();
-        if (currentSong > 0) currentSong++;
-        wifiResponse = "NEXT: Next track";
-      }
-      break;
-      
-    case 'b':
-      // Previous track
-      myDFPlayer.previous();
-      if (currentSong > 1) currentSong--;
-      wifiResponse = "PREVIOUS: Previous track";
-      break;
-      
-    case 'z':
-      // Shuffle status
-      if (customShuffleMode) {
-        wifiResponse = "SHUFFLE: Active - Track " + String(shuffleIndex) + " of " + String(shuffleSize);
-        wifiResponse += " (Current: #" + String(currentSong) + " - " + getSongInfo(currentSong) + ")";
-      } else {
-        wifiResponse = "SHUFFLE: Inactive - Normal playback mode";
-      }
-      break;
-      
-    case 'p':
-      if (jukeboxMode) {
-        jukeboxMode = false;
-        programmerModeType = "";
-        programmerAutoReady = false;
-        wifiResponse = "PROGRAM: === PROGRAMMING MODE ACTIVATED ===\n";
-        wifiResponse += "Note: Programming mode works best with Serial Monitor.\n";
-        wifiResponse += "Use Serial Monitor for: 'auto', 'manual', 'read', or 'jukebox'";
-      } else {
-        wifiResponse = "Already in programming mode";
-      }
-      break;
-      
-    default:
-      wifiResponse = "Unknown command: " + String(command) + "\n";
-      wifiResponse += "Available commands: s=state, r=reset, l=list songs, p=program mode, x=stop, h=shuffle, z=shuffle status, t=play/pause, n=next, b=previous";
-      break;
+void handleWebCommands() {
+  static CommandReply reply;     // only the player task runs commands
+
+  // Bounded so a burst of requests can't starve the other handlers; a
+  // batch is always run to its end, with no other handler in between
+  WebCommand command = {};
+  for (uint32_t i = 0; (i < WebCommandQueue::CAPACITY || command.batchRemaining > 0) &&
+                       webCommands.pop(command); i++) {
+    reply.clear();
+    runCommand(command.call, reply, COMMAND_WEB);
+    webResponses.store(command.ticket, reply.text(), reply.length());
+    playerEvents.commandResult(command.ticket, String(reply.text()));
+    webCommands.complete(command.ticket);
   }
-  
-  return wifiResponse;
-}
 
-String processJukeboxCommand() {
-  if (!jukeboxMode) {
-    jukeboxMode = true;
-    programmerModeType = "";
-    programmerAutoReady = false;
-    return "JUKEBOX: === JUKEBOX MODE ACTIVATED ===\nPlace an RFID card on the reader to play a song";
-  } else {
-    return "Already in jukebox mode";
-  }
+  // A card programming job from POST /api/program
+  CardBatchSpec spec;
+  if (cardBatch.takeSubmitted(spec)) startCardBatch(spec);
 }
 
 //*****************************************************************************
 // Custom Shuffle Functions
 //*****************************************************************************
 
-void createShufflePlaylist() {
-  // Fill playlist with track numbers 1-41
-  for (int i = 0; i < shuffleSize; i++) {
-    shufflePlaylist[i] = i + 1;
-  }
-  
-  // Shuffle using Fisher-Yates algorithm for true randomness
-  for (int i = shuffleSize - 1; i > 0; i--) {
-    int j = random(0, i + 1);  // Random index from 0 to i
-    // Swap elements
-    int temp = shufflePlaylist[i];
-    shufflePlaylist[i] = shufflePlaylist[j];
-    shufflePlaylist[j] = temp;
-  }
-  
+void newShuffleOrder() {
+  // A fresh seed gives a new order; tracks are computed as they are needed
+  shuffleOrder.begin(shuffleSize, random(0x7FFFFFFF));
   shuffleIndex = 0;  // Reset to beginning of shuffled playlist
-  Serial.println("SHUFFLE: Created new shuffled playlist");
+  LOG_DEBUG(LOG_SHUFFLE_ORDER, shuffleOrder.seed());
+}
+
+void startNextShuffleCycle() {
+  // Next cycle of the same seed; never opens with the track that just played
+  shuffleOrder.nextCycle();
+  shuffleIndex = 0;
+  LOG_INFO(LOG_SHUFFLE_CYCLE, shuffleOrder.cycle());
 }
 
 void startCustomShuffle() {
   customShuffleMode = true;
-  createShufflePlaylist();
+  newShuffleOrder();
   playNextShuffleTrack();
   
-  // Initialize auto-progression tracking
-  lastStateCheck = millis();
-  previousDFPlayerState = 1;  // Assume playing state
-  waitingForStateUpdate = false;
-  
-  Serial.println("SHUFFLE: Custom shuffle mode activated - True random playback");
+  LOG_INFO(LOG_SHUFFLE_STARTED);
 }
 
 void playNextShuffleTrack() {
   if (!customShuffleMode) return;
   
-  // If we've played all tracks, create a new shuffle
-  if (shuffleIndex >= shuffleSize) {
-    Serial.println("SHUFFLE: Completed all tracks, creating new shuffle order");
-    createShufflePlaylist();
-  }
+  // If we've played all tracks, move on to the next cycle
+  if (shuffleIndex >= shuffleSize) startNextShuffleCycle();
   
-  int trackToPlay = shufflePlaylist[shuffleIndex];
-  myDFPlayer.stop();
-  delay(100);
-  myDFPlayer.play(trackToPlay);
+  int trackToPlay = shuffleOrder.at(shuffleIndex);
+  playerScheduler.playTrack(trackToPlay);
+  announceShuffleTrack(trackToPlay);
+}
+
+// Bookkeeping once a shuffle track has been sent, by playNextShuffleTrack()
+// or armed on the scheduler
+void announceShuffleTrack(int trackToPlay) {
+  // An armed track past the end is the first of the next cycle
+  if (shuffleIndex >= shuffleSize) startNextShuffleCycle();
+
   currentSong = trackToPlay;
   isPlaying = true;
   
-  Serial.print("SHUFFLE: Playing track #");
-  Serial.print(trackToPlay);
-  Serial.print(" (");
-  Serial.print(shuffleIndex + 1);
-  Serial.print("/");
-  Serial.print(shuffleSize);
-  Serial.print(") - ");
-  Serial.println(getSongInfo(trackToPlay));
+  LOG_INFO(LOG_SHUFFLE_TRACK, trackToPlay, shuffleIndex + 1, shuffleSize);
   
   shuffleIndex++;
 }
 
+//*****************************************************************************
+// Play Queue Functions
+//*****************************************************************************
+
+bool enqueueTrack(int trackNumber) {
+  if (trackNumber < 1 || trackNumber > songCount()) return false;
+  if (!playQueue.push(trackNumber)) {
+    LOG_WARN(LOG_QUEUE_FULL);
+    return false;
+  }
+  LOG_INFO(LOG_QUEUE_ADDED, trackNumber, playQueue.size());
+  return true;
+}
+
+void playQueuedTrack() {
+  uint16_t track;
+  if (!playQueue.pop(track)) return;
+  playerScheduler.playTrack(track);
+  announceQueuedTrack(track);
+}
+
+void announceQueuedTrack(int trackNumber) {
+  currentSong = trackNumber;
+  isPlaying = true;
+  LOG_INFO(LOG_QUEUE_TRACK, trackNumber, playQueue.size());
+}
+
+void printPlayQueue(Print& out) {
+  if (playQueue.size() == 0) {
+    out.println("QUEUE: Empty");
+    return;
+  }
+  out.print("QUEUE: ");
+  out.print(playQueue.size());
+  out.println(" tracks");
+  for (uint8_t i = 0; i < playQueue.size(); i++) {
+    out.print(i + 1);
+    out.print(". #");
+    out.print(playQueue.at(i));
+    out.print(" - ");
+    printSongInfo(out, playQueue.at(i));
+    out.println();
+  }
+}
+
+// Line up the track after the current one with the scheduler, so it is
+// sent the moment the finish frame arrives: the queue first, then shuffle
+void armNextTrack() {
+  uint16_t next = 0;
+  armedFromQueue = false;
+  if (isPlaying && playQueue.size() > 0) {
+    next = playQueue.peek();
+    armedFromQueue = true;
+  } else if (isPlaying && customShuffleMode) {
+    // Crosses into the next cycle without a repeat at the boundary
+    next = shuffleOrder.upcoming(shuffleIndex);
+  }
+  playerScheduler.armNext(next);
+}
+
+// Bookkeeping once the scheduler has sent the armed track on a finish
+// frame; the finish itself needs nothing more
+void announceArmedTrack() {
+  uint16_t started;
+  if (!playerScheduler.takeArmedStart(started)) return;
+  uint16_t finishedTrack;
+  playerScheduler.takeTrackFinished(finishedTrack);
+  if (armedFromQueue) {
+    if (playQueue.peek() == started) playQueue.pop(started);
+    announceQueuedTrack(started);
+  } else {
+    announceShuffleTrack(started);
+  }
+}
+
+//*****************************************************************************
+// Saved Player State
+//*****************************************************************************
+
+// Pick up what playerStateStore saved before the restart. A track that was
+// playing starts again from its beginning. False if nothing was saved.
+bool resumePlayerState() {
+  PlayerStateStore::State saved;
+  if (!playerStateStore.begin(saved)) return false;
+
+  currentVolume = saved.volume <= MAX_VOLUME ? saved.volume : MAX_VOLUME;
+  playerScheduler.volume(currentVolume);
+  currentSong = saved.track <= songCount() ? saved.track : 0;
+
+  // The shuffle order is only valid for the catalog it was made for
+  customShuffleMode = (saved.flags & PlayerStateStore::FLAG_SHUFFLE) &&
+                      shuffleSize > 0 && saved.shuffleSize == shuffleSize;
+  if (customShuffleMode) {
+    shuffleOrder.resume(saved.shuffleSize, saved.shuffleSeed, saved.shuffleCycle,
+                        saved.flags & PlayerStateStore::FLAG_SWAPPED_FIRST);
+    shuffleIndex = saved.shuffleIndex <= shuffleSize ? saved.shuffleIndex : shuffleSize;
+  }
+
+  Serial.print(F("RESUME: Volume "));
+  Serial.print(currentVolume);
+  if (customShuffleMode) {
+    Serial.print(F(", shuffle "));
+    Serial.print(shuffleIndex);
+    Serial.print(F("/"));
+    Serial.print(shuffleSize);
+  }
+  if ((saved.flags & PlayerStateStore::FLAG_PLAYING) && currentSong > 0) {
+    playerScheduler.playTrack(currentSong);
+    isPlaying = true;
+    Serial.print(F(", playing #"));
+    Serial.print(currentSong);
+    Serial.print(F(" - "));
+    printSongInfo(Serial, currentSong);
+  } else if (currentSong > 0) {
+    Serial.print(F(", track #"));
+    Serial.print(currentSong);
+  }
+  Serial.println();
+  return true;
+}
+
 //*****************************************************************************
 // Auto-progression Function
 //*****************************************************************************
 
 void checkAutoProgression() {
-  // Only check if we're in shuffle mode and playing
-  if (!customShuffleMode || !isPlaying) return;
-  
-  // Check state periodically
-  if (millis() - lastStateCheck >= stateCheckInterval) {
-    lastStateCheck = millis();
-    
-    uint8_t currentState = myDFPlayer.readState();
-    
-    // Handle the delayed state update issue
-    if (waitingForStateUpdate) {
-      // Second check - this should give us the correct state
-      if (currentState == 0) {  // Song finished
-        Serial.println("SHUFFLE: Song finished, playing next track");
-        playNextShuffleTrack();
-        waitingForStateUpdate = false;
-      } else {
-        // Still playing, reset flag
-        waitingForStateUpdate = false;
-      }
+  METRIC_TIMER(METRIC_AUTOPROGRESSION);
+  // Driven by the module's own "track finished" frame, parsed by
+  // playerScheduler.update() - no state polling on the UART. A finish that
+  // started an armed track was taken by announceArmedTrack() already.
+  uint16_t finishedTrack;
+  if (playerScheduler.takeTrackFinished(finishedTrack)) {
+    if (isPlaying && playQueue.size() > 0) {
+      playQueuedTrack();
+    } else if (customShuffleMode && isPlaying) {
+      LOG_INFO(LOG_SHUFFLE_FINISHED);
+      playNextShuffleTrack();
     } else {
-      // First check - if state changed from playing to stopped, set flag for next check
-      if (previousDFPlayerState != 0 && currentState == 0) {
-        waitingForStateUpdate = true;
-      }
+      isPlaying = false;
+      LOG_INFO(LOG_PLAY_FINISHED, finishedTrack);
     }
-    
-    previousDFPlayerState = currentState;
   }
+
+  armNextTrack();
 }
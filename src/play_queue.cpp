@@ -0,0 +1,24 @@
+/*
+   ESP32 RFID Jukebox - play queue
+*/
+
+#include "play_queue.h"
+
+bool PlayQueue::push(uint16_t track) {
+  if (count_ >= CAPACITY) {
+    dropped_++;
+    return false;
+  }
+  tracks_[(head_ + count_) % CAPACITY] = track;
+  count_++;
+  enqueued_++;
+  return true;
+}
+
+bool PlayQueue::pop(uint16_t& track) {
+  if (count_ == 0) return false;
+  track = tracks_[head_];
+  head_ = (head_ + 1) % CAPACITY;
+  count_--;
+  return true;
+}
@@ -0,0 +1,72 @@
+/*
+   ESP32 RFID Jukebox - player events
+*/
+
+#include "player_events.h"
+#include "jukebox.h"
+#include "song_catalog.h"
+#include "song_list_json.h"
+
+PlayerEvents::State PlayerEvents::capture() {
+  State state;
+  state.track = currentSong;
+  state.volume = currentVolume;
+  state.shufflePos = customShuffleMode ? shuffleIndex : 0;
+  state.shuffleSize = customShuffleMode ? shuffleSize : 0;
+  state.queued = playQueue.size();
+  state.playing = isPlaying;
+  state.shuffle = customShuffleMode;
+  state.jukebox = jukeboxMode;
+  return state;
+}
+
+void PlayerEvents::update() {
+  if (!sink_) return;
+
+  State now = capture();
+  if (!(now == seen_)) {
+    if (changed_) coalesced_++;
+    changed_ = true;
+    seen_ = now;
+  }
+  bool resend = resend_.exchange(false, std::memory_order_relaxed);
+  if (!resend && (!changed_ || millis() - lastStateMs_ < STATE_INTERVAL_MS)) return;
+
+  // A change that was undone within the interval needs no event
+  if (resend || !(now == sent_)) {
+    sendState(now);
+    sent_ = now;
+  }
+  changed_ = false;
+  lastStateMs_ = millis();
+}
+
+void PlayerEvents::commandResult(uint32_t ticket, const String& result) {
+  if (!sink_) return;
+  sink_("result", result.c_str(), ticket);
+  resultEvents_++;
+}
+
+void PlayerEvents::sendState(const State& state) {
+  SongInfo song;
+  if (!lookupSong(state.track, song)) {
+    song.title = "";
+    song.titleLength = 0;
+    song.artist = "";
+    song.artistLength = 0;
+  }
+
+  // Room for the fixed fields is reserved in STATE_JSON_SIZE
+  size_t n = snprintf(json_, sizeof(json_), "{\"track\":%d,\"title\":\"", state.track);
+  n += SongListJson::escape(json_ + n, sizeof(json_) - n, song.title, song.titleLength);
+  n += snprintf(json_ + n, sizeof(json_) - n, "\",\"artist\":\"");
+  n += SongListJson::escape(json_ + n, sizeof(json_) - n, song.artist, song.artistLength);
+  snprintf(json_ + n, sizeof(json_) - n,
+           "\",\"playing\":%s,\"volume\":%d,\"shuffle\":%s,\"shufflePos\":%d,"
+           "\"shuffleSize\":%d,\"queued\":%d,\"jukebox\":%s}",
+           state.playing ? "true" : "false", state.volume, state.shuffle ? "true" : "false",
+           state.shufflePos, state.shuffleSize, state.queued, state.jukebox ? "true" : "false");
+
+  sink_("state", json_, 0);
+  stateEvents_++;
+}
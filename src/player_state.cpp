@@ -0,0 +1,78 @@
+/*
+   ESP32 RFID Jukebox - saved player state
+*/
+
+#include "player_state.h"
+#include "jukebox.h"
+
+PlayerStateStore playerStateStore;
+
+static const char* const PREFS_NAMESPACE = "jukebox";
+static const char* const STATE_KEY = "state";
+
+static_assert(sizeof(PlayerStateStore::State) == 20, "saved state layout changed");
+
+PlayerStateStore::State PlayerStateStore::capture() {
+  State state = {};
+  state.version = VERSION;
+  state.volume = currentVolume;
+  state.track = currentSong > 0 ? currentSong : 0;
+  if (isPlaying) state.flags |= FLAG_PLAYING;
+  if (customShuffleMode) {
+    state.flags |= FLAG_SHUFFLE;
+    if (shuffleOrder.swappedFirst()) state.flags |= FLAG_SWAPPED_FIRST;
+    state.shuffleIndex = shuffleIndex;
+    state.shuffleSize = shuffleOrder.size();
+    state.shuffleSeed = shuffleOrder.seed();
+    state.shuffleCycle = shuffleOrder.cycle();
+  }
+  return state;
+}
+
+bool PlayerStateStore::begin(State& saved) {
+  open_ = prefs_.begin(PREFS_NAMESPACE, false);
+  if (!open_) return false;
+
+  State state;
+  if (prefs_.getBytes(STATE_KEY, &state, sizeof(state)) != sizeof(state) ||
+      state.version != VERSION) {
+    return false;
+  }
+  saved_ = state;
+  saved = state;
+  return true;
+}
+
+void PlayerStateStore::update() {
+  if (!open_) return;
+
+  State now = capture();
+  if (!(now == seen_)) {
+    seen_ = now;
+    changes_++;
+    lastChangeMs_ = millis();
+    if (!dirty_) firstChangeMs_ = lastChangeMs_;
+    dirty_ = true;
+  }
+  if (!dirty_) return;
+
+  // Wait for the changes to settle, but not forever
+  if (millis() - lastChangeMs_ < SAVE_DELAY_MS &&
+      millis() - firstChangeMs_ < MAX_SAVE_DELAY_MS) {
+    return;
+  }
+  flush();
+}
+
+void PlayerStateStore::flush() {
+  if (!open_) return;
+  seen_ = capture();
+  dirty_ = false;
+
+  // A change that was undone needs no write
+  if (seen_ == saved_) return;
+  if (prefs_.putBytes(STATE_KEY, &seen_, sizeof(seen_)) == sizeof(seen_)) {
+    saved_ = seen_;
+    saves_++;
+  }
+}
@@ -0,0 +1,109 @@
+/*
+   ESP32 RFID Jukebox - RC522 card detection
+*/
+
+#include "rfid_detector.h"
+#include "jukebox_tasks.h"
+
+// ComIEnReg / ComIrqReg bits
+static const byte IRQ_INV = 0x80;          // ComIEnReg: IRQ pin active low
+static const byte SET1 = 0x80;             // ComIrqReg: set (not clear) the marked bits
+static const byte RX_IRQ = 0x20;
+static const byte IDLE_IRQ = 0x10;
+static const byte ALL_IRQS = 0x7F;
+
+volatile bool RfidDetector::irqFlag_ = false;
+volatile uint32_t RfidDetector::irqCount_ = 0;
+
+void IRAM_ATTR RfidDetector::onIrq() {
+  irqFlag_ = true;
+  irqCount_++;
+  wakeTaskFromIsr(TASK_RFID);
+}
+
+void RfidDetector::begin(MFRC522& reader, uint8_t irqPin, RfidDetectMode mode) {
+  reader_ = &reader;
+  pinMode(irqPin, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(irqPin), onIrq, FALLING);
+
+  // Raise IdleIRq by hand and see whether the line follows
+  clearInterrupts();
+  irqFlag_ = false;
+  reader.PCD_WriteRegister(MFRC522::ComIEnReg, IRQ_INV | IDLE_IRQ);
+  reader.PCD_WriteRegister(MFRC522::ComIrqReg, SET1 | IDLE_IRQ);
+  delayMicroseconds(100);
+  irqWorks_ = irqFlag_;
+  reader.PCD_WriteRegister(MFRC522::ComIEnReg, IRQ_INV);
+  clearInterrupts();
+
+  if (!setMode(mode)) setMode(RFID_DETECT_POLL);
+}
+
+bool RfidDetector::setMode(RfidDetectMode mode) {
+  if (mode == RFID_DETECT_IRQ && !irqWorks_) return false;
+  mode_ = mode;
+  // Only an answered REQA (RxIRq) may pull the line in IRQ mode
+  reader_->PCD_WriteRegister(MFRC522::ComIEnReg, mode == RFID_DETECT_IRQ ? IRQ_INV | RX_IRQ : IRQ_INV);
+  clearInterrupts();
+  irqFlag_ = false;
+  resetStats();
+  return true;
+}
+
+bool RfidDetector::cardPresent() {
+  uint32_t start = micros();
+  bool present;
+  passes_++;
+  if (mode_ == RFID_DETECT_POLL) {
+    present = reader_->PICC_IsNewCardPresent();
+    spiTransactions_ += POLL_SPI;
+  } else if (irqFlag_) {
+    // The last REQA was answered: the card is ready to be selected
+    irqFlag_ = false;
+    interrupts_++;
+    present = true;
+  } else {
+    // Send the next REQA and return without waiting for an answer
+    clearInterrupts();
+    reader_->PCD_WriteRegister(MFRC522::FIFODataReg, MFRC522::PICC_CMD_REQA);
+    reader_->PCD_WriteRegister(MFRC522::CommandReg, MFRC522::PCD_Transceive);
+    reader_->PCD_WriteRegister(MFRC522::BitFramingReg, 0x87);  // StartSend, 7-bit frame
+    spiTransactions_ += ARM_SPI - 1;
+    present = false;
+  }
+  cpuUs_ += micros() - start;
+  return present;
+}
+
+void RfidDetector::cardDone() {
+  if (mode_ != RFID_DETECT_IRQ) return;
+  clearInterrupts();
+  irqFlag_ = false;
+}
+
+void RfidDetector::clearInterrupts() {
+  reader_->PCD_WriteRegister(MFRC522::ComIrqReg, ALL_IRQS);
+  spiTransactions_++;
+}
+
+void RfidDetector::resetStats() {
+  passes_ = 0;
+  interrupts_ = 0;
+  spiTransactions_ = 0;
+  cpuUs_ = 0;
+  sinceMs_ = millis();
+}
+
+float RfidDetector::spiPerSecond() const {
+  uint32_t elapsed = millis() - sinceMs_;
+  return elapsed ? spiTransactions_ * 1000.0f / elapsed : 0;
+}
+
+float RfidDetector::cpuPercent() const {
+  uint32_t elapsed = millis() - sinceMs_;
+  return elapsed ? cpuUs_ / (elapsed * 10.0f) : 0;
+}
+
+const char* RfidDetector::modeName(RfidDetectMode mode) {
+  return mode == RFID_DETECT_IRQ ? "IRQ" : "polling";
+}
@@ -0,0 +1,73 @@
+/*
+   ESP32 RFID Jukebox - shuffle order
+*/
+
+#include "shuffle_order.h"
+
+// 32-bit avalanche mix (murmur3 finalizer)
+static uint32_t mix32(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x85EBCA6Bu;
+  x ^= x >> 13;
+  x *= 0xC2B2AE35u;
+  x ^= x >> 16;
+  return x;
+}
+
+void ShuffleOrder::begin(uint16_t size, uint32_t seed) {
+  size_ = size;
+  seed_ = seed;
+  cycle_ = 0;
+  swapFirst_ = false;
+
+  // Smallest 2 * halfBits_ >= bits needed for size - 1
+  uint8_t bits = 1;
+  while (bits < 16 && (1u << bits) < size) bits++;
+  halfBits_ = (bits + 1) / 2;
+}
+
+void ShuffleOrder::resume(uint16_t size, uint32_t seed, uint32_t cycle, bool swappedFirst) {
+  begin(size, seed);
+  cycle_ = cycle;
+  swapFirst_ = swappedFirst && size >= 2;
+}
+
+void ShuffleOrder::nextCycle() {
+  uint16_t last = at(size_ - 1);
+  cycle_++;
+  swapFirst_ = false;
+  if (size_ >= 2 && at(0) == last) swapFirst_ = true;
+}
+
+uint16_t ShuffleOrder::at(uint16_t position) const {
+  if (position >= size_) return 0;
+  if (swapFirst_ && position < 2) position ^= 1;
+
+  // The network permutes [0, 4^halfBits); walk until the value is a track
+  uint32_t value = permute(position);
+  while (value >= size_) value = permute(value);
+  return value + 1;
+}
+
+uint16_t ShuffleOrder::upcoming(uint16_t position) const {
+  if (position < size_) return at(position);
+  ShuffleOrder next = *this;
+  next.nextCycle();
+  return next.at(0);
+}
+
+uint32_t ShuffleOrder::roundKey(uint8_t round) const {
+  return mix32(seed_ ^ mix32(cycle_ * ROUNDS + round + 1));
+}
+
+uint32_t ShuffleOrder::permute(uint32_t value) const {
+  uint32_t mask = (1u << halfBits_) - 1;
+  uint32_t left = value >> halfBits_;
+  uint32_t right = value & mask;
+  for (uint8_t round = 0; round < ROUNDS; round++) {
+    uint32_t next = left ^ (mix32(right ^ roundKey(round)) & mask);
+    left = right;
+    right = next;
+  }
+  return (left << halfBits_) | right;
+}
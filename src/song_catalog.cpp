@@ -0,0 +1,152 @@
+/*
+   ESP32 RFID Jukebox - song catalog
+*/
+
+#include "song_catalog.h"
+#include "song_catalog_data.h"
+
+static const uint8_t CATALOG_MAGIC[4] = {'J', 'B', 'S', 0x01};
+static const uint32_t CATALOG_HEADER_SIZE = 8;
+
+static fs::FS* catalogFs = nullptr;            // where the catalog file lives
+static const char* catalogPath = nullptr;
+static uint16_t catalogCount = 0;              // 0 = built-in table
+static SongCatalogReader catalogReader;        // reader of the loop task
+
+static uint32_t readLE32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Split [len][title]\0[len][artist]\0 into info; false if it doesn't fit size
+static bool parseRecord(const char* record, uint32_t size, SongInfo& info) {
+  if (size < 4) return false;
+  info.titleLength = (uint8_t)record[0];
+  info.title = record + 1;
+  uint32_t artistAt = info.titleLength + 2u;
+  if (artistAt + 2 > size) return false;
+  info.artistLength = (uint8_t)record[artistAt];
+  info.artist = record + artistAt + 1;
+  return artistAt + info.artistLength + 2 <= size;
+}
+
+//*****************************************************************************
+// SongCatalogReader
+//*****************************************************************************
+
+bool SongCatalogReader::open() {
+  close();
+  opened_ = true;
+  if (catalogCount == 0) return true;
+  file_ = catalogFs->open(catalogPath, FILE_READ);
+  return (bool)file_;
+}
+
+void SongCatalogReader::close() {
+  if (file_) file_.close();
+  recordTrack_ = 0;
+  opened_ = false;
+}
+
+bool SongCatalogReader::lookup(int trackNumber, SongInfo& info) {
+  if (trackNumber < 1 || trackNumber > songCount()) return false;
+
+  if (catalogCount == 0) {
+    const char* entry = SONG_CATALOG_DATA + SONG_CATALOG_OFFSETS[trackNumber - 1];
+    return parseRecord(entry, MAX_RECORD, info);
+  }
+
+  // The current song is looked up over and over (status, list, web)
+  if (recordTrack_ == trackNumber) {
+    return parseRecord(record_, sizeof(record_), info);
+  }
+  if (!file_) return false;
+
+  // Index entries i and i+1 give the record's position and size
+  uint8_t index[8];
+  if (!file_.seek(CATALOG_HEADER_SIZE + (trackNumber - 1) * 4) ||
+      file_.read(index, sizeof(index)) != sizeof(index)) {
+    return false;
+  }
+  uint32_t start = readLE32(index);
+  uint32_t end = readLE32(index + 4);
+  if (end <= start || end - start > sizeof(record_)) return false;
+
+  uint32_t size = end - start;
+  recordTrack_ = 0;
+  if (!file_.seek(start) || file_.read((uint8_t*)record_, size) != size) {
+    return false;
+  }
+  if (!parseRecord(record_, size, info)) return false;
+  recordTrack_ = trackNumber;
+  return true;
+}
+
+void SongCatalogReader::print(Print& out, int trackNumber) {
+  if (!opened_) open();
+  SongInfo info;
+  if (lookup(trackNumber, info)) {
+    out.write((const uint8_t*)info.title, info.titleLength);
+    out.print(" - ");
+    out.write((const uint8_t*)info.artist, info.artistLength);
+  } else {
+    out.print("Unknown Track #");
+    out.print(trackNumber);
+  }
+}
+
+//*****************************************************************************
+// Catalog
+//*****************************************************************************
+
+bool beginSongCatalog(fs::FS& fs, const char* path) {
+  catalogReader.close();
+  catalogCount = 0;
+  catalogFs = &fs;
+  catalogPath = path;
+
+  if (!fs.exists(path)) return false;
+  File file = fs.open(path, FILE_READ);
+  if (!file) return false;
+
+  uint8_t header[CATALOG_HEADER_SIZE];
+  bool valid = file.read(header, sizeof(header)) == sizeof(header) &&
+               memcmp(header, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) == 0;
+  uint32_t count = valid ? readLE32(header + 4) : 0;
+  valid = valid && count > 0 && count <= 0xFFFF &&
+          file.size() >= CATALOG_HEADER_SIZE + (count + 1) * 4;
+  file.close();
+  if (!valid) return false;
+
+  catalogCount = (uint16_t)count;
+  if (!catalogReader.open()) {
+    catalogCount = 0;
+    return false;
+  }
+  return true;
+}
+
+uint16_t songCount() {
+  return catalogCount ? catalogCount : SONG_CATALOG_COUNT;
+}
+
+bool songCatalogFromFile() {
+  return catalogCount != 0;
+}
+
+bool lookupSong(int trackNumber, SongInfo& info) {
+  return catalogReader.lookup(trackNumber, info);
+}
+
+const char* songTitle(int trackNumber) {
+  SongInfo info;
+  return lookupSong(trackNumber, info) ? info.title : nullptr;
+}
+
+const char* songArtist(int trackNumber) {
+  SongInfo info;
+  return lookupSong(trackNumber, info) ? info.artist : nullptr;
+}
+
+void printSongInfo(Print& out, int trackNumber) {
+  catalogReader.print(out, trackNumber);
+}
@@ -0,0 +1,107 @@
+/*
+   ESP32 RFID Jukebox - streamed JSON song list
+*/
+
+#include "song_list_json.h"
+
+bool SongListJson::begin(uint32_t offset, uint32_t limit) {
+  uint32_t total = songCount();
+  offset_ = offset;
+  first_ = offset < total ? offset + 1 : total + 1;
+  end_ = (limit < total + 1 - first_) ? first_ + limit : total + 1;
+  next_ = first_;
+  stage_ = HEADER;
+  pendingLength_ = 0;
+  pendingPos_ = 0;
+  return reader_.open();
+}
+
+size_t SongListJson::read(uint8_t* buffer, size_t maxLen) {
+  size_t written = 0;
+  while (written < maxLen) {
+    if (pendingPos_ == pendingLength_) {
+      if (stage_ == DONE) break;
+      render();
+      continue;
+    }
+    size_t n = pendingLength_ - pendingPos_;
+    if (n > maxLen - written) n = maxLen - written;
+    memcpy(buffer + written, pending_ + pendingPos_, n);
+    pendingPos_ += n;
+    written += n;
+  }
+  if (stage_ == DONE && pendingPos_ == pendingLength_) reader_.close();
+  return written;
+}
+
+void SongListJson::render() {
+  pendingLength_ = 0;
+  pendingPos_ = 0;
+  char number[48];
+
+  switch (stage_) {
+    case HEADER:
+      snprintf(number, sizeof(number), "{\"total\":%u,\"offset\":%u,\"count\":%u,\"songs\":[",
+               (unsigned)songCount(), (unsigned)offset_, (unsigned)count());
+      append(number);
+      stage_ = next_ < end_ ? SONGS : FOOTER;
+      break;
+
+    case SONGS: {
+      SongInfo song;
+      if (!reader_.lookup(next_, song)) {
+        song.title = "";
+        song.titleLength = 0;
+        song.artist = "";
+        song.artistLength = 0;
+      }
+      snprintf(number, sizeof(number), "%s{\"n\":%u,\"title\":\"",
+               next_ == first_ ? "" : ",", (unsigned)next_);
+      append(number);
+      appendEscaped(song.title, song.titleLength);
+      append("\",\"artist\":\"");
+      appendEscaped(song.artist, song.artistLength);
+      append("\"}");
+      if (++next_ >= end_) stage_ = FOOTER;
+      break;
+    }
+
+    case FOOTER:
+      append("]}");
+      stage_ = DONE;
+      break;
+
+    case DONE:
+      break;
+  }
+}
+
+void SongListJson::append(const char* text) {
+  size_t n = strlen(text);
+  if (n > (size_t)(PENDING_SIZE - pendingLength_)) n = PENDING_SIZE - pendingLength_;
+  memcpy(pending_ + pendingLength_, text, n);
+  pendingLength_ += n;
+}
+
+void SongListJson::appendEscaped(const char* text, uint8_t length) {
+  pendingLength_ += escape(pending_ + pendingLength_, PENDING_SIZE - pendingLength_, text, length);
+}
+
+size_t SongListJson::escape(char* out, size_t room, const char* text, size_t length) {
+  size_t n = 0;
+  for (size_t i = 0; i < length && n + 2 <= room; i++) {
+    char c = text[i];
+    if (c == '"' || c == '\\') {
+      out[n++] = '\\';
+      out[n++] = c;
+    } else if (c == '\n') {
+      out[n++] = '\\';                      // command results are multi-line
+      out[n++] = 'n';
+    } else if ((uint8_t)c < 0x20) {
+      out[n++] = ' ';                       // other control characters as spaces
+    } else {
+      out[n++] = c;                         // UTF-8 passes through
+    }
+  }
+  return n;
+}
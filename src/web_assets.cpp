@@ -0,0 +1,119 @@
+/*
+   ESP32 RFID Jukebox - compressed web assets
+*/
+
+#include "web_assets.h"
+
+static const uint8_t MAX_WEB_ASSETS = 8;
+static const size_t MAX_INDEX_SIZE = 512;
+
+static WebAsset assets[MAX_WEB_ASSETS];
+static uint8_t assetCount = 0;
+
+struct ContentType {
+  const char* extension;
+  const char* type;
+};
+
+static const ContentType CONTENT_TYPES[] = {
+  {".html", "text/html"},
+  {".css", "text/css"},
+  {".js", "application/javascript"},
+  {".json", "application/json"},
+  {".svg", "image/svg+xml"},
+};
+
+static bool endsWith(const char* text, const char* suffix) {
+  size_t length = strlen(text);
+  size_t suffixLength = strlen(suffix);
+  return length >= suffixLength && strcmp(text + length - suffixLength, suffix) == 0;
+}
+
+// Next space-separated field of line at i into out; false if missing or too long
+static bool readField(const char* line, size_t& i, char* out, size_t size) {
+  while (line[i] == ' ') i++;
+  size_t length = 0;
+  while (line[i] != '\0' && line[i] != ' ') {
+    if (length + 1 >= size) return false;
+    out[length++] = line[i++];
+  }
+  out[length] = '\0';
+  return length > 0;
+}
+
+static bool parseAsset(const char* line, WebAsset& asset) {
+  size_t i = 0;
+  if (!readField(line, i, asset.path, sizeof(asset.path)) ||
+      !readField(line, i, asset.file, sizeof(asset.file)) ||
+      !readField(line, i, asset.etag, sizeof(asset.etag))) {
+    return false;
+  }
+  size_t etagLength = strlen(asset.etag);
+  if (asset.path[0] != '/' || asset.file[0] != '/' || etagLength < 3 ||
+      asset.etag[0] != '"' || asset.etag[etagLength - 1] != '"') {
+    return false;
+  }
+
+  asset.contentType = "application/octet-stream";
+  for (const ContentType& type : CONTENT_TYPES) {
+    if (endsWith(asset.path, type.extension)) asset.contentType = type.type;
+  }
+  asset.cacheControl = endsWith(asset.path, ".html") ? "no-cache" : "public, max-age=86400";
+  return true;
+}
+
+bool beginWebAssets(fs::FS& fs, const char* path) {
+  assetCount = 0;
+  File file = fs.open(path, FILE_READ);
+  if (!file) return false;
+
+  char text[MAX_INDEX_SIZE + 1];
+  size_t length = file.read((uint8_t*)text, MAX_INDEX_SIZE);
+  file.close();
+  text[length] = '\0';
+
+  char* line = text;
+  while (*line != '\0' && assetCount < MAX_WEB_ASSETS) {
+    char* end = strchr(line, '\n');
+    if (end) *end = '\0';
+    if (parseAsset(line, assets[assetCount])) assetCount++;
+    if (!end) break;
+    line = end + 1;
+  }
+  return assetCount > 0;
+}
+
+uint8_t webAssetCount() {
+  return assetCount;
+}
+
+const WebAsset& webAsset(uint8_t i) {
+  return assets[i];
+}
+
+const WebAsset* findWebAsset(const char* path) {
+  if (strcmp(path, "/") == 0) path = "/index.html";
+  for (uint8_t i = 0; i < assetCount; i++) {
+    if (strcmp(assets[i].path, path) == 0) return &assets[i];
+  }
+  return nullptr;
+}
+
+bool etagMatches(const char* ifNoneMatch, const char* etag) {
+  if (ifNoneMatch == nullptr) return false;
+  size_t etagLength = strlen(etag);
+  const char* p = ifNoneMatch;
+  while (*p != '\0') {
+    while (*p == ' ' || *p == ',') p++;
+    if (*p == '*') return true;
+    // If-None-Match compares weakly: W/"x" matches "x"
+    if (p[0] == 'W' && p[1] == '/') p += 2;
+    const char* end = p;
+    while (*end != '\0' && *end != ',') end++;
+    const char* tagEnd = end;
+    while (tagEnd > p && tagEnd[-1] == ' ') tagEnd--;
+    if ((size_t)(tagEnd - p) == etagLength && memcmp(p, etag, etagLength) == 0) return true;
+    p = end;
+  }
+  return false;
+}
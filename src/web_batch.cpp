@@ -0,0 +1,62 @@
+/*
+   ESP32 RFID Jukebox - batch web commands
+*/
+
+#include "web_batch.h"
+#include "jukebox.h"
+#include "song_list_json.h"
+
+int parseWebBatch(const char* body, size_t length, WebCommand* commands, uint8_t max,
+                  int& errorLine) {
+  int count = 0;
+  int line = 0;
+  size_t start = 0;
+  while (start < length) {
+    size_t end = start;
+    while (end < length && body[end] != '\n' && body[end] != ';') end++;
+    line++;
+
+    // Trim spaces and the CR of CRLF line ends
+    size_t first = start;
+    size_t last = end;
+    while (first < last && (body[first] == ' ' || body[first] == '\t')) first++;
+    while (last > first && (body[last - 1] == ' ' || body[last - 1] == '\t' || body[last - 1] == '\r')) last--;
+
+    if (last > first) {
+      if (count == max || !parseCommand(body + first, last - first, commands[count].call)) {
+        errorLine = line;
+        return -1;
+      }
+      commands[count].ticket = 0;
+      commands[count].batchRemaining = 0;
+      count++;
+    }
+    start = end + 1;
+  }
+  return count;
+}
+
+String webBatchResults(uint32_t firstTicket, uint8_t count) {
+  static char text[WebResponseRing::SLOT_SIZE + 1];   // only the async_tcp task builds batches
+  static char escaped[2 * WebResponseRing::SLOT_SIZE];
+
+  String json;
+  json.reserve(64 + count * 120);
+  json = "{\"results\":[";
+  for (uint8_t i = 0; i < count; i++) {
+    uint32_t ticket = firstTicket + i;
+    if (i > 0) json += ",";
+    json += "{\"ticket\":" + String(ticket) + ",\"result\":";
+    if (webResponses.read(ticket, text, sizeof(text))) {
+      size_t n = SongListJson::escape(escaped, sizeof(escaped) - 1, text, strlen(text));
+      escaped[n] = '\0';
+      json += "\"";
+      json += escaped;
+      json += "\"}";
+    } else {
+      json += "null}";
+    }
+  }
+  json += "]}";
+  return json;
+}
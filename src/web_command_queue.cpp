@@ -0,0 +1,59 @@
+/*
+   ESP32 RFID Jukebox - web command queue
+*/
+
+#include "web_command_queue.h"
+
+uint32_t WebCommandQueue::push(const CommandCall& call) {
+  WebCommand command = {0, 0, call};
+  return pushBatch(&command, 1);
+}
+
+uint32_t WebCommandQueue::pushBatch(const WebCommand* commands, uint8_t count) {
+  if (count == 0 || count > BATCH_MAX) return 0;
+  uint32_t tail = tail_.load(std::memory_order_relaxed);
+  uint32_t head = head_.load(std::memory_order_acquire);
+  if (tail - head + count > CAPACITY) {
+    dropped_.fetch_add(count, std::memory_order_relaxed);
+    return 0;
+  }
+
+  uint32_t first = nextTicket_.fetch_add(count, std::memory_order_relaxed);
+  for (uint8_t i = 0; i < count; i++) {
+    WebCommand& slot = slots_[(tail + i) & (CAPACITY - 1)];
+    slot.ticket = first + i;
+    slot.batchRemaining = count - 1 - i;
+    slot.call = commands[i].call;
+  }
+
+  // Publish the slot contents before the new tail
+  tail_.store(tail + count, std::memory_order_release);
+
+  uint32_t depth = tail + count - head;
+  if (depth > maxDepth_.load(std::memory_order_relaxed)) {
+    maxDepth_.store(depth, std::memory_order_relaxed);
+  }
+  return first;
+}
+
+bool WebCommandQueue::pop(WebCommand& command) {
+  uint32_t head = head_.load(std::memory_order_relaxed);
+  uint32_t tail = tail_.load(std::memory_order_acquire);
+  if (head == tail) return false;
+
+  command = slots_[head & (CAPACITY - 1)];
+
+  // Hand the slot back to the producer only after it has been copied out
+  head_.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+void WebCommandQueue::complete(uint32_t ticket) {
+  lastCompleted_.store(ticket, std::memory_order_relaxed);
+}
+
+uint32_t WebCommandQueue::depth() const {
+  uint32_t tail = tail_.load(std::memory_order_acquire);
+  uint32_t head = head_.load(std::memory_order_acquire);
+  return tail - head;
+}
@@ -0,0 +1,50 @@
+/*
+   ESP32 RFID Jukebox - web response slots
+*/
+
+#include "web_response_ring.h"
+#include "web_command_queue.h"
+
+// A full queue drained in one pass must not wrap around the ring
+static_assert(WebResponseRing::SLOTS >= WebCommandQueue::CAPACITY + WebCommandQueue::BATCH_MAX,
+              "response ring smaller than one pass of web commands");
+
+void WebResponseRing::store(uint32_t ticket, const char* text, size_t length) {
+  if (ticket == 0) return;
+  Slot& slot = slots_[ticket % SLOTS];
+
+  slot.ticket.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  if (length > SLOT_SIZE) {
+    length = SLOT_SIZE;
+    truncated_++;
+  }
+  memcpy(slot.text, text, length);
+  slot.length = length;
+
+  slot.ticket.store(ticket, std::memory_order_release);
+  latest_.store(ticket, std::memory_order_release);
+  stored_++;
+}
+
+bool WebResponseRing::read(uint32_t ticket, char* out, size_t size) const {
+  if (ticket == 0 || size == 0) return false;
+  const Slot& slot = slots_[ticket % SLOTS];
+
+  if (slot.ticket.load(std::memory_order_acquire) != ticket) {
+    if (ticket <= latest()) expired_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  size_t length = slot.length < size - 1 ? slot.length : size - 1;
+  memcpy(out, slot.text, length);
+  out[length] = '\0';
+
+  // Overwritten while copying: the text may be half of a newer result
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot.ticket.load(std::memory_order_relaxed) != ticket) {
+    expired_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
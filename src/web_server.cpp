@@ -0,0 +1,389 @@
+/*
+   ESP32 RFID Jukebox - WiFi web interface
+
+   AsyncWebServer routes for the browser UI and the HTTP API. Kept apart
+   from main.cpp so the host-native simulation build can leave the network
+   stack out (see [env:native] in platformio.ini).
+
+   The handlers run on the async_tcp task. They only validate the request
+   and push it into webCommands; the player task executes it
+   (handleWebCommands()). Results and player state go back over the
+   /events stream (PlayerEvents).
+
+   The library locks neither the event source's client list nor a
+   client's message queue, and async_tcp changes both as clients connect,
+   disconnect and acknowledge. So events.send() is only called on
+   async_tcp: the player task leaves the latest state and the tickets of
+   new results here, and the poll of each /events connection (every
+   500 ms) sends them.
+*/
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <ESPAsyncWebServer.h>
+#include <SPIFFS.h>
+#include "jukebox.h"
+#include "song_catalog.h"
+#include "song_list_json.h"
+#include "web_batch.h"
+#include "web_assets.h"
+#include <atomic>
+#include <memory>
+#include <freertos/semphr.h>
+
+// Web server for WiFi commands
+AsyncWebServer server(80);              // Web server on port 80
+AsyncEventSource events("/events");     // Command results and player state (SSE)
+
+//*****************************************************************************
+// WiFi Web Interface Functions
+//*****************************************************************************
+
+// Answer a queued command: 202 with its ticket, or 503 if the queue was full
+static void sendTicket(AsyncWebServerRequest *request, uint32_t ticket,
+                       const char* contentType, const String& body) {
+  if (ticket == 0) {
+    request->send(503, "text/plain", "Command queue full, try again");
+    return;
+  }
+  AsyncWebServerResponse *response = request->beginResponse(202, contentType, body);
+  response->addHeader("X-Ticket", String(ticket));
+  request->send(response);
+}
+
+// Largest /api/batch body accepted
+static const size_t BATCH_BODY_MAX = 512;
+
+// Collect a POST body into request->_tempObject, NUL-terminated; freed
+// with the request. Left null when the body is over BATCH_BODY_MAX.
+static void collectBody(AsyncWebServerRequest *request, uint8_t *data, size_t len,
+                        size_t index, size_t total) {
+  if (index == 0 && total <= BATCH_BODY_MAX) {
+    request->_tempObject = malloc(total + 1);
+  }
+  char* body = (char*)request->_tempObject;
+  if (body && index + len <= total) {
+    memcpy(body + index, data, len);
+    body[index + len] = '\0';
+  }
+}
+
+// A UI file from the asset index: 304 if the browser's copy is current,
+// else the gzipped file. Without an index, the plain /index.html.
+static void sendWebAsset(AsyncWebServerRequest *request) {
+  const WebAsset* asset = findWebAsset(request->url().c_str());
+  if (asset == nullptr) {
+    if (SPIFFS.exists("/index.html")) {
+      request->send(SPIFFS, "/index.html", "text/html");
+    } else {
+      request->send(404, "text/plain", "Web interface not found. Please upload SPIFFS filesystem.");
+    }
+    return;
+  }
+
+  AsyncWebServerResponse *response;
+  AsyncWebHeader* ifNoneMatch = request->getHeader("If-None-Match");
+  if (ifNoneMatch && etagMatches(ifNoneMatch->value().c_str(), asset->etag)) {
+    response = request->beginResponse(304);
+  } else {
+    File file = SPIFFS.open(asset->file, FILE_READ);
+    if (!file) {
+      request->send(404, "text/plain", "Web interface not found. Please upload SPIFFS filesystem.");
+      return;
+    }
+    // Named after the .gz file, so the library adds no encoding of its own
+    response = request->beginResponse(file, asset->file, asset->contentType);
+    response->addHeader("Content-Encoding", "gzip");
+  }
+  response->addHeader("ETag", asset->etag);
+  response->addHeader("Cache-Control", asset->cacheControl);
+  request->send(response);
+}
+
+// Events on their way from the player task to async_tcp
+static const uint32_t RESULT_TICKETS = 16;              // a power of two
+static uint32_t resultTickets[RESULT_TICKETS];
+static std::atomic<uint32_t> resultsQueued{0};          // written by the player task
+static std::atomic<uint32_t> resultsSent{0};            // written by async_tcp
+static SemaphoreHandle_t stateLock = nullptr;           // guards the two below
+static char stateJson[PlayerEvents::STATE_JSON_SIZE];
+static bool stateWaiting = false;
+
+// PlayerEvents sink (player task): hand the event over to async_tcp. A
+// result that doesn't fit is left to /response; a newer state replaces
+// one not sent yet.
+static void queueEvent(const char* event, const char* data, uint32_t id) {
+  if (strcmp(event, "result") == 0) {
+    uint32_t queued = resultsQueued.load(std::memory_order_relaxed);
+    if (queued - resultsSent.load(std::memory_order_acquire) >= RESULT_TICKETS) return;
+    resultTickets[queued & (RESULT_TICKETS - 1)] = id;
+    resultsQueued.store(queued + 1, std::memory_order_release);
+    return;
+  }
+  xSemaphoreTake(stateLock, portMAX_DELAY);
+  strlcpy(stateJson, data, sizeof(stateJson));
+  stateWaiting = true;
+  xSemaphoreGive(stateLock);
+}
+
+// async_tcp: send the queued events to the open /events connections; the
+// result text comes from webResponses
+static void sendQueuedEvents() {
+  static char text[PlayerEvents::STATE_JSON_SIZE > WebResponseRing::SLOT_SIZE + 1
+                   ? PlayerEvents::STATE_JSON_SIZE : WebResponseRing::SLOT_SIZE + 1];
+
+  xSemaphoreTake(stateLock, portMAX_DELAY);
+  bool state = stateWaiting;
+  if (state) strlcpy(text, stateJson, sizeof(text));
+  stateWaiting = false;
+  xSemaphoreGive(stateLock);
+  if (state) events.send(text, "state", 0);
+
+  uint32_t sent = resultsSent.load(std::memory_order_relaxed);
+  uint32_t queued = resultsQueued.load(std::memory_order_acquire);
+  for (; sent != queued; sent++) {
+    uint32_t ticket = resultTickets[sent & (RESULT_TICKETS - 1)];
+    if (webResponses.read(ticket, text, sizeof(text))) events.send(text, "result", ticket);
+  }
+  resultsSent.store(sent, std::memory_order_release);
+}
+
+void setupWebServer() {
+  if (WiFi.status() != WL_CONNECTED) {
+    Serial.println(F("WARNING: Cannot setup Web Server - WiFi not connected"));
+    return;
+  }
+  
+  // Main web page and the other UI files - gzipped on SPIFFS (web_assets.h)
+  server.on("/", HTTP_GET, sendWebAsset);
+  for (uint8_t i = 0; i < webAssetCount(); i++) {
+    server.on(webAsset(i).path, HTTP_GET, sendWebAsset);
+  }
+  
+  // Command endpoint - queued for the player task, answered with the ticket number
+  server.on("/cmd", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (request->hasParam("c")) {
+      String command = request->getParam("c")->value();
+      CommandCall call;
+      if (parseCommand(command.c_str(), command.length(), call)) {
+        uint32_t ticket = webCommands.push(call);
+        sendTicket(request, ticket, "text/plain", "Command queued #" + String(ticket));
+      } else {
+        request->send(400, "text/plain", "Invalid command");
+      }
+    } else {
+      request->send(400, "text/plain", "Missing command parameter");
+    }
+  });
+  
+  // Play song endpoint
+  server.on("/play", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (request->hasParam("song")) {
+      String songParam = request->getParam("song")->value();
+      int songNumber = songParam.toInt();
+      if (songNumber >= 1 && songNumber <= songCount()) {
+        uint32_t ticket = webCommands.push({CMD_PLAY, songNumber});
+        sendTicket(request, ticket, "text/plain", "Song " + String(songNumber) + " queued #" + String(ticket));
+      } else {
+        request->send(400, "text/plain", "Invalid song number");
+      }
+    } else {
+      request->send(400, "text/plain", "Missing song parameter");
+    }
+  });
+  
+  // Add a song to the play queue
+  server.on("/queue", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (request->hasParam("song")) {
+      int songNumber = request->getParam("song")->value().toInt();
+      if (songNumber >= 1 && songNumber <= songCount()) {
+        uint32_t ticket = webCommands.push({CMD_ADD_TO_QUEUE, songNumber});
+        sendTicket(request, ticket, "text/plain", "Song " + String(songNumber) + " queued #" + String(ticket));
+      } else {
+        request->send(400, "text/plain", "Invalid song number");
+      }
+    } else {
+      request->send(400, "text/plain", "Missing song parameter");
+    }
+  });
+
+  // Result of a command: /response?id=<ticket>, or the latest without id
+  server.on("/response", HTTP_GET, [](AsyncWebServerRequest *request){
+    static char text[WebResponseRing::SLOT_SIZE + 1];   // handlers all run on async_tcp
+    uint32_t ticket = webResponses.latest();
+    if (request->hasParam("id")) ticket = request->getParam("id")->value().toInt();
+    if (webResponses.read(ticket, text, sizeof(text))) {
+      request->send(200, "text/plain", text);
+    } else if (ticket > webCommands.lastCompleted()) {
+      request->send(202, "text/plain", "Command not executed yet");
+    } else {
+      request->send(404, "text/plain", "No result for this command (expired)");
+    }
+  });
+  
+  // API endpoint for programmatic access
+  server.on("/api/command", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (request->hasParam("cmd")) {
+      String command = request->getParam("cmd")->value();
+      CommandCall call;
+      if (parseCommand(command.c_str(), command.length(), call)) {
+        uint32_t ticket = webCommands.push(call);
+        sendTicket(request, ticket, "application/json",
+          "{\"command\":\"" + commandText(call) + "\",\"ticket\":" + String(ticket) + "}");
+      } else {
+        request->send(400, "application/json", 
+          "{\"error\":\"Unknown command\"}");
+      }
+    } else {
+      request->send(400, "application/json", 
+        "{\"error\":\"Missing cmd parameter\"}");
+    }
+  });
+
+  // Song list as JSON, streamed in chunks; ?offset=&limit= select a page
+  server.on("/api/songs", HTTP_GET, [](AsyncWebServerRequest *request){
+    uint32_t offset = 0;
+    uint32_t limit = 0xFFFFFFFF;
+    if (request->hasParam("offset")) offset = request->getParam("offset")->value().toInt();
+    if (request->hasParam("limit")) limit = request->getParam("limit")->value().toInt();
+    auto stream = std::make_shared<SongListJson>();
+    if (!stream->begin(offset, limit)) {
+      request->send(500, "application/json", "{\"error\":\"Song catalog unavailable\"}");
+      return;
+    }
+    request->send(request->beginChunkedResponse("application/json",
+      [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+        return stream->read(buffer, maxLen);
+      }));
+  });
+
+  // Batch of commands in the request body, queued as one unit
+  server.on("/api/batch", HTTP_POST, [](AsyncWebServerRequest *request){
+    const char* body = (const char*)request->_tempObject;
+    if (!body) {
+      request->send(400, "application/json", "{\"error\":\"Missing or oversized batch body\"}");
+      return;
+    }
+    WebCommand commands[WebCommandQueue::BATCH_MAX];
+    int errorLine = 0;
+    int count = parseWebBatch(body, request->contentLength(), commands,
+                              WebCommandQueue::BATCH_MAX, errorLine);
+    if (count < 0) {
+      request->send(400, "application/json",
+        "{\"error\":\"Unknown command or too many commands\",\"line\":" + String(errorLine) + "}");
+      return;
+    }
+    if (count == 0) {
+      request->send(400, "application/json", "{\"error\":\"Empty batch\"}");
+      return;
+    }
+    uint32_t first = webCommands.pushBatch(commands, count);
+    if (first == 0) {
+      request->send(503, "application/json", "{\"error\":\"Command queue full, try again\"}");
+      return;
+    }
+
+    // The player task runs it; results come as /events result events or
+    // from GET /api/batch, never by waiting here on async_tcp
+    AsyncWebServerResponse *response = request->beginResponse(202, "application/json",
+      "{\"first\":" + String(first) + ",\"count\":" + String(count) + "}");
+    response->addHeader("X-Ticket", String(first));
+    request->send(response);
+  }, nullptr, collectBody);
+
+  // Results of a batch: /api/batch?first=<ticket>&count=<n>
+  server.on("/api/batch", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (!request->hasParam("first") || !request->hasParam("count")) {
+      request->send(400, "application/json", "{\"error\":\"Missing first or count\"}");
+      return;
+    }
+    uint32_t first = strtoul(request->getParam("first")->value().c_str(), nullptr, 10);
+    long count = request->getParam("count")->value().toInt();
+    if (first == 0 || count < 1 || count > WebCommandQueue::BATCH_MAX) {
+      request->send(400, "application/json", "{\"error\":\"Invalid first or count\"}");
+      return;
+    }
+    if (webCommands.lastCompleted() < first + count - 1) {
+      request->send(202, "application/json", "{\"error\":\"Batch not run yet\"}");
+      return;
+    }
+    request->send(200, "application/json", webBatchResults(first, count));
+  });
+
+  // Batch card programming: POST a job ("1-41", "1,5,9-12"), GET its progress and card log
+  server.on("/api/program", HTTP_POST, [](AsyncWebServerRequest *request){
+    const char* body = (const char*)request->_tempObject;
+    CardBatchSpec spec;
+    if (!body || !CardBatch::parse(body, request->contentLength(), spec)) {
+      request->send(400, "application/json", "{\"error\":\"Numbers like 1-41 or 1,5,9-12 expected\"}");
+      return;
+    }
+    if (!cardBatch.submit(spec)) {
+      request->send(503, "application/json", "{\"error\":\"A job is still being handed over, try again\"}");
+      return;
+    }
+    request->send(202, "application/json", "{\"total\":" + String(spec.total()) + "}");
+  }, nullptr, collectBody);
+
+  server.on("/api/program", HTTP_GET, [](AsyncWebServerRequest *request){
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    cardBatch.writeJson(*response);
+    request->send(response);
+  });
+
+  // Web command queue statistics
+  server.on("/api/queue", HTTP_GET, [](AsyncWebServerRequest *request){
+    String json = "{\"depth\":" + String(webCommands.depth());
+    json += ",\"maxDepth\":" + String(webCommands.maxDepth());
+    json += ",\"capacity\":" + String(WebCommandQueue::CAPACITY);
+    json += ",\"accepted\":" + String(webCommands.accepted());
+    json += ",\"dropped\":" + String(webCommands.dropped());
+    json += ",\"lastCompleted\":" + String(webCommands.lastCompleted()) + "}";
+    request->send(200, "application/json", json);
+  });
+
+  // Per-task CPU load, longest run and stack high-water mark
+  server.on("/api/tasks", HTTP_GET, [](AsyncWebServerRequest *request){
+    request->send(200, "application/json", taskReportJson());
+  });
+
+  // Step timing histograms, loop rate and heap for Prometheus
+  server.on("/api/metrics", HTTP_GET, [](AsyncWebServerRequest *request){
+    AsyncResponseStream *response = request->beginResponseStream("text/plain; version=0.0.4");
+    writeMetrics(*response);
+    request->send(response);
+  });
+
+  // Event log records still in the ring; X-Log-Next is the since= for the next poll
+  server.on("/api/log", HTTP_GET, [](AsyncWebServerRequest *request){
+    uint32_t since = 0;
+    if (request->hasParam("since")) {
+      since = request->getParam("since")->value().toInt();
+    }
+    AsyncResponseStream *response = request->beginResponseStream("text/plain");
+    uint32_t next = eventLog.printSince(*response, since);
+    response->addHeader("X-Log-Next", String(next));
+    request->send(response);
+  });
+  
+  // Event stream: a new page gets the current state with the first poll.
+  // The connection's poll sends the queued events; the library's own poll
+  // handler only retried its message queue, which every ack does as well.
+  if (!stateLock) stateLock = xSemaphoreCreateMutex();
+  events.onConnect([](AsyncEventSourceClient *client){
+    if (events.count() == 1) {
+      // Nobody was listening: results queued since are stale
+      resultsSent.store(resultsQueued.load(std::memory_order_acquire), std::memory_order_release);
+    }
+    playerEvents.requestState();
+    client->client()->onPoll([](void*, AsyncClient*){ sendQueuedEvents(); }, nullptr);
+  });
+  server.addHandler(&events);
+  playerEvents.setSink(queueEvent);
+
+  server.begin();
+  Serial.println(F("SUCCESS: Web Server Ready"));
+  Serial.print(F("WEB: Web Interface: http://"));
+  Serial.print(WiFi.localIP());
+  Serial.println(F("/"));
+}